@@ -14,11 +14,11 @@
  * sheet / foil or conductive fabric) to analog pins A0 - A15 to use as
  * capacitive touch sensors or capacitive distance sensors.
  *
- * Note that if you want to use capacitive sensors, the program needs a minimum
- * of 2 capacitive sensors (only 1 will not work for technical reasons). If you
- * really only want 1 capacitive sensor, just tell the program you have 2
- * capacitive sensors and use an unused analog input for the 2nd sensor. Do not
- * connect an electrode to that input.
+ * Note that on AVR and Teensy boards a single capacitive sensor is supported.
+ * On other boards, the program needs a minimum of 2 capacitive sensors (only 1
+ * will not work for technical reasons). If you really only want 1 capacitive
+ * sensor, just tell the program you have 2 capacitive sensors and use an unused
+ * analog input for the 2nd sensor. Do not connect an electrode to that input.
  *
  * To use resistive only sensors: connect up to 16 resistive pressure sensors to
  * analog pins A0 - A15. Connect the other electrode of the resistive sensors to
@@ -1390,6 +1390,7 @@ void loop()
 	}
 	Serial.println("");
 
+	#if !TL_CVD_HAS_INTERNAL_REFERENCE
 	n = countNSensors(TLSampleMethodCVD);
 	if (n == 1) {
 		Serial.println(F("Error! Detected only 1 capacitive sensor "
@@ -1401,6 +1402,7 @@ void loop()
 		Serial.println(F("TouchLib tuning program aborted."));
 		while (true);
 	}
+	#endif
 
 	Serial.println(F("Next step is to tune the sensors."));
 	noiseTuning();
@@ -41,14 +41,34 @@
 #include <avr/io.h>
 #endif
 
-#define IS_AVR			(defined(SIGNATURE_0))
+/*
+ * The IS_* macros evaluate to 0 or 1. A macro that expands to defined() in an
+ * #if is not portable (and warned about with -Wextra).
+ */
+#if defined(SIGNATURE_0)
+#define IS_AVR			1
+#else
+#define IS_AVR			0
+#endif
 
-#define IS_ATMEGA32X		(defined(__AVR_ATmega328P__) || \
-		defined(__AVR_ATmega328__))
+#if defined(__AVR_ATmega328P__) || \
+		defined(__AVR_ATmega328__)
+#define IS_ATMEGA32X		1
+#else
+#define IS_ATMEGA32X		0
+#endif
 
-#define IS_ATMEGA16X		(defined(__AVR_ATmega168__))
+#if defined(__AVR_ATmega168__)
+#define IS_ATMEGA16X		1
+#else
+#define IS_ATMEGA16X		0
+#endif
 
-#define IS_ATMEGA32U4		(defined(__AVR_ATmega32U4__))
+#if defined(__AVR_ATmega32U4__)
+#define IS_ATMEGA32U4		1
+#else
+#define IS_ATMEGA32U4		0
+#endif
 
 #define IS_ATMEGA16X_32X_32U4	(IS_ATMEGA16X || IS_ATMEGA32X || IS_ATMEGA32U4)
 
@@ -58,13 +78,21 @@
  * attiny-device-signature-be-read-while-running
  * and http://www.avrfreaks.net/forum/device-signatures.
  */
-#define IS_ATMEGA128X		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && (SIGNATURE_0 == 0x1E) && \
-		(SIGNATURE_1 == 0X97))
+		(SIGNATURE_1 == 0X97)
+#define IS_ATMEGA128X		1
+#else
+#define IS_ATMEGA128X		0
+#endif
 
-#define IS_ATMEGA256X		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && (SIGNATURE_0 == 0x1E) && \
-		(SIGNATURE_1 == 0X98))
+		(SIGNATURE_1 == 0X98)
+#define IS_ATMEGA256X		1
+#else
+#define IS_ATMEGA256X		0
+#endif
 
 #define IS_ATMEGA128X_256X	(IS_ATMEGA128X || IS_ATMEGA256X)
 
@@ -74,35 +102,59 @@
 /*
  * From http://forum.arduino.cc/index.php?topic=199571.0
  */
-#define IS_ATTINY_24		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && defined(SIGNATURE_2) && \
 		(SIGNATURE_0 == 0x1E) && (SIGNATURE_1 == 0x91) && \
-		(SIGNATURE_2 == 0x0B))
+		(SIGNATURE_2 == 0x0B)
+#define IS_ATTINY_24		1
+#else
+#define IS_ATTINY_24		0
+#endif
 
-#define IS_ATTINY_44		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && defined(SIGNATURE_2) && \
 		(SIGNATURE_0 == 0x1E) && (SIGNATURE_1 == 0x92) && \
-		(SIGNATURE_2 == 0x07))
+		(SIGNATURE_2 == 0x07)
+#define IS_ATTINY_44		1
+#else
+#define IS_ATTINY_44		0
+#endif
 
-#define IS_ATTINY_84		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && defined(SIGNATURE_2) && \
 		(SIGNATURE_0 == 0x1E) && (SIGNATURE_1 == 0x93) && \
-		(SIGNATURE_2 == 0x0C))
+		(SIGNATURE_2 == 0x0C)
+#define IS_ATTINY_84		1
+#else
+#define IS_ATTINY_84		0
+#endif
 
-#define IS_ATTINY_25		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && defined(SIGNATURE_2) && \
 		(SIGNATURE_0 == 0x1E) && (SIGNATURE_1 == 0x91) && \
-		(SIGNATURE_2 == 0x08))
+		(SIGNATURE_2 == 0x08)
+#define IS_ATTINY_25		1
+#else
+#define IS_ATTINY_25		0
+#endif
 
-#define IS_ATTINY_45		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && defined(SIGNATURE_2) && \
 		(SIGNATURE_0 == 0x1E) && (SIGNATURE_1 == 0x92) && \
-		(SIGNATURE_2 == 0x06))
+		(SIGNATURE_2 == 0x06)
+#define IS_ATTINY_45		1
+#else
+#define IS_ATTINY_45		0
+#endif
 
-#define IS_ATTINY_85		(defined(SIGNATURE_0) && \
+#if defined(SIGNATURE_0) && \
 		defined(SIGNATURE_1) && defined(SIGNATURE_2) && \
 		(SIGNATURE_0 == 0x1E) && (SIGNATURE_1 == 0x93) && \
-		(SIGNATURE_2 == 0x0B))
+		(SIGNATURE_2 == 0x0B)
+#define IS_ATTINY_85		1
+#else
+#define IS_ATTINY_85		0
+#endif
 
 #define IS_ATTINY_2X		(IS_ATTINY_24 || IS_ATTINY_25)
 
@@ -125,12 +177,36 @@
  * Teensy 3.6: MK64FX1M0
 */
 
-#define IS_TEENSYLC			(defined(__MKL26Z64__))
-#define IS_TEENSY30			(defined(__MK20DX128__))
-#define IS_TEENSY31			(defined(__MK20DX256__))
-#define IS_TEENSY32			(defined(__MK20DX256__))
-#define IS_TEENSY35			(defined(__MK64FX512__))
-#define IS_TEENSY36			(defined(__MK66FX1M0__))
+#if defined(__MKL26Z64__)
+#define IS_TEENSYLC			1
+#else
+#define IS_TEENSYLC			0
+#endif
+#if defined(__MK20DX128__)
+#define IS_TEENSY30			1
+#else
+#define IS_TEENSY30			0
+#endif
+#if defined(__MK20DX256__)
+#define IS_TEENSY31			1
+#else
+#define IS_TEENSY31			0
+#endif
+#if defined(__MK20DX256__)
+#define IS_TEENSY32			1
+#else
+#define IS_TEENSY32			0
+#endif
+#if defined(__MK64FX512__)
+#define IS_TEENSY35			1
+#else
+#define IS_TEENSY35			0
+#endif
+#if defined(__MK66FX1M0__)
+#define IS_TEENSY36			1
+#else
+#define IS_TEENSY36			0
+#endif
 #define IS_TEENSY3X			(IS_TEENSY30 || IS_TEENSY31 || \
 		IS_TEENSY32 || IS_TEENSY35 || IS_TEENSY36)
 
@@ -147,6 +223,10 @@
  * From
  * https://community.particle.io/t/preprocessor-ifdef-to-detect-platform-type-core-photon-at-compile-time/13085
  */
-#define IS_PARTICLE			(defined(SPARK) || defined(PLATFORM_ID))
+#if defined(SPARK) || defined(PLATFORM_ID)
+#define IS_PARTICLE			1
+#else
+#define IS_PARTICLE			0
+#endif
 
 #endif
@@ -0,0 +1,163 @@
+/*
+ * TLSampleMethodBulk.cpp - Bulk read method for external touch controllers and
+ * ADCs for TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLSampleMethodBulk.h"
+
+#define TL_SCALE_FACTOR_DEFAULT				((float) 1)
+#define TL_OFFSET_VALUE_DEFAULT				((float) 0)
+
+#define TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT		false
+
+#define TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT	50.0
+#define TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT	40.0
+#define TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT	150.0
+#define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	120.0
+
+static bool TLIsSameDevice(struct TLStruct * d1, struct TLStruct * d2)
+{
+	return (d1->tlStructSampleMethod.bulk.read ==
+		d2->tlStructSampleMethod.bulk.read) &&
+		(d1->tlStructSampleMethod.bulk.context ==
+		d2->tlStructSampleMethod.bulk.context) &&
+		(d1->tlStructSampleMethod.bulk.samples ==
+		d2->tlStructSampleMethod.bulk.samples);
+}
+
+int TLSampleMethodBulkPreSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+	uint8_t n;
+
+	d = &(data[ch]);
+
+	if ((d->tlStructSampleMethod.bulk.read == NULL) ||
+			(d->tlStructSampleMethod.bulk.samples == NULL)) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	/* Only the first channel of a device reads the device. */
+	for (n = 0; n < ch; n++) {
+		if ((data[n].sampleMethod == TLSampleMethodBulk) &&
+				TLIsSameDevice(&(data[n]), d)) {
+			return 0;
+		}
+	}
+
+	return d->tlStructSampleMethod.bulk.read(
+		d->tlStructSampleMethod.bulk.context,
+		d->tlStructSampleMethod.bulk.samples,
+		d->tlStructSampleMethod.bulk.nSamples);
+}
+
+int TLSampleMethodBulkPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+	int pin;
+
+	d = &(data[ch]);
+	pin = d->tlStructSampleMethod.bulk.pin;
+
+	if ((d->tlStructSampleMethod.bulk.samples == NULL) || (pin < 0) ||
+			(pin >= d->tlStructSampleMethod.bulk.nSamples)) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	/*
+	 * Device is not sampled during the scan; overrule raw value of the
+	 * scan.
+	 */
+	d->raw = d->tlStructSampleMethod.bulk.samples[pin];
+	d->value = TLValueFromFloat(d->scaleFactor * d->raw);
+
+	return 0;
+}
+
+int TLSampleMethodBulkMapDelta(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, int length)
+{
+	int n = -1;
+	struct TLStruct * d;
+	float delta;
+
+	d = &(data[ch]);
+	delta = TLValueToFloat(d->delta -
+		d->releasedToApproachedThreshold / 2);
+
+	n = map(100 * delta, 0, 100 * d->calibratedMaxDelta, 0, length);
+
+	n = (n < 0) ? 0 : n;
+	n = (n > length) ? length : n;
+
+	return n;
+}
+
+int TLSampleMethodBulk(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+{
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	d->sampleMethodPreSample = TLSampleMethodBulkPreSample;
+	/* All readings are taken at once in TLSampleMethodBulkPreSample() */
+	d->sampleMethodSample = NULL;
+	d->sampleMethodPostSample = TLSampleMethodBulkPostSample;
+	d->sampleMethodMapDelta = TLSampleMethodBulkMapDelta;
+
+	d->tlStructSampleMethod.bulk.pin = ch;
+	d->tlStructSampleMethod.bulk.read = NULL;
+	d->tlStructSampleMethod.bulk.context = NULL;
+	d->tlStructSampleMethod.bulk.samples = NULL;
+	d->tlStructSampleMethod.bulk.nSamples = 0;
+
+	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
+	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
+	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
+
+	d->releasedToApproachedThreshold =
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
+	d->approachedToReleasedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
+	d->approachedToPressedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
+	d->pressedToApproachedThreshold =
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
+
+	d->direction = TLStruct::directionPositive;
+	d->sampleType = TLStruct::sampleTypeNormal;
+
+	d->pin = &(d->tlStructSampleMethod.bulk.pin);
+
+	return 0;
+}
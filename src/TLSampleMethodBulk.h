@@ -0,0 +1,64 @@
+/*
+ * TLSampleMethodBulk.h - Bulk read method for external touch controllers and
+ * ADCs for TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLSampleMethodBulk_h
+#define TLSampleMethodBulk_h
+
+#include <TouchLib.h>
+
+/*
+ * Bulk read method for external devices (such as I2C / SPI touch controllers
+ * or ADCs) that return the readings of all their channels in one transaction.
+ * All channels of a device share the same read function, context and samples
+ * buffer. read() is called once per scan per device, before the measurements,
+ * and must fill samples[0 .. nSamples - 1]. A channel then uses samples[pin]
+ * as raw value and scaleFactor * raw as value. read() should return 0 on
+ * success; on error the readings of the previous scan are used again.
+ */
+struct TLStructSampleMethodBulk {
+	int pin; /* index in samples */
+	int (*read)(void * context, int32_t * samples, uint8_t nSamples);
+	void * context;
+	int32_t * samples;
+	uint8_t nSamples;
+};
+
+int TLSampleMethodBulkPreSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+int TLSampleMethodBulkPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+int TLSampleMethodBulkMapDelta(struct TLStruct * d, uint8_t nSensors,
+		uint8_t ch, int length);
+
+int TLSampleMethodBulk(struct TLStruct * data, uint8_t nSensors, uint8_t ch);
+
+#endif
@@ -32,6 +32,11 @@
 #include "TLSampleMethodCVD.h"
 #include "BoardID.h"
 
+#if IS_AVR
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#endif
+
 #if IS_PARTICLE
 #include "pinmap_hal.h"
 #include "stm32f2xx.h"
@@ -40,12 +45,22 @@
 
 #define TL_N_CHARGES_MIN_DEFAULT			1
 #define TL_N_CHARGES_MAX_DEFAULT			1
+#define TL_N_CHARGES_HYSTERESIS				((float) 0.25)
 
 #define TL_USE_N_CHARGES_PADDING_DEFAULT		true
 
 #define TL_CHARGE_DELAY_SENSOR_DEFAULT			0
 #define TL_CHARGE_DELAY_ADC_DEFAULT			0
 
+/* Minimum time Chold is connected to a node between 2 multiplexer switches */
+#define TL_CHARGE_DELAY_MIN				1 /* us */
+
+#define TL_CHARGE_DELAY_CALIBRATION_N_MEASUREMENTS	64
+#define TL_CHARGE_DELAY_CALIBRATION_SIGMAS		((float) 3)
+
+#define TL_USE_ADC_NOISE_REDUCTION_DEFAULT		false
+#define TL_GUARD_PIN_DEFAULT				-1
+
 #define TL_REFERENCE_VALUE_DEFAULT			((float) 15) /* 15 pF */
 #define TL_SCALE_FACTOR_DEFAULT				((float) 1)
 #define TL_OFFSET_VALUE_DEFAULT				((float) 1000) /* pF */
@@ -77,6 +92,165 @@ static const unsigned char pin_to_adc_channel[8] = {15, 13, 12, 5, 6, 7, 4, 0};
 
 #define TL_ADC_MAX                                              ((1 << TL_ADC_RESOLUTION_BIT) - 1)
 
+/* Pseudo pin numbers to charge the ADC from an internal reference */
+#define TL_REFERENCE_PIN_INTERNAL_HIGH				-2
+#define TL_REFERENCE_PIN_INTERNAL_LOW				-3
+
+#if IS_ATMEGA128X_256X || IS_ATMEGA32U4
+#define TL_ADC_MUX_MASK						0x1F
+#define TL_ADC_MUX_BANDGAP					0x1E
+#define TL_ADC_MUX_GND						0x1F
+#else
+#define TL_ADC_MUX_MASK						0x0F
+#define TL_ADC_MUX_BANDGAP					0x0E
+#define TL_ADC_MUX_GND						0x0F
+#endif
+
+/* Channel masks are 32 bit; higher channels can't be merged */
+#define TL_MASK_N_CHANNELS					32
+
+#define TL_DRIVEN_LEVEL_UNKNOWN					0xFF
+
+
+#if IS_TEENSY3X || IS_TEENSYLC
+#define TL_ADC_CHANNEL_VREFH					0x1D
+#define TL_ADC_CHANNEL_VREFL					0x1E
+#endif
+
+/*
+ * Tables for the CVD transfer function; see TLLog2() and TLExp2Minus1(). Both
+ * have TL_TABLE_SIZE segments over one octave.
+ */
+#define TL_TABLE_BITS						6
+#define TL_TABLE_SIZE						(1 << TL_TABLE_BITS)
+
+/* Fractional bits of the fixed point log2 values returned by TLLog2() */
+#define TL_LOG2_FRAC_BITS					26
+
+/* log2(1 + i / 64) for i = 0 .. 63 in Q28 */
+static const uint32_t TLLog2Table[TL_TABLE_SIZE] PROGMEM = {
+	0UL, 6004314UL, 11916956UL, 17740682UL, 23478128UL, 29131812UL,
+	34704146UL, 40197436UL, 45613895UL, 50955642UL, 56224710UL, 61423050UL,
+	66552535UL, 71614967UL, 76612075UL, 81545524UL, 86416915UL, 91227790UL,
+	95979635UL, 100673881UL, 105311906UL, 109895043UL, 114424574UL,
+	118901739UL, 123327736UL, 127703720UL, 132030810UL, 136310086UL,
+	140542592UL, 144729341UL, 148871311UL, 152969450UL, 157024676UL,
+	161037877UL, 165009917UL, 168941631UL, 172833830UL, 176687300UL,
+	180502803UL, 184281082UL, 188022855UL, 191728821UL, 195399659UL,
+	199036029UL, 202638571UL, 206207910UL, 209744651UL, 213249385UL,
+	216722687UL, 220165114UL, 223577211UL, 226959507UL, 230312520UL,
+	233636750UL, 236932689UL, 240200814UL, 243441591UL, 246655472UL,
+	249842902UL, 253004311UL, 256140122UL, 259250745UL, 262336582UL,
+	265398025UL
+};
+
+/* 1 / (1 + i / 64) for i = 0 .. 63 in Q15 */
+static const uint16_t TLRecipTable[TL_TABLE_SIZE] PROGMEM = {
+	32768, 32264, 31775, 31301, 30840, 30394, 29959, 29537, 29127, 28728,
+	28340, 27962, 27594, 27236, 26887, 26546, 26214, 25891, 25575, 25267,
+	24966, 24672, 24385, 24105, 23831, 23564, 23302, 23046, 22795, 22550,
+	22310, 22075, 21845, 21620, 21400, 21183, 20972, 20764, 20560, 20361,
+	20165, 19973, 19784, 19600, 19418, 19240, 19065, 18893, 18725, 18559,
+	18396, 18236, 18079, 17924, 17772, 17623, 17476, 17332, 17190, 17050,
+	16913, 16777, 16644, 16513
+};
+
+/* 2^(i / 64) - 1 for i = 0 .. 63 in Q30 */
+static const uint32_t TLExp2Table[TL_TABLE_SIZE] PROGMEM = {
+	0UL, 11692282UL, 23511884UL, 35460194UL, 47538612UL, 59748555UL,
+	72091456UL, 84568763UL, 97181938UL, 109932462UL, 122821830UL,
+	135851554UL, 149023162UL, 162338200UL, 175798228UL, 189404828UL,
+	203159593UL, 217064138UL, 231120093UL, 245329108UL, 259692848UL,
+	274213000UL, 288891266UL, 303729367UL, 318729045UL, 333892058UL,
+	349220186UL, 364715227UL, 380378997UL, 396213335UL, 412220097UL,
+	428401161UL, 444758426UL, 461293810UL, 478009252UL, 494906713UL,
+	511988176UL, 529255643UL, 546711141UL, 564356717UL, 582194441UL,
+	600226404UL, 618454723UL, 636881535UL, 655509003UL, 674339309UL,
+	693374665UL, 712617302UL, 732069477UL, 751733473UL, 771611596UL,
+	791706177UL, 812019574UL, 832554169UL, 853312372UL, 874296616UL,
+	895509364UL, 916953103UL, 938630350UL, 960543646UL, 982695563UL,
+	1005088698UL, 1027725678UL, 1050609158UL
+};
+
+/* Number of conversions so far; used to track how long pins have settled */
+static uint16_t conversionCount = 0;
+
+#if IS_AVR
+/*
+ * The bandgap is converted again when it is needed and TL_BANDGAP_INTERVAL
+ * conversions have passed since the last time. The readings are filtered with
+ * a coefficient of 1 / 2^TL_BANDGAP_FILTER_SHIFT.
+ */
+#define TL_BANDGAP_INTERVAL					16
+#define TL_BANDGAP_FILTER_SHIFT					3
+#define TL_BANDGAP_FRAC_BITS					4
+
+/* Conversions of the bandgap that are discarded while it settles */
+#define TL_BANDGAP_DUMMY_CONVERSIONS				1
+
+static uint16_t bandgapReading = 0;
+static uint16_t bandgapMeasuredAt = 0;
+#endif
+
+static bool TLMaskHasChannel(uint32_t mask, uint8_t n)
+{
+	return (n < TL_MASK_N_CHANNELS) && (mask & (1UL << n));
+}
+
+/*
+ * Remember the level that pin is driven at for all CVD channels on that pin.
+ * drivenAt only changes with the level, so a pin that stays driven (such as a
+ * reference pin) keeps settling. Use TL_DRIVEN_LEVEL_UNKNOWN when the pin is
+ * released, so driving it again counts as a change.
+ */
+static void TLSetDrivenLevel(struct TLStruct * data, uint8_t nSensors, int pin,
+		uint8_t level)
+{
+	struct TLStructSampleMethodCVD * cvd;
+	uint8_t n;
+
+	if (pin < 0) {
+		return;
+	}
+
+	for (n = 0; n < nSensors; n++) {
+		cvd = &(data[n].tlStructSampleMethod.CVD);
+		if ((data[n].sampleMethod == TLSampleMethodCVD) &&
+				(cvd->pin == pin) &&
+				(cvd->drivenLevel != level)) {
+			cvd->drivenLevel = level;
+			cvd->drivenAt = conversionCount;
+		}
+	}
+}
+
+/*
+ * True if the sensor of channel ch has been driven at level since before the
+ * previous conversion, i.e. it had the time of at least one conversion of
+ * another channel to settle.
+ */
+static bool TLSensorIsSettled(struct TLStruct * d, uint8_t level)
+{
+	return (d->tlStructSampleMethod.CVD.drivenLevel == level) &&
+		((uint16_t) (conversionCount -
+		d->tlStructSampleMethod.CVD.drivenAt) >= 2);
+}
+
+/*
+ * True if the inverted measurement of this channel is interleaved with the
+ * normal measurement of another channel (see interleaveInvertedSample).
+ */
+static bool TLIsInterleaved(struct TLStruct * d)
+{
+	return (d->interleaveInvertedSample) &&
+		(d->sampleType == TLStruct::sampleTypeDifferential) &&
+		(d->tlStructSampleMethod.CVD.mergeMask == 0);
+}
+
+/*
+ * Find the next CVD channel that can be used as reference. Channels on the same
+ * pin (such as channels behind the same external multiplexer) can't be used.
+ */
 static uint8_t TLChannelToReference(struct TLStruct * data, uint8_t nSensors,
 		uint8_t ch)
 {
@@ -97,21 +271,42 @@ static uint8_t TLChannelToReference(struct TLStruct * data, uint8_t nSensors,
 			 */
 			ref = 0xFF;
 		}
-	} while ((ref != 0xFF) && (data[ref].sampleMethod !=
-		TLSampleMethodCVD));
+	} while ((ref != 0xFF) && ((data[ref].sampleMethod !=
+		TLSampleMethodCVD) ||
+		(data[ref].tlStructSampleMethod.CVD.mergeMask) ||
+		(data[ref].tlStructSampleMethod.CVD.pin ==
+		data[ch].tlStructSampleMethod.CVD.pin)));
 
 	return ref;
 }
 
-static void TLSetSensorAndReferencePins(int ch_pin, int ref_pin, bool inv)
+/*
+ * Drive the guard pin (if any) to level. This uses the same pinMode() /
+ * digitalWrite() path as the sensor and reference pins, so the guard switches
+ * with the same latency as the sensor.
+ */
+static void TLDriveGuard(int guard_pin, uint8_t level)
+{
+	if (guard_pin < 0) {
+		return;
+	}
+
+	pinMode(guard_pin, OUTPUT);
+	digitalWrite(guard_pin, level);
+}
+
+static void TLSetSensorAndReferencePins(int ch_pin, int ref_pin, int guard_pin,
+		bool inv)
 {
 	/* Set reference pin as output and high. */
 
-	pinMode(ref_pin, OUTPUT);
-	if (inv) {
-		digitalWrite(ref_pin, LOW);
-	} else {
-		digitalWrite(ref_pin, HIGH);
+	if (ref_pin >= 0) {
+		pinMode(ref_pin, OUTPUT);
+		if (inv) {
+			digitalWrite(ref_pin, LOW);
+		} else {
+			digitalWrite(ref_pin, HIGH);
+		}
 	}
 
 	/* Set sensor pin as output and low (discharge sensor). */
@@ -121,6 +316,9 @@ static void TLSetSensorAndReferencePins(int ch_pin, int ref_pin, bool inv)
 	} else {
 		digitalWrite(ch_pin, LOW);
 	}
+
+	/* Guard follows sensor. */
+	TLDriveGuard(guard_pin, inv ? HIGH : LOW);
 }
 
 bool TLHasMux5(void)
@@ -158,10 +356,157 @@ void TLSetAdcReferencePin(int pin)
 	}
 }
 
+void TLSetAdcInternalReference(bool high)
+{
+	unsigned char mux;
+
+	mux = high ? TL_ADC_MUX_BANDGAP : TL_ADC_MUX_GND;
+
+	ADMUX &= ~TL_ADC_MUX_MASK;
+	ADMUX |= mux;
+	if (TLHasMux5()) {
+		ADCSRB &= ~0x08;
+	}
+}
+
 int TLAnalogRead(int pin)
 {
 	return analogRead(pin - A0);
 }
+
+/*
+ * Convert the bandgap and update bandgapReading, the filtered ADC value of the
+ * bandgap (V_BG / VCC * (TL_ADC_MAX + 1)) in Q4 (TL_BANDGAP_FRAC_BITS).
+ */
+static void TLMeasureBandgap(void)
+{
+	uint16_t reading;
+	uint8_t low, high, n;
+
+	if (!(ADMUX & (_BV(REFS0) | _BV(REFS1)))) {
+		/*
+		 * Analog reference has not been set yet; let analogRead() take
+		 * care of that.
+		 */
+		analogRead(0);
+	}
+
+	/*
+	 * The bandgap needs time to charge Chold after the mux switches to it,
+	 * so the first conversion is off; discard it.
+	 */
+	TLSetAdcInternalReference(true);
+	for (n = 0; n <= TL_BANDGAP_DUMMY_CONVERSIONS; n++) {
+		ADCSRA |= _BV(ADSC);
+		while (ADCSRA & _BV(ADSC));
+	}
+
+	/* ADCL must be read first; reading ADCH unlocks the data registers. */
+	low = ADCL;
+	high = ADCH;
+	reading = ((((uint16_t) high) << 8) | low) << TL_BANDGAP_FRAC_BITS;
+
+	if (bandgapReading == 0) {
+		bandgapReading = reading;
+	} else {
+		bandgapReading = bandgapReading - (bandgapReading >>
+			TL_BANDGAP_FILTER_SHIFT) + (reading >>
+			TL_BANDGAP_FILTER_SHIFT);
+	}
+	bandgapMeasuredAt = conversionCount;
+}
+
+/*
+ * Scale a normal sample for which Chold was charged from the bandgap to the
+ * sample that charging from VCC (a reference pin) gives. See correctSample().
+ */
+static int TLScaleBandgapSample(int sample)
+{
+	if ((bandgapReading == 0) || ((uint16_t) (conversionCount -
+			bandgapMeasuredAt) >= TL_BANDGAP_INTERVAL)) {
+		TLMeasureBandgap();
+	}
+
+	if (bandgapReading == 0) {
+		/* An error occurred! */
+		return sample;
+	}
+
+	return (int) ((((uint32_t) sample) * (((uint32_t) (TL_ADC_MAX + 1)) <<
+		TL_BANDGAP_FRAC_BITS)) / bandgapReading);
+}
+
+#if TL_ENABLE_ADC_NOISE_REDUCTION
+static volatile bool adcConversionDone = false;
+
+/*
+ * ADC conversion complete interrupt. Wakes up the CPU from ADC noise reduction
+ * mode.
+ */
+ISR(ADC_vect)
+{
+	adcConversionDone = true;
+}
+
+int TLAnalogReadNoiseReduction(int pin)
+{
+	uint8_t low, high, sreg;
+
+	if (!(ADMUX & (_BV(REFS0) | _BV(REFS1)))) {
+		/*
+		 * Analog reference has not been set yet; let analogRead() take
+		 * care of that.
+		 */
+		return TLAnalogRead(pin);
+	}
+
+	/* Transfer charge from Chold to Csense. */
+	TLSetAdcReferencePin(pin);
+
+	sreg = SREG;
+	adcConversionDone = false;
+	ADCSRA |= _BV(ADIE);
+
+	/*
+	 * Entering ADC noise reduction mode starts the conversion. Interrupts
+	 * must be enabled to wake up again; sei() directly followed by
+	 * sleep_cpu() makes sure no interrupt is handled in between.
+	 */
+	set_sleep_mode(SLEEP_MODE_ADC);
+	cli();
+	sleep_enable();
+	sei();
+	sleep_cpu();
+
+	/*
+	 * Other interrupts (such as the timer used by millis()) can also wake
+	 * up the CPU. Entering ADC noise reduction mode again would start
+	 * another conversion, so wait for this one in idle mode.
+	 */
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	while (!adcConversionDone) {
+		sei();
+		sleep_cpu();
+		cli();
+	}
+	sleep_disable();
+	ADCSRA &= ~_BV(ADIE);
+	SREG = sreg;
+
+	/* ADCL must be read first; reading ADCH unlocks the data registers. */
+	low = ADCL;
+	high = ADCH;
+
+	return (((int) high) << 8) | low;
+}
+#else
+int TLAnalogReadNoiseReduction(int pin)
+{
+	/* Not enabled; see TL_ENABLE_ADC_NOISE_REDUCTION */
+	return TLAnalogRead(pin);
+}
+#endif
 #elif IS_TEENSY3X
 void TLSetAdcReferencePin(int pin)
 {
@@ -175,20 +520,50 @@ void TLSetAdcReferencePin(int pin)
 	}
 	#endif
 
-	#if IS_TEENSYLC
+	*ADCx_SC1A = (pin - A0) & 0x1F;
+}
+
+void TLSetAdcInternalReference(bool high)
+{
+	ADC0_SC1A = high ? TL_ADC_CHANNEL_VREFH : TL_ADC_CHANNEL_VREFL;
+}
+
+int TLAnalogRead(int pin)
+{
+	return analogRead(pin - A0);
+}
+
+int TLAnalogReadNoiseReduction(int pin)
+{
+	/* ADC noise reduction mode is not available */
+	return TLAnalogRead(pin);
+}
+#elif IS_TEENSYLC
+void TLSetAdcReferencePin(int pin)
+{
 	if ((pin - A0) & 0x40) {
-		*ADCx_CFG2 &= ~ADC_CFG2_MUXSEL;
+		ADC0_CFG2 &= ~ADC_CFG2_MUXSEL;
 	} else {
-		*ADCx_CFG2 |= ADC_CFG2_MUXSEL;
+		ADC0_CFG2 |= ADC_CFG2_MUXSEL;
 	}
-	#endif
-	*ADCx_SC1A = (pin - A0) & 0x1F;
+	ADC0_SC1A = (pin - A0) & 0x1F;
+}
+
+void TLSetAdcInternalReference(bool high)
+{
+	ADC0_SC1A = high ? TL_ADC_CHANNEL_VREFH : TL_ADC_CHANNEL_VREFL;
 }
 
 int TLAnalogRead(int pin)
 {
 	return analogRead(pin - A0);
 }
+
+int TLAnalogReadNoiseReduction(int pin)
+{
+	/* ADC noise reduction mode is not available */
+	return TLAnalogRead(pin);
+}
 #elif IS_PARTICLE
 void TLSetAdcReferencePin(int pin)
 {
@@ -303,6 +678,12 @@ int TLAnalogRead(int pin)
 
 	return value;
 }
+
+int TLAnalogReadNoiseReduction(int pin)
+{
+	/* ADC noise reduction mode is not available */
+	return TLAnalogRead(pin);
+}
 #else
 #warning CVD sensors has not yet been ported to this architecture. Please \
 	inform the author.
@@ -315,19 +696,38 @@ static void TLChargeADC(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
 		int ref_pin, bool delay)
 {
 	/* Set ADC to reference pin (charge Chold). */
-	TLSetAdcReferencePin(ref_pin);
+	if (ref_pin >= 0) {
+		TLSetAdcReferencePin(ref_pin);
+	}
+	#if TL_CVD_HAS_INTERNAL_REFERENCE
+	else {
+		TLSetAdcInternalReference(ref_pin ==
+			TL_REFERENCE_PIN_INTERNAL_HIGH);
+	}
+	#endif
 
 	if ((delay) && (data[ch].tlStructSampleMethod.CVD.chargeDelayADC)) {
 		delayMicroseconds(data[ch].tlStructSampleMethod.CVD.chargeDelayADC);
 	}
 }
 
+/*
+ * Switch the guard to the level the sensor moves towards when charge is
+ * transferred to it: high for normal and low for inverted measurements.
+ */
+static void TLTransferGuard(struct TLStruct * data, uint8_t ch, bool inv)
+{
+	TLDriveGuard(data[ch].tlStructSampleMethod.CVD.guardPin,
+		inv ? LOW : HIGH);
+}
+
 static void TLChargeSensor(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
-		int ch_pin, bool delay)
+		int ch_pin, bool inv, bool delay)
 {
 	/*
 	 * Set ADC to sensor pin (transfer charge from Chold to Csense).
 	 */
+	TLTransferGuard(data, ch, inv);
 	TLSetAdcReferencePin(ch_pin);
 
 	if ((delay) && (data[ch].tlStructSampleMethod.CVD.chargeDelaySensor)) {
@@ -346,57 +746,453 @@ static void TLDischargeSensor(struct TLStruct * data, uint8_t nSensors, uint8_t
 	}
 }
 
-static void TLCharge(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
-		int ch_pin, int ref_pin)
+/*
+ * Wait d us, but at least TL_CHARGE_DELAY_MIN. Where the ADC multiplexer
+ * switches from node to node without an analogRead() in between (extra charges
+ * and the chain of merged sensors), Chold needs that time to share
+ * its charge with each node.
+ */
+static void TLChargeDelay(unsigned int d)
 {
-	unsigned int d;
+	if (d < TL_CHARGE_DELAY_MIN) {
+		d = TL_CHARGE_DELAY_MIN;
+	}
+	delayMicroseconds(d);
+}
 
+static void TLCharge(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		int ch_pin, int ref_pin, bool inv)
+{
 	TLChargeADC(data, nSensors, ch, ref_pin, false);
-	TLChargeSensor(data, nSensors, ch, ch_pin, false);
+	TLChargeDelay(data[ch].tlStructSampleMethod.CVD.chargeDelayADC);
+	TLChargeSensor(data, nSensors, ch, ch_pin, inv, false);
+	TLChargeDelay(data[ch].tlStructSampleMethod.CVD.chargeDelaySensor);
+}
 
-	d = (data[ch].tlStructSampleMethod.CVD.chargeDelayADC >
-			data[ch].tlStructSampleMethod.CVD.chargeDelaySensor) ?
-		data[ch].tlStructSampleMethod.CVD.chargeDelayADC :
-			data[ch].tlStructSampleMethod.CVD.chargeDelaySensor;
+static uint32_t TLRawScaleInt(struct TLStruct * d)
+{
+	if (d->enableSlewrateLimiter) {
+		return ((uint32_t) (TL_ADC_MAX + 1)) << 2;
+	} else {
+		return ((uint32_t) (d->nMeasurementsPerSensor << 1)) *
+			((uint32_t) (TL_ADC_MAX + 1));
+	}
+}
+
+#if !TL_USE_FIXED_POINT
+static float TLRawScale(struct TLStruct * d)
+{
+	return (float) TLRawScaleInt(d);
+}
+#endif
 
-	if (d) {
-		delayMicroseconds(d);
+/*
+ * log2(x) in Q26 (TL_LOG2_FRAC_BITS) for x >= 1. TLLog2Table gives the start of
+ * each segment, the rest (y < 1 / 64) is added as log2(1 + y) with a 3rd order
+ * polynomial. The absolute error is below 1e-6.
+ */
+static uint32_t TLLog2(uint32_t x)
+{
+	uint32_t y, y2, p;
+	uint8_t e = 31, i;
+
+	if (x == 0) {
+		return 0;
+	}
+
+	while (!(x & 0x80000000UL)) {
+		x <<= 1;
+		e--;
 	}
+
+	/* x = 2^e * (1 + i / 64) * (1 + y), y in Q28 */
+	i = (x >> (31 - TL_TABLE_BITS)) & (TL_TABLE_SIZE - 1);
+	y = (((x >> 9) & 0xFFFF) * pgm_read_word(&(TLRecipTable[i]))) >> 9;
+
+	/* p = ln(1 + y) = y - y^2 / 2 + y^3 / 3 in Q28 */
+	y2 = ((y >> 7) * (y >> 7)) >> 14;
+	p = y - (y2 >> 1) + (((((y2 >> 7) * (y >> 7)) >> 14)) / 3);
+
+	/* log2(1 + y) = p * (1 + 0.4427) */
+	p = p + (((p >> 6) * 29012UL) >> 10);
+
+	return (((uint32_t) e) << TL_LOG2_FRAC_BITS) +
+		((pgm_read_dword(&(TLLog2Table[i])) + p) >> 2);
 }
 
-static void correctSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+/*
+ * 2^(u / 2^26) = (1 + x / 2^30) * 2^k, with u in the format of TLLog2().
+ * Returns x and stores k. The table gives 2^(i / 64) - 1; the remaining
+ * fraction (less than 1 / 64) is added with a 3rd order polynomial.
+ */
+static uint32_t TLExp2(uint32_t u, uint8_t * k)
 {
-	TLStruct * d;
-	float tmp, scale;
+	uint32_t d, t, t2, g, m;
+	uint8_t i;
 
-	d = &(data[ch]);
+	*k = u >> TL_LOG2_FRAC_BITS;
+	i = (u >> (TL_LOG2_FRAC_BITS - TL_TABLE_BITS)) & (TL_TABLE_SIZE - 1);
+	d = u & ((1UL << (TL_LOG2_FRAC_BITS - TL_TABLE_BITS)) - 1);
 
-	if (d->enableSlewrateLimiter) {
-		scale = (float) ((TL_ADC_MAX + 1) << 2);
+	/* t = d / 2^26 * ln(2) in Q30, i.e. d * 11.0904 */
+	t = d * 11 + (((d >> 8) * 23686UL) >> 10) +
+		(((d & 0xFF) * 23686UL) >> 18);
+
+	/* g = 2^(d / 2^26) - 1 = t + t^2 / 2 + t^3 / 6 */
+	t2 = ((t >> 8) * (t >> 8)) >> 15;
+	g = t + t2 + ((((t2 >> 8) * (t >> 8)) >> 14) / 3);
+
+	/* x = 2^(i / 64) * (1 + g) - 1 = m + g + m * g in Q30 */
+	m = pgm_read_dword(&(TLExp2Table[i]));
+
+	return m + g + (((m >> 14) * (g >> 8)) >> 8);
+}
+
+/* log2(scale / (scale - raw)) / nCharges in the format of TLLog2(), >= 1 */
+static uint32_t TLTransferExponent(int32_t raw, uint32_t scale,
+		uint32_t nCharges)
+{
+	uint32_t e;
+
+	e = (TLLog2(scale) - TLLog2(scale - raw)) / nCharges;
+
+	return (e < 1) ? 1 : e;
+}
+
+#if TL_USE_FIXED_POINT
+/* Fractional bits of Csense / Chold passed to updateNChargesNext() */
+#define TL_RATIO_FRAC_BITS					16
+
+#define TL_N_CHARGES_HYSTERESIS_FIXED				\
+	(1UL << (TL_RATIO_FRAC_BITS - 2)) /* 0.25 */
+
+/*
+ * Round x > 0 to a mantissa of bits significant bits (2^(bits - 1) -
+ * 2^bits - 1); the exponent is added to *e.
+ */
+static uint32_t TLMantissa(uint32_t x, uint8_t bits, int8_t * e)
+{
+	uint8_t s = 0;
+
+	while ((x >> s) >= (1UL << bits)) {
+		s++;
+	}
+	if (s > 0) {
+		/* Round to nearest without overflowing */
+		x = ((x >> (s - 1)) + 1) >> 1;
+		if (x >= (1UL << bits)) {
+			x >>= 1;
+			s++;
+		}
+		*e += s;
 	} else {
-		scale = ((float) (d->nMeasurementsPerSensor << 1)) *
-			((float) (TL_ADC_MAX + 1));
+		while (x < (1UL << (bits - 1))) {
+			x <<= 1;
+			(*e)--;
+		}
 	}
 
-	tmp = 1 - ((float) d->raw) / scale;
-	tmp = pow(tmp, -((float) 1) /
-		((float) d->tlStructSampleMethod.CVD.nCharges)) - ((float) 1);
-	tmp = ((float) 1) / tmp;
+	return x;
+}
 
-	d->tlStructSampleMethod.CVD.nChargesNext = (int32_t) (ceilf(tmp));
-	if (d->tlStructSampleMethod.CVD.nChargesNext < TL_N_CHARGES_MIN_DEFAULT) {
-		d->tlStructSampleMethod.CVD.nChargesNext =
-			TL_N_CHARGES_MIN_DEFAULT;
+/* x * 2^e rounded to nearest and saturated to max */
+static uint32_t TLScale2(uint32_t x, int8_t e, uint32_t max)
+{
+	if (e >= 0) {
+		if ((e >= 32) || (x > (max >> e))) {
+			return max;
+		}
+		return x << e;
 	}
-	if (d->tlStructSampleMethod.CVD.nChargesNext > TL_N_CHARGES_MAX_DEFAULT) {
-		d->tlStructSampleMethod.CVD.nChargesNext =
-			TL_N_CHARGES_MAX_DEFAULT;
+	if (e <= -32) {
+		return 0;
+	}
+	x = ((x >> (-e - 1)) + 1) >> 1;
+
+	return (x > max) ? max : x;
+}
+
+/*
+ * Csense / Chold = 1 / ((1 - raw / scale)^(-1 / nCharges) - 1) (see
+ * correctSample()) as *ratio * 2^*e with 2^15 < *ratio <= 2^17, computed with a
+ * single 32 bit division. For nCharges = 1 this is (scale - raw) / raw.
+ * Otherwise (1 - raw / scale)^(-1 / nCharges) = 2^u = (1 + x / 2^30) * 2^k
+ * (see TLExp2()), so the denominator is (2^30 + x - 2^(30 - k)) * 2^(k - 30).
+ * raw is clipped to 1 .. scale - 1. Compared to the double precision function,
+ * the relative error is below 5e-5 for raw / scale in 0.05 - 0.95 and below
+ * 2e-4 for raw / scale down to 0.005.
+ */
+static void TLTransferRatio(int32_t raw, uint32_t scale, uint32_t nCharges,
+		uint32_t * ratio, int8_t * e)
+{
+	uint32_t num, den, x, q, r;
+	uint8_t k;
+	int8_t eDen = 0;
+
+	if (raw < 1) {
+		raw = 1;
+	}
+	if ((uint32_t) raw > scale - 1) {
+		raw = scale - 1;
+	}
+
+	if (nCharges <= 1) {
+		num = scale - raw;
+		den = raw;
+		*e = 0;
+	} else {
+		x = TLExp2(TLTransferExponent(raw, scale, nCharges), &k);
+		num = 1UL << 30;
+		den = (1UL << 30) + x - ((1UL << 30) >> k);
+		*e = -((int8_t) k);
+	}
+
+	/* num in 2^31 - 2^32 - 1 and den in 2^15 - 2^16 - 1 */
+	while (!(num & 0x80000000UL)) {
+		num <<= 1;
+		(*e)--;
 	}
+	den = TLMantissa(den, 16, &eDen);
+	*e -= eDen;
+
+	q = num / den;
+	r = num - q * den;
+	if ((r << 1) >= den) {
+		q++;
+	}
+
+	*ratio = q;
+}
+#else
+/*
+ * 2^(e / 2^26) - 1, with e in the format of TLLog2(); see TLExp2(). The
+ * relative error is below 2e-5 for |e| >= 2^14.
+ */
+static float TLExp2Minus1(int32_t e)
+{
+	uint32_t x;
+	uint8_t k;
+	float f;
+
+	x = TLExp2((e < 0) ? -e : e, &k);
+
+	/* 2^u - 1 = (1 + x) * 2^k - 1 */
+	f = ldexp((float) x, ((int) k) - 30) + (ldexp((float) 1, k) - 1);
+
+	if (e < 0) {
+		/* 2^-u - 1 = -f / (1 + f) */
+		f = -f / (1 + f);
+	}
+
+	return f;
+}
+
+/*
+ * Csense / Chold = 1 / ((1 - raw / scale)^(-1 / nCharges) - 1); see
+ * correctSample(). For nCharges = 1 this is (scale - raw) / raw. Otherwise
+ * (1 - raw / scale)^(-1 / nCharges) = 2^((log2(scale) - log2(scale - raw)) /
+ * nCharges) is computed with TLLog2() and TLExp2Minus1() instead of pow().
+ * raw is clipped to 1 .. scale - 1. Compared to pow(), the relative error is
+ * below 2e-5 for raw / scale in 0.05 - 0.95 and below 2e-4 for raw / scale
+ * down to 0.005.
+ */
+static float TLTransferFunction(int32_t raw, uint32_t scale, uint32_t nCharges)
+{
+	if (raw < 1) {
+		raw = 1;
+	}
+	if ((uint32_t) raw > scale - 1) {
+		raw = scale - 1;
+	}
+
+	if (nCharges <= 1) {
+		return ((float) (scale - raw)) / ((float) raw);
+	}
+
+	return ((float) 1) / TLExp2Minus1(TLTransferExponent(raw, scale,
+		nCharges));
+}
+#endif
+
+static void TLSetNChargesNext(struct TLStructSampleMethodCVD * cvd, uint32_t n)
+{
+	if (n < cvd->nChargesMin) {
+		n = cvd->nChargesMin;
+	}
+	if (n > cvd->nChargesMax) {
+		n = cvd->nChargesMax;
+	}
+	if (n < 1) {
+		n = 1;
+	}
+
+	cvd->nChargesNext = n;
+}
+
+/*
+ * Select the number of charges for the next scan. tmp is Csense / Chold. With
+ * nCharges = ceil(Csense / Chold) the sensor is charged to about 1 - 1/e of the
+ * reference voltage, which keeps raw in the sweet spot of the ADC. Hysteresis
+ * prevents toggling between 2 values when Csense / Chold is close to an
+ * integer.
+ */
+#if TL_USE_FIXED_POINT
+static void updateNChargesNext(struct TLStruct * d, uint32_t tmp)
+{
+	struct TLStructSampleMethodCVD * cvd;
+	uint32_t n, c;
+
+	cvd = &(d->tlStructSampleMethod.CVD);
+
+	/* tmp in Q16 (TL_RATIO_FRAC_BITS), saturated; n = ceil(tmp) */
+	n = (tmp > 0) ? ((tmp - 1) >> TL_RATIO_FRAC_BITS) + 1 : 0;
+	c = cvd->nCharges << TL_RATIO_FRAC_BITS;
+
+	if (n > cvd->nChargesMax) {
+		/* Out of range; use maximum */
+		n = cvd->nChargesMax;
+	} else if ((tmp <= c + TL_N_CHARGES_HYSTERESIS_FIXED) && (tmp +
+			(1UL << TL_RATIO_FRAC_BITS) +
+			TL_N_CHARGES_HYSTERESIS_FIXED >= c)) {
+		n = cvd->nCharges;
+	}
+
+	TLSetNChargesNext(cvd, n);
+}
+#else
+static void updateNChargesNext(struct TLStruct * d, float tmp)
+{
+	struct TLStructSampleMethodCVD * cvd;
+	uint32_t n;
+
+	cvd = &(d->tlStructSampleMethod.CVD);
+
+	if (!(tmp > 0) || (tmp > (float) cvd->nChargesMax)) {
+		/* Out of range or not a number; use maximum */
+		n = cvd->nChargesMax;
+	} else if ((tmp > ((float) cvd->nCharges) +
+			TL_N_CHARGES_HYSTERESIS) || (tmp < ((float)
+			cvd->nCharges) - 1 - TL_N_CHARGES_HYSTERESIS)) {
+		n = (uint32_t) tmp;
+		if ((float) n < tmp) {
+			n++;
+		}
+	} else {
+		n = cvd->nCharges;
+	}
+
+	TLSetNChargesNext(cvd, n);
+}
+#endif
+
+#if TL_USE_FIXED_POINT
+/*
+ * Update the cached scale * scaleFactor / referenceValue of correctSample()
+ * when one of them has changed. This is the only floating point operation
+ * left, and it normally runs once.
+ */
+static void TLUpdateGain(struct TLStruct * d, uint32_t scale)
+{
+	struct TLStructSampleMethodCVD * cvd;
+	float g;
+	int e;
+
+	cvd = &(d->tlStructSampleMethod.CVD);
+
+	if ((cvd->gainScale == scale) &&
+			(cvd->gainScaleFactor == d->scaleFactor) &&
+			(cvd->gainReferenceValue == d->referenceValue)) {
+		return;
+	}
+	cvd->gainScale = scale;
+	cvd->gainScaleFactor = d->scaleFactor;
+	cvd->gainReferenceValue = d->referenceValue;
+
+	g = ((float) scale) * d->scaleFactor / d->referenceValue;
+	if (!(g > 0)) {
+		/* An error occurred! */
+		cvd->gain = 0;
+		cvd->gainExponent = 0;
+		return;
+	}
+	if (!(g < (float) 1e18)) {
+		/* Saturate */
+		g = (float) 1e18;
+	}
+
+	/* g = m * 2^e with m in 0.5 - 1 */
+	g = frexp(g, &e);
+	cvd->gain = (uint16_t) (g * (float) 0x8000 + (float) 0.5);
+	e -= 15;
+	if (cvd->gain >= 0x8000) {
+		cvd->gain >>= 1;
+		e++;
+	}
+	if (e < -64) {
+		/* Rounds to 0 anyway */
+		cvd->gain = 0;
+		e = 0;
+	}
+	cvd->gainExponent = e;
+}
+#endif
+
+/*
+ * The transfer function assumes that Chold is charged to VCC for normal
+ * measurements (and to GND for inverted ones). A single CVD sensor charges
+ * Chold from an internal reference instead. On Teensy, VREFH is the ADC
+ * reference, so this is the same. On AVR the bandgap (about 1.1 V) is used; the
+ * charge transfer is linear in that voltage, so TLScaleBandgapSample() scales
+ * those samples by VCC / V_BG (measured with the ADC) before they are added to
+ * raw. This costs about 2 bits of resolution of the normal measurement.
+ *
+ * With TL_USE_FIXED_POINT, only integer operations are used (apart from
+ * TLUpdateGain()).
+ */
+#if TL_USE_FIXED_POINT
+static void correctSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+{
+	TLStruct * d;
+	uint32_t scale, ratio;
+	int8_t e;
+
+	d = &(data[ch]);
+
+	scale = TLRawScaleInt(d);
+
+	TLTransferRatio(d->raw, scale, d->tlStructSampleMethod.CVD.nCharges,
+		&ratio, &e);
+
+	updateNChargesNext(d, TLScale2(ratio, e + TL_RATIO_FRAC_BITS,
+		0xFFFFFFFFUL));
+
+	TLUpdateGain(d, scale);
+
+	/* gain < 2^15 and ratio < 2^17, so the product fits in 32 bits */
+	e += d->tlStructSampleMethod.CVD.gainExponent + TL_VALUE_FRAC_BITS;
+	d->value = (TLValue) TLScale2(ratio * d->tlStructSampleMethod.CVD.gain,
+		e, TL_VALUE_MAX);
+}
+#else
+static void correctSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+{
+	TLStruct * d;
+	float tmp, scale;
+
+	d = &(data[ch]);
+
+	scale = TLRawScale(d);
+
+	tmp = TLTransferFunction(d->raw, TLRawScaleInt(d),
+		d->tlStructSampleMethod.CVD.nCharges);
+
+	updateNChargesNext(d, tmp);
 
 	tmp = scale * tmp * d->scaleFactor / d->referenceValue;
-	d->value = tmp;
+	d->value = TLValueFromFloat(tmp);
 	/* Capacitance can be negative due to noise! */
 }
+#endif
 
 static void updateNCharges(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
 {
@@ -407,9 +1203,165 @@ static void updateNCharges(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
 }
 
 
+static uint8_t TLChannelToReferenceExcluding(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch, uint32_t mask)
+{
+	uint8_t ref, n;
+
+	ref = ch;
+	for (n = 0; n < nSensors; n++) {
+		ref = TLChannelToReference(data, nSensors, ref);
+		if (ref == 0xFF) {
+			break;
+		}
+		if (!TLMaskHasChannel(mask, ref)) {
+			return ref;
+		}
+	}
+
+	return 0xFF;
+}
+
+/*
+ * Clear the channels in mask that have no electrode of their own: channels
+ * that don't use TLSampleMethodCVD (their tlStructSampleMethod is not a CVD
+ * struct), merged sensors and channels without a pin.
+ */
+static uint32_t TLElectrodeMask(struct TLStruct * data, uint8_t nSensors,
+		uint32_t mask)
+{
+	uint8_t n;
+
+	for (n = 0; n < TL_MASK_N_CHANNELS; n++) {
+		if (!TLMaskHasChannel(mask, n)) {
+			continue;
+		}
+		if ((n >= nSensors) ||
+				(data[n].sampleMethod != TLSampleMethodCVD) ||
+				(data[n].tlStructSampleMethod.CVD.mergeMask) ||
+				(data[n].tlStructSampleMethod.CVD.pin < 0)) {
+			mask &= ~(1UL << n);
+		}
+	}
+
+	return mask;
+}
+
+/*
+ * Transfer the charge of the ADC sample and hold capacitor through all sensors
+ * in mask (bit n set means channel n) and convert the voltage that is left.
+ * The result is the product of the charge sharing ratios of all sensors, i.e.
+ * the sensors in mask act as one sensor. Channels in mask without an electrode
+ * of their own are skipped (see TLElectrodeMask()).
+ */
+static int TLSampleMultiple(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, uint32_t mask, bool inv)
+{
+	struct TLStruct * dCh;
+	uint8_t ref, n, last = 0xFF;
+	int ref_pin, pin, sample;
+
+	dCh = &(data[ch]);
+
+	mask = TLElectrodeMask(data, nSensors, mask);
+
+	ref = TLChannelToReferenceExcluding(data, nSensors, ch, mask);
+	if (ref == 0xFF) {
+		#if TL_CVD_HAS_INTERNAL_REFERENCE
+		ref_pin = inv ? TL_REFERENCE_PIN_INTERNAL_LOW :
+			TL_REFERENCE_PIN_INTERNAL_HIGH;
+		#else
+		/* An error occurred! */
+		return 0;
+		#endif
+	} else {
+		ref_pin = data[ref].tlStructSampleMethod.CVD.pin;
+	}
+
+	conversionCount++;
+
+	/* Discharge (or charge if inverted) all sensors in mask. */
+	for (n = 0; n < nSensors; n++) {
+		if (TLMaskHasChannel(mask, n)) {
+			TLSetSensorAndReferencePins(
+				data[n].tlStructSampleMethod.CVD.pin, ref_pin,
+				dCh->tlStructSampleMethod.CVD.guardPin, inv);
+			last = n;
+		}
+	}
+	if (last == 0xFF) {
+		/* An error occurred! */
+		return 0;
+	}
+	for (n = 0; n <= last; n++) {
+		if (TLMaskHasChannel(mask, n)) {
+			pinMode(data[n].tlStructSampleMethod.CVD.pin, INPUT);
+			TLSetDrivenLevel(data, nSensors,
+				data[n].tlStructSampleMethod.CVD.pin,
+				TL_DRIVEN_LEVEL_UNKNOWN);
+		}
+	}
+
+	/* Set ADC to reference pin (charge internal capacitor). */
+	TLChargeADC(data, nSensors, ch, ref_pin, false);
+	TLChargeDelay(dCh->tlStructSampleMethod.CVD.chargeDelayADC);
+
+	/* Transfer charge through all sensors except the last */
+	for (n = 0; n < last; n++) {
+		if (TLMaskHasChannel(mask, n)) {
+			TLChargeSensor(data, nSensors, ch,
+				data[n].tlStructSampleMethod.CVD.pin, inv,
+				false);
+			TLChargeDelay(
+				dCh->tlStructSampleMethod.CVD.chargeDelaySensor);
+		}
+	}
+
+	/* Read last sensor. */
+	pin = data[last].tlStructSampleMethod.CVD.pin;
+	TLTransferGuard(data, ch, inv);
+	if (dCh->tlStructSampleMethod.CVD.useAdcNoiseReduction) {
+		sample = TLAnalogReadNoiseReduction(pin);
+	} else {
+		sample = TLAnalogRead(pin);
+	}
+
+	#if IS_AVR
+	if (ref_pin == TL_REFERENCE_PIN_INTERNAL_HIGH) {
+		sample = TLScaleBandgapSample(sample);
+	}
+	#endif
+
+	if (inv) {
+		sample = TL_ADC_MAX - sample;
+	}
+
+	for (n = 0; n <= last; n++) {
+		if (TLMaskHasChannel(mask, n)) {
+			TLDischargeSensor(data, nSensors, n, (n == last));
+			TLSetDrivenLevel(data, nSensors,
+				data[n].tlStructSampleMethod.CVD.pin, LOW);
+		}
+	}
+	TLSetDrivenLevel(data, nSensors, ref_pin, inv ? LOW : HIGH);
+	TLDriveGuard(dCh->tlStructSampleMethod.CVD.guardPin, LOW);
+
+	return sample;
+}
+
 int TLSampleMethodCVDPreSample(struct TLStruct * data, uint8_t nSensors,
 		uint8_t ch)
 {
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	if (d->tlStructSampleMethod.CVD.mergeMask) {
+		/* Merged sensors are measured with a single charge transfer */
+		d->tlStructSampleMethod.CVD.nCharges = 1;
+		d->tlStructSampleMethod.CVD.nChargesNext = 1;
+	}
+
 	return 0;
 }
 
@@ -418,45 +1370,87 @@ int TLSampleMethodCVDSample(struct TLStruct * data, uint8_t nSensors,
 {
 	struct TLStruct * dCh;
 	struct TLStruct * dRef;
-	uint8_t ref;
+	uint8_t ref, level;
 	int ch_pin, ref_pin, sample;
-	uint8_t i;
-
-	ref = TLChannelToReference(data, nSensors, ch);
-	if (ref == 0xFF) {
-		/* An error occurred! */
-		return 0;
-	}
+	uint32_t i;
+	bool settled;
 
 	dCh = &(data[ch]);
-	dRef = &(data[ref]);
 	ch_pin = dCh->tlStructSampleMethod.CVD.pin;
 
+	if (dCh->tlStructSampleMethod.CVD.mergeMask) {
+		return TLSampleMultiple(data, nSensors, ch,
+			dCh->tlStructSampleMethod.CVD.mergeMask, inv);
+	}
+
 	if (ch_pin < 0) {
 		/* An error occurred! */
 		return 0;
 	}
 
-	ref_pin = dRef->tlStructSampleMethod.CVD.pin;
+	ref = TLChannelToReference(data, nSensors, ch);
+	if (ref == 0xFF) {
+		#if TL_CVD_HAS_INTERNAL_REFERENCE
+		/*
+		 * This is the only CVD sensor; charge ADC from internal
+		 * reference instead of from another sensor pin.
+		 */
+		ref_pin = inv ? TL_REFERENCE_PIN_INTERNAL_LOW :
+			TL_REFERENCE_PIN_INTERNAL_HIGH;
+		#else
+		/* An error occurred! */
+		return 0;
+		#endif
+	} else {
+		dRef = &(data[ref]);
+		ref_pin = dRef->tlStructSampleMethod.CVD.pin;
+	}
+
+	conversionCount++;
+	level = inv ? HIGH : LOW;
+	settled = TLSensorIsSettled(dCh, level);
 
-	TLSetSensorAndReferencePins(ch_pin, ref_pin, inv);
+	TLSetSensorAndReferencePins(ch_pin, ref_pin,
+		dCh->tlStructSampleMethod.CVD.guardPin, inv);
+	TLSetDrivenLevel(data, nSensors, ref_pin, inv ? LOW : HIGH);
+
+	if ((TLIsInterleaved(dCh)) && (!settled) &&
+			(dCh->tlStructSampleMethod.CVD.chargeDelaySensor)) {
+		/*
+		 * Sensor has not been prepared during the measurement of
+		 * another channel; wait for it here.
+		 */
+		delayMicroseconds(dCh->tlStructSampleMethod.CVD.chargeDelaySensor);
+	}
 
 	/* Set sensor pin as analog input. */
 	pinMode(ch_pin, INPUT);
+	TLSetDrivenLevel(data, nSensors, ch_pin, TL_DRIVEN_LEVEL_UNKNOWN);
 
 	/*
 	 * Charge nCharges - 1 times to account for the charge during the
 	 * TLAnalogRead() below.
 	 */
 	for (i = 0; i < dCh->tlStructSampleMethod.CVD.nCharges - 1; i++) {
-		TLCharge(data, nSensors, ch, ch_pin, ref_pin);
+		TLCharge(data, nSensors, ch, ch_pin, ref_pin, inv);
 	}
 
 	/* Set ADC to reference pin (charge internal capacitor). */
 	TLChargeADC(data, nSensors, ch, ref_pin, true);
 
 	/* Read sensor. */
-	sample = TLAnalogRead(ch_pin);
+	TLTransferGuard(data, ch, inv);
+	if (dCh->tlStructSampleMethod.CVD.useAdcNoiseReduction) {
+		sample = TLAnalogReadNoiseReduction(ch_pin);
+	} else {
+		sample = TLAnalogRead(ch_pin);
+	}
+
+	#if IS_AVR
+	if (ref_pin == TL_REFERENCE_PIN_INTERNAL_HIGH) {
+		sample = TLScaleBandgapSample(sample);
+	}
+	#endif
 
 	if (inv) {
 		sample = TL_ADC_MAX - sample;
@@ -468,11 +1462,26 @@ int TLSampleMethodCVDSample(struct TLStruct * data, uint8_t nSensors,
 		 * charge during the TLAnalogRead() above.
 		 */
 		for (++i; i < dCh->tlStructSampleMethod.CVD.nChargesMax; i++) {
-			TLCharge(data, nSensors, ch, ch_pin, ref_pin);
+			TLCharge(data, nSensors, ch, ch_pin, ref_pin, inv);
 		}
 	}
 
-	TLDischargeSensor(data, nSensors, ch, true);
+	if (TLIsInterleaved(dCh)) {
+		/*
+		 * Another channel is measured before the next measurement of
+		 * this channel. Drive sensor to the level that next measurement
+		 * starts with (high for the inverted one) and let it settle
+		 * meanwhile instead of waiting here.
+		 */
+		level = inv ? LOW : HIGH;
+		pinMode(ch_pin, OUTPUT);
+		digitalWrite(ch_pin, level);
+	} else {
+		level = LOW;
+		TLDischargeSensor(data, nSensors, ch, true);
+	}
+	TLDriveGuard(dCh->tlStructSampleMethod.CVD.guardPin, level);
+	TLSetDrivenLevel(data, nSensors, ch_pin, level);
 
 	return sample;
 }
@@ -495,7 +1504,7 @@ int TLSampleMethodCVDMapDelta(struct TLStruct * data, uint8_t nSensors,
 
 	d = &(data[ch]);
 
-	delta = d->delta;
+	delta = TLValueToFloat(d->delta);
 
 	/*
 	 * Ignore everything below TL_BAR_LOWER_PCT of log(maxDelta); it's
@@ -512,6 +1521,158 @@ int TLSampleMethodCVDMapDelta(struct TLStruct * data, uint8_t nSensors,
 	return n;
 }
 
+/* Take 1 sample the same way as TLSensors::sample() does */
+static int32_t TLCalibrationSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	int32_t sample = 0;
+
+	if (data[ch].sampleType & TLStruct::sampleTypeNormal) {
+		sample += TLSampleMethodCVDSample(data, nSensors, ch, false);
+	}
+	if (data[ch].sampleType & TLStruct::sampleTypeInverted) {
+		sample += TLSampleMethodCVDSample(data, nSensors, ch, true);
+	}
+	if (data[ch].sampleType != TLStruct::sampleTypeDifferential) {
+		sample <<= 1;
+	}
+
+	return sample;
+}
+
+static void TLCalibrationStatistics(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, float * mean, float * var)
+{
+	float sum = 0, sumSquared = 0, tmp;
+	uint16_t i;
+
+	for (i = 0; i < TL_CHARGE_DELAY_CALIBRATION_N_MEASUREMENTS; i++) {
+		tmp = TLCalibrationSample(data, nSensors, ch);
+		sum += tmp;
+		sumSquared += tmp * tmp;
+	}
+
+	*mean = sum / TL_CHARGE_DELAY_CALIBRATION_N_MEASUREMENTS;
+	*var = sumSquared / TL_CHARGE_DELAY_CALIBRATION_N_MEASUREMENTS -
+		*mean * *mean;
+	if (*var < 0) {
+		*var = 0;
+	}
+}
+
+/*
+ * True if measurements with the current delays give the same result as the
+ * reference: the means may differ by TL_CHARGE_DELAY_CALIBRATION_SIGMAS
+ * standard errors plus 1 LSB and the variance may at most double.
+ */
+static bool TLCalibrationMatches(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, float refMean, float refVar)
+{
+	float mean, var, tolerance;
+
+	TLCalibrationStatistics(data, nSensors, ch, &mean, &var);
+
+	tolerance = TL_CHARGE_DELAY_CALIBRATION_SIGMAS * sqrt((refVar + var) /
+		TL_CHARGE_DELAY_CALIBRATION_N_MEASUREMENTS) + 1;
+
+	return (fabs(mean - refMean) <= tolerance) && (var <= 2 * refVar + 1);
+}
+
+/*
+ * Find shortest delay (0 - delayMax) that matches the reference: first try 0,
+ * 1, 2, 4, ... to find the knee, then refine with a binary search.
+ */
+static void TLCalibrateDelay(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, unsigned int * delay, unsigned int delayMax,
+		float refMean, float refVar)
+{
+	/*
+	 * lo is the shortest delay that is not known to fail, hi the shortest
+	 * delay that is known to match.
+	 */
+	unsigned int lo = 0, hi = delayMax, mid = 0;
+
+	while (mid < hi) {
+		*delay = mid;
+		if (TLCalibrationMatches(data, nSensors, ch, refMean, refVar)) {
+			hi = mid;
+			break;
+		}
+		lo = mid + 1;
+		mid = (mid == 0) ? 1 : ((mid > (hi >> 1)) ? hi : (mid << 1));
+	}
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		*delay = mid;
+		if (TLCalibrationMatches(data, nSensors, ch, refMean, refVar)) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	*delay = hi;
+}
+
+int TLSampleMethodCVDCalibrateChargeDelays(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch, unsigned int delayMax)
+{
+	struct TLStruct * d;
+	float refMean, refVar;
+
+	d = &(data[ch]);
+
+	if (d->sampleMethod != TLSampleMethodCVD) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	/* Reference: both delays long enough to settle completely */
+	d->tlStructSampleMethod.CVD.chargeDelaySensor = delayMax;
+	d->tlStructSampleMethod.CVD.chargeDelayADC = delayMax;
+	TLCalibrationStatistics(data, nSensors, ch, &refMean, &refVar);
+
+	TLCalibrateDelay(data, nSensors, ch,
+		&(d->tlStructSampleMethod.CVD.chargeDelayADC), delayMax,
+		refMean, refVar);
+	TLCalibrateDelay(data, nSensors, ch,
+		&(d->tlStructSampleMethod.CVD.chargeDelaySensor), delayMax,
+		refMean, refVar);
+
+	return 0;
+}
+
+int TLSampleMethodCVDSetMergeMask(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, uint32_t mask)
+{
+	struct TLStruct * d;
+	uint8_t n;
+
+	d = &(data[ch]);
+
+	if ((ch >= nSensors) || (d->sampleMethod != TLSampleMethodCVD)) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	for (n = 0; n < TL_MASK_N_CHANNELS; n++) {
+		if (!TLMaskHasChannel(mask, n)) {
+			continue;
+		}
+		if ((n >= nSensors) || (n == ch) ||
+				(TLElectrodeMask(data, nSensors, 1UL << n) == 0) ||
+				(data[n].muxAddress != d->muxAddress)) {
+			/* An error occurred! */
+			return -1;
+		}
+	}
+
+	d->tlStructSampleMethod.CVD.mergeMask = mask;
+
+	return 0;
+}
+
 int TLSampleMethodCVD(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
 {
 	struct TLStruct * d;
@@ -536,19 +1697,29 @@ int TLSampleMethodCVD(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
 
 	d->tlStructSampleMethod.CVD.chargeDelayADC = TL_CHARGE_DELAY_ADC_DEFAULT;
 
+	d->tlStructSampleMethod.CVD.useAdcNoiseReduction =
+		TL_USE_ADC_NOISE_REDUCTION_DEFAULT;
+	d->tlStructSampleMethod.CVD.mergeMask = 0;
+	d->tlStructSampleMethod.CVD.guardPin = TL_GUARD_PIN_DEFAULT;
+	d->tlStructSampleMethod.CVD.drivenLevel = TL_DRIVEN_LEVEL_UNKNOWN;
+	d->tlStructSampleMethod.CVD.drivenAt = 0;
+	#if TL_USE_FIXED_POINT
+	d->tlStructSampleMethod.CVD.gainScale = 0;
+	#endif
+
 	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
 	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
 	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
 	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
 
 	d->releasedToApproachedThreshold = 
-		TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
 	d->approachedToReleasedThreshold =
-		TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
 	d->approachedToPressedThreshold =
-		TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT;     
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
 	d->pressedToApproachedThreshold =
-		TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT; 
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
 
 	d->direction = TLStruct::directionPositive;
 	d->sampleType = TLStruct::sampleTypeDifferential;
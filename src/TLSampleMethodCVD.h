@@ -32,9 +32,44 @@
 #define TLSampleMethodCVD_h
 
 #include <TouchLib.h>
+#include <BoardID.h>
+
+/*
+ * On these architectures a single CVD sensor can charge the ADC from an
+ * internal reference (bandgap or VREFH when sampling normally, GND or VREFL
+ * when sampling inverted) instead of from the pin of another CVD sensor. On
+ * other architectures at least 2 CVD sensors are needed.
+ */
+#if IS_AVR || IS_TEENSY3X || IS_TEENSYLC
+#define TL_CVD_HAS_INTERNAL_REFERENCE	1
+#else
+#define TL_CVD_HAS_INTERNAL_REFERENCE	0
+#endif
+
+/*
+ * Set TL_ENABLE_ADC_NOISE_REDUCTION to 1 to make useAdcNoiseReduction work
+ * (AVR only). This defines the ADC conversion complete interrupt (ADC_vect),
+ * so it can't be used together with another library or sketch that defines
+ * it. It must be set as compiler flag for the library, not with a #define in
+ * the sketch.
+ */
+#ifndef TL_ENABLE_ADC_NOISE_REDUCTION
+#define TL_ENABLE_ADC_NOISE_REDUCTION	0
+#endif
 
 struct TLStructSampleMethodCVD {
         int pin;
+
+	/*
+	 * Large electrodes only give a small signal with a single charge
+	 * transfer. Set nChargesMax larger than 1 to enable auto-ranging: the
+	 * sensor is then charged nCharges times per measurement, where
+	 * nCharges is adapted every scan (between nChargesMin and nChargesMax)
+	 * so that the ADC value stays in its sweet spot. With
+	 * useNChargesPadding set, extra charges are added after the conversion
+	 * so that every measurement takes nChargesMax charges and the scan
+	 * time does not depend on the sensor capacitance.
+	 */
 	bool useNChargesPadding;
 	uint32_t nChargesMin;
 	uint32_t nChargesMax;
@@ -46,8 +81,65 @@ struct TLStructSampleMethodCVD {
 
 	/* delay to charge ADC in microseconds (us) */
         unsigned int chargeDelayADC; 
+
+	/*
+	 * Set useAdcNoiseReduction to true to put the CPU in ADC noise
+	 * reduction sleep mode during each conversion (AVR with
+	 * TL_ENABLE_ADC_NOISE_REDUCTION only; ignored otherwise). This reduces
+	 * switching noise from the CPU so fewer measurements per sensor are
+	 * needed for the same noise power.
+	 */
+	bool useAdcNoiseReduction;
+
+	/*
+	 * mergeMask turns this channel into a merged sensor. Bit n set means
+	 * the electrode of CVD channel n is part of the merged sensor. All
+	 * electrodes in the mask are then measured as one large electrode in a
+	 * single conversion, which makes this channel a cheap proximity sensor.
+	 * The merged channel has its own state machine and thresholds; its own
+	 * pin is not used and it is never used as reference. Only channels 0 -
+	 * 31 can be merged. Set it with TLSampleMethodCVDSetMergeMask() (or
+	 * TLSensors::setMergeMask()), which rejects masks with channels that
+	 * are not a CVD electrode. Such channels are skipped if the mask is
+	 * written directly.
+	 */
+	uint32_t mergeMask;
+
+	/*
+	 * Set guardPin to the pin of a driven shield (guard electrode) around
+	 * or below this sensor, or -1 if there is none. The guard is driven to
+	 * the same level as the sensor while the sensor is discharged and
+	 * switched along with the sensor when charge is transferred to it (in
+	 * inverse phase for inverted measurements), so the sensor to guard
+	 * capacitance sees hardly any voltage change. This removes most of the
+	 * parasitic capacitance from the measurement, which gives a larger
+	 * relative delta and needs fewer measurements per sensor.
+	 */
+	int guardPin;
+
+	/* These members will be set by the sample method. */
+	uint8_t drivenLevel; /* level pin is driven at; 0xFF if unknown */
+	uint16_t drivenAt; /* conversion count when pin was driven */
+
+	#if TL_USE_FIXED_POINT
+	/*
+	 * scale * scaleFactor / referenceValue of the integer correctSample()
+	 * as mantissa (2^14 - 2^15 - 1) and exponent, and the values it was
+	 * computed from
+	 */
+	uint32_t gainScale;
+	float gainScaleFactor;
+	float gainReferenceValue;
+	uint16_t gain;
+	int8_t gainExponent;
+	#endif
 };
 
+/* Low level ADC functions; also used by other sample methods */
+void TLSetAdcReferencePin(int pin);
+
+int TLAnalogRead(int pin);
+
 int TLSampleMethodCVDPreSample(struct TLStruct * data, uint8_t nSensors,
 		uint8_t ch);
 
@@ -60,6 +152,30 @@ int TLSampleMethodCVDPostSample(struct TLStruct * data, uint8_t nSensors,
 int TLSampleMethodCVDMapDelta(struct TLStruct * d, uint8_t nSensors, uint8_t ch,
 		int length);
 
+#define TL_CHARGE_DELAY_CALIBRATION_MAX_DEFAULT		100 /* us */
+
+/*
+ * Find the shortest chargeDelayADC and chargeDelaySensor of channel ch that
+ * give the same mean and variance as when both delays are delayMax
+ * microseconds (us), and store them in the channel. Too short delays lose
+ * charge transfer accuracy; too long delays waste scan time. Call at start up
+ * (with the sensor untouched) or on demand; see also
+ * TLSensors::calibrateChargeDelays(). Returns 0 on success.
+ */
+int TLSampleMethodCVDCalibrateChargeDelays(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch, unsigned int delayMax);
+
+/*
+ * Turn CVD channel ch into a merged sensor of the electrodes in mask (see
+ * mergeMask); mask 0 turns it back into a normal sensor. Every channel in mask
+ * must be below 32 and nSensors, must not be ch and must be a CVD sensor with
+ * a pin of its own (not a merged sensor) on the same multiplexer address as ch
+ * (or none if ch has none). Returns 0 on success or -1 (and leaves ch
+ * unchanged) if not.
+ */
+int TLSampleMethodCVDSetMergeMask(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, uint32_t mask);
+
 int TLSampleMethodCVD(struct TLStruct * data, uint8_t nSensors, uint8_t ch);
 
 #endif
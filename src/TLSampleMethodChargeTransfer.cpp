@@ -0,0 +1,248 @@
+/*
+ * TLSampleMethodChargeTransfer.cpp - Capacitive sensing implementation using
+ * charge transfer method on digital pins for TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLSampleMethodChargeTransfer.h"
+
+#define TL_SAMPLE_METHOD_CHARGE_TRANSFER_PIN		2
+#define TL_SAMPLE_METHOD_CHARGE_TRANSFER_SAMPLE_PIN	3
+
+#define TL_BURST_MAX_DEFAULT				1000
+/*
+ * Budget of all measurements of a sensor in one scan. A pulse takes about 9 pin
+ * operations, i.e. about 40 us on a 16 MHz AVR, so a 10 pF electrode with a
+ * 1 nF Cs needs about 3.5 ms per measurement; with 16 measurements per sensor
+ * that is about 60 ms per scan. Smaller electrodes need a smaller Cs or a
+ * larger timeout.
+ */
+#define TL_TIMEOUT_DEFAULT				80000 /* 80 ms */
+
+/* Check timeout only once every this many pulses; micros() is slow */
+#define TL_TIMEOUT_CHECK_INTERVAL			16
+
+/*
+ * Cs is charged until its voltage reaches the digital input threshold, which is
+ * about 0.6 * VCC on ATmega. Number of pulses is then approximately
+ * ln(1 / (1 - 0.6)) * Cs / Cx.
+ */
+#define TL_THRESHOLD_FACTOR				((float) 0.916)
+
+#define TL_REFERENCE_VALUE_DEFAULT			((float) 1000) /* 1 nF */
+#define TL_SCALE_FACTOR_DEFAULT				((float) 1)
+#define TL_OFFSET_VALUE_DEFAULT				((float) 0) /* pF */
+
+#define TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT		false
+
+#define TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT	0.5
+#define TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT	0.4
+#define TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT	2.0
+#define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	1.6
+
+int TLSampleMethodChargeTransferPreSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch)
+{
+	data[ch].tlStructSampleMethod.chargeTransfer.timedOut = false;
+	data[ch].tlStructSampleMethod.chargeTransfer.timeUsed = 0;
+
+	return 0;
+}
+
+int TLSampleMethodChargeTransferSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv)
+{
+	struct TLStruct * dCh;
+	int pin, samplePin;
+	uint16_t n, burstMax;
+	unsigned long timeout, timeUsed, start;
+	uint8_t level, idle;
+
+	dCh = &(data[ch]);
+	pin = dCh->tlStructSampleMethod.chargeTransfer.pin;
+	samplePin = dCh->tlStructSampleMethod.chargeTransfer.samplePin;
+	burstMax = dCh->tlStructSampleMethod.chargeTransfer.burstMax;
+	timeout = dCh->tlStructSampleMethod.chargeTransfer.timeout;
+	timeUsed = dCh->tlStructSampleMethod.chargeTransfer.timeUsed;
+
+	if ((pin < 0) || (samplePin < 0)) {
+		return 0; /* An error occurred */
+	}
+
+	if (dCh->tlStructSampleMethod.chargeTransfer.timedOut) {
+		/* Budget of this scan is used up; skip remaining measurements */
+		return 0;
+	}
+
+	/*
+	 * For normal measurements Cs is charged towards VCC; for inverted
+	 * measurements towards GND.
+	 */
+	level = inv ? LOW : HIGH;
+	idle = inv ? HIGH : LOW;
+
+	/* Discharge Cs and Cx */
+	pinMode(pin, OUTPUT);
+	digitalWrite(pin, idle);
+	pinMode(samplePin, OUTPUT);
+	digitalWrite(samplePin, idle);
+
+	start = micros();
+	for (n = 1; n < burstMax; n++) {
+		/* Charge Cx; samplePin floating so Cs is not affected */
+		pinMode(samplePin, INPUT);
+		digitalWrite(samplePin, LOW);
+		pinMode(pin, OUTPUT);
+		digitalWrite(pin, level);
+
+		/* Transfer charge of Cx to Cs */
+		pinMode(pin, INPUT);
+		digitalWrite(pin, LOW);
+		pinMode(samplePin, OUTPUT);
+		digitalWrite(samplePin, idle);
+
+		/* Check if voltage on Cs has reached input threshold */
+		if (digitalRead(pin) == level) {
+			break;
+		}
+
+		if ((timeout) && ((n % TL_TIMEOUT_CHECK_INTERVAL) == 0) &&
+				(timeUsed + (micros() - start) > timeout)) {
+			/* An error occurred! */
+			dCh->tlStructSampleMethod.chargeTransfer.timedOut =
+				true;
+			n = 0;
+			break;
+		}
+	}
+
+	dCh->tlStructSampleMethod.chargeTransfer.timeUsed = timeUsed +
+		(micros() - start);
+
+	/* Discharge Cs and Cx */
+	pinMode(pin, OUTPUT);
+	digitalWrite(pin, LOW);
+	pinMode(samplePin, OUTPUT);
+	digitalWrite(samplePin, LOW);
+
+	return n;
+}
+
+int TLSampleMethodChargeTransferPostSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch)
+{
+	TLStruct * d;
+	float tmp, scale;
+
+	d = &(data[ch]);
+
+	if (d->tlStructSampleMethod.chargeTransfer.timedOut) {
+		/* raw is not valid; keep the value of the previous scan */
+		return 0;
+	}
+
+	if (d->enableSlewrateLimiter) {
+		scale = (float) 2;
+	} else {
+		scale = (float) (d->nMeasurementsPerSensor << 1);
+	}
+
+	/* Average number of pulses per measurement */
+	tmp = ((float) d->raw) / scale;
+	if (tmp < 1) {
+		tmp = 1;
+	}
+
+	tmp = d->scaleFactor * d->referenceValue * TL_THRESHOLD_FACTOR / tmp;
+	d->value = TLValueFromFloat(tmp);
+
+	return 0;
+}
+
+int TLSampleMethodChargeTransferMapDelta(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch, int length)
+{
+	int n = -1;
+	struct TLStruct * d;
+	float delta;
+
+	d = &(data[ch]);
+
+	delta = TLValueToFloat(d->delta);
+
+	n = map(100 * log(delta), 0, 80 * log(d->calibratedMaxDelta), 0,
+		length);
+
+	n = (n < 0) ? 0 : n;
+	n = (n > length) ? length : n;
+
+	return n;
+}
+
+int TLSampleMethodChargeTransfer(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	d->sampleMethodPreSample = TLSampleMethodChargeTransferPreSample;
+	d->sampleMethodSample = TLSampleMethodChargeTransferSample;
+	d->sampleMethodPostSample = TLSampleMethodChargeTransferPostSample;
+	d->sampleMethodMapDelta = TLSampleMethodChargeTransferMapDelta;
+
+	d->tlStructSampleMethod.chargeTransfer.pin = (ch << 1) +
+		TL_SAMPLE_METHOD_CHARGE_TRANSFER_PIN;
+	d->tlStructSampleMethod.chargeTransfer.samplePin = (ch << 1) +
+		TL_SAMPLE_METHOD_CHARGE_TRANSFER_SAMPLE_PIN;
+	d->tlStructSampleMethod.chargeTransfer.burstMax = TL_BURST_MAX_DEFAULT;
+	d->tlStructSampleMethod.chargeTransfer.timeout = TL_TIMEOUT_DEFAULT;
+	d->tlStructSampleMethod.chargeTransfer.timedOut = false;
+	d->tlStructSampleMethod.chargeTransfer.timeUsed = 0;
+
+	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
+	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
+	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
+	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
+
+	d->releasedToApproachedThreshold =
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
+	d->approachedToReleasedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
+	d->approachedToPressedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
+	d->pressedToApproachedThreshold =
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
+
+	d->direction = TLStruct::directionPositive;
+	d->sampleType = TLStruct::sampleTypeNormal;
+
+	d->pin = &(d->tlStructSampleMethod.chargeTransfer.pin);
+
+	return 0;
+}
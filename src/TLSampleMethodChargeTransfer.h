@@ -0,0 +1,81 @@
+/*
+ * TLSampleMethodChargeTransfer.h - Capacitive sensing implementation using
+ * charge transfer method on digital pins for TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLSampleMethodChargeTransfer_h
+#define TLSampleMethodChargeTransfer_h
+
+#include <TouchLib.h>
+
+/*
+ * Charge transfer method: the electrode (Cx) is connected to pin and a
+ * sampling capacitor (Cs, typically 1 nF) is connected between pin and
+ * samplePin. Each pulse charges Cx and then transfers its charge to Cs, until
+ * the voltage on Cs trips the digital input threshold of pin. The number of
+ * pulses is inversely proportional to Cx. Only digital pins are needed.
+ */
+struct TLStructSampleMethodChargeTransfer {
+	int pin;
+	int samplePin;
+
+	/* Maximum number of pulses per measurement */
+	uint16_t burstMax;
+
+	/*
+	 * Maximum duration of all measurements of this sensor in one scan in
+	 * microseconds (us); 0 means no timeout. If the burst limit is reached,
+	 * a measurement stops at burstMax pulses (a very small electrode). If
+	 * the timeout is reached, the measurement is aborted as an error: it
+	 * returns 0, timedOut is set, the remaining measurements of the scan
+	 * are skipped and the value of the sensor is not updated for that
+	 * scan. A stalled electrode thus costs at most timeout per scan.
+	 */
+	unsigned long timeout;
+
+	/* These members will be set by the sample method. */
+	bool timedOut; /* the timeout of this scan was reached */
+	unsigned long timeUsed; /* time of measurements of this scan in us */
+};
+
+int TLSampleMethodChargeTransferPreSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch);
+
+int TLSampleMethodChargeTransferSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv);
+
+int TLSampleMethodChargeTransferPostSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch);
+
+int TLSampleMethodChargeTransferMapDelta(struct TLStruct * d, uint8_t nSensors,
+		uint8_t ch, int length);
+
+int TLSampleMethodChargeTransfer(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+#endif
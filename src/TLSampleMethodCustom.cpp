@@ -55,7 +55,7 @@ int TLSampleMethodCustomPostSample(struct TLStruct * data, uint8_t nSensors,
 
 	d = &(data[ch]);
 
-	d->value = d->raw;
+	d->value = TLValueFromFloat(d->raw);
 
 	return 0;
 }
@@ -80,13 +80,13 @@ int TLSampleMethodCustom(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
 	d->tlStructSampleMethod.custom.pin = A0 + ch;
 
 	d->releasedToApproachedThreshold = 
-		TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
 	d->approachedToReleasedThreshold =
-		TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
 	d->approachedToPressedThreshold =
-		TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT;     
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
 	d->pressedToApproachedThreshold =
-		TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT; 
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
 
 	d->direction = TLStruct::directionPositive;
 	d->sampleType = TLStruct::sampleTypeNormal;
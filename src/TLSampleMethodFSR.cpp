@@ -0,0 +1,255 @@
+/*
+ * TLSampleMethodFSR.cpp - Force sensing resistor grid implementation for
+ * TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLSampleMethodFSR.h"
+
+/* Default grid: columns A0 - A3, rows starting at pin 2 */
+#define TL_SAMPLE_METHOD_FSR_N_COLS			4
+#define TL_SAMPLE_METHOD_FSR_ROW_PIN			2
+#define TL_SAMPLE_METHOD_FSR_USE_INTERNAL_PULLUP	true
+
+/* ATmega2560 has internal pull-ups of 20 - 50 kOhm. Assume it is 35 kOhm */
+#define TL_REFERENCE_VALUE_DEFAULT			((float) 35) /* 35 kOhm */
+#define TL_SCALE_FACTOR_DEFAULT				((float) 1)
+#define TL_OFFSET_VALUE_DEFAULT				((float) 0) /* uS */
+
+#define TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT		false
+
+#define TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT	20
+#define TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT	15
+#define TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT	100
+#define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	80
+
+/* Largest column voltage (relative to VCC) used in the conversion */
+#define TL_RATIO_MAX					((float) 0.999)
+
+#if IS_PARTICLE
+#define TL_ADC_RESOLUTION_BIT					12
+#elif IS_ATMEGA
+#define TL_ADC_RESOLUTION_BIT					10
+#else
+#define TL_ADC_RESOLUTION_BIT					10
+#endif
+
+#define TL_ADC_MAX						((1 << TL_ADC_RESOLUTION_BIT) - 1)
+
+/* Row that is currently driven low; -1 if none */
+static int activeRowPin = -1;
+
+int TLSampleMethodFSRPreSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+	int rowPin, colPin;
+
+	d = &(data[ch]);
+	rowPin = d->tlStructSampleMethod.FSR.rowPin;
+	colPin = d->tlStructSampleMethod.FSR.colPin;
+
+	/*
+	 * Configure pins once per scan: all rows high (idle) and all columns
+	 * as analog input.
+	 */
+	if (rowPin >= 0) {
+		pinMode(rowPin, OUTPUT);
+		digitalWrite(rowPin, HIGH);
+	}
+	if (colPin >= 0) {
+		if (d->tlStructSampleMethod.FSR.useInternalPullup) {
+			pinMode(colPin, INPUT_PULLUP);
+		} else {
+			pinMode(colPin, INPUT);
+		}
+	}
+	activeRowPin = -1;
+
+	return 0;
+}
+
+int TLSampleMethodFSRSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv)
+{
+	struct TLStruct * dCh;
+	int rowPin, colPin;
+
+	if (inv) {
+		/* Pseudo differential measurements are not supported */
+		return 0;
+	}
+
+	dCh = &(data[ch]);
+	rowPin = dCh->tlStructSampleMethod.FSR.rowPin;
+	colPin = dCh->tlStructSampleMethod.FSR.colPin;
+
+	if ((rowPin < 0) || (colPin < 0)) {
+		return 0; /* An error occurred */
+	}
+
+	/* Only switch rows if needed */
+	if (rowPin != activeRowPin) {
+		if (activeRowPin >= 0) {
+			digitalWrite(activeRowPin, HIGH);
+		}
+		digitalWrite(rowPin, LOW);
+		activeRowPin = rowPin;
+	}
+
+	return analogRead(colPin);
+}
+
+int TLSampleMethodFSRPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+	struct TLStruct * dN;
+	float tmp, scale, g;
+	uint8_t n;
+
+	d = &(data[ch]);
+
+	/* Release all rows and columns after the scan */
+	if (d->tlStructSampleMethod.FSR.rowPin >= 0) {
+		pinMode(d->tlStructSampleMethod.FSR.rowPin, INPUT);
+	}
+	if (d->tlStructSampleMethod.FSR.colPin >= 0) {
+		pinMode(d->tlStructSampleMethod.FSR.colPin, INPUT);
+	}
+	activeRowPin = -1;
+
+	if (d->enableSlewrateLimiter) {
+		scale = (float) ((TL_ADC_MAX + 1) << 2);
+	} else {
+		scale = ((float) (d->nMeasurementsPerSensor << 1)) *
+			((float) (TL_ADC_MAX + 1));
+	}
+
+	tmp = d->raw / scale;
+	if (tmp >= TL_RATIO_MAX) {
+		/*
+		 * Column at the pull-up voltage: the node is open. Report 0
+		 * rather than the conductance of the clipped ratio, which
+		 * would otherwise show up as ghosting in the other nodes of
+		 * this column.
+		 */
+		d->value = TLValueFromFloat(0);
+
+		return 0;
+	}
+	if (tmp < 1 - TL_RATIO_MAX) {
+		tmp = 1 - TL_RATIO_MAX;
+	}
+
+	/*
+	 * The column is pulled up by the pull-up resistor (referenceValue) in
+	 * parallel with the other nodes in this column (their rows are high).
+	 * Use the latest conductance of those nodes to compensate ghosting.
+	 */
+	g = ((float) 1000) / d->referenceValue;
+	for (n = 0; n < nSensors; n++) {
+		dN = &(data[n]);
+		if ((n == ch) || (dN->sampleMethod != TLSampleMethodFSR) ||
+				(dN->tlStructSampleMethod.FSR.colPin !=
+				d->tlStructSampleMethod.FSR.colPin) ||
+				(dN->tlStructSampleMethod.FSR.rowPin ==
+				d->tlStructSampleMethod.FSR.rowPin)) {
+			continue;
+		}
+		if ((dN->value > 0) && (dN->scaleFactor > 0)) {
+			g += TLValueToFloat(dN->value) / dN->scaleFactor;
+		}
+	}
+
+	/* Node conductance in uS */
+	tmp = g * (1 - tmp) / tmp;
+
+	d->value = TLValueFromFloat(d->scaleFactor * tmp);
+
+	return 0;
+}
+
+int TLSampleMethodFSRMapDelta(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, int length)
+{
+	int n = -1;
+	struct TLStruct * d;
+	float delta;
+
+	d = &(data[ch]);
+	delta = TLValueToFloat(d->delta -
+		d->releasedToApproachedThreshold / 2);
+
+	n = map(100 * delta, 0, 100 * d->calibratedMaxDelta, 0, length);
+
+	n = (n < 0) ? 0 : n;
+	n = (n > length) ? length : n;
+
+	return n;
+}
+
+int TLSampleMethodFSR(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+{
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	d->sampleMethodPreSample = TLSampleMethodFSRPreSample;
+	d->sampleMethodSample = TLSampleMethodFSRSample;
+	d->sampleMethodPostSample = TLSampleMethodFSRPostSample;
+	d->sampleMethodMapDelta = TLSampleMethodFSRMapDelta;
+
+	d->tlStructSampleMethod.FSR.colPin = A0 +
+		(ch % TL_SAMPLE_METHOD_FSR_N_COLS);
+	d->tlStructSampleMethod.FSR.rowPin = TL_SAMPLE_METHOD_FSR_ROW_PIN +
+		(ch / TL_SAMPLE_METHOD_FSR_N_COLS);
+	d->tlStructSampleMethod.FSR.useInternalPullup =
+		TL_SAMPLE_METHOD_FSR_USE_INTERNAL_PULLUP;
+
+	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
+	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
+	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
+	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
+
+	d->releasedToApproachedThreshold =
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
+	d->approachedToReleasedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
+	d->approachedToPressedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
+	d->pressedToApproachedThreshold =
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
+
+	d->direction = TLStruct::directionPositive;
+	d->sampleType = TLStruct::sampleTypeNormal;
+
+	d->pin = &(d->tlStructSampleMethod.FSR.colPin);
+
+	return 0;
+}
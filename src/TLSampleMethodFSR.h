@@ -0,0 +1,70 @@
+/*
+ * TLSampleMethodFSR.h - Force sensing resistor grid implementation for
+ * TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLSampleMethodFSR_h
+#define TLSampleMethodFSR_h
+
+#include <TouchLib.h>
+
+/*
+ * Force sensing resistor (FSR) grid with nRows row lines (any digital pin) and
+ * nCols column lines (analog pins with pull-up), giving nRows * nCols nodes.
+ * Every node is a separate channel. During a scan all rows are driven high and
+ * the row of the node that is measured is driven low, so each column only
+ * sees the nodes in that column. The scan order is grouped by row, so every
+ * row is driven low once per scan (not with a custom scan order). The remaining ghosting (other pressed nodes
+ * in the same column act as extra pull-ups) is compensated with the values of
+ * those nodes. The value is the conductance of the node in micro Siemens (uS),
+ * so it increases with force.
+ *
+ * Use TLSensors::initializeMatrix() with TLSampleMethodFSR to map a complete
+ * grid to consecutive channels.
+ */
+struct TLStructSampleMethodFSR {
+	int rowPin;
+	int colPin;
+	bool useInternalPullup;
+};
+
+int TLSampleMethodFSRPreSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+int TLSampleMethodFSRSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv);
+
+int TLSampleMethodFSRPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+int TLSampleMethodFSRMapDelta(struct TLStruct * d, uint8_t nSensors,
+		uint8_t ch, int length);
+
+int TLSampleMethodFSR(struct TLStruct * data, uint8_t nSensors, uint8_t ch);
+
+#endif
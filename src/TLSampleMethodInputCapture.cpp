@@ -0,0 +1,341 @@
+/*
+ * TLSampleMethodInputCapture.cpp - Capacitive sensing implementation using RC
+ * timing with timer input capture for TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLSampleMethodInputCapture.h"
+#include "BoardID.h"
+
+#if IS_ATMEGA && TL_ENABLE_INPUT_CAPTURE_INTERRUPT
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#endif
+
+#define TL_SAMPLE_METHOD_INPUT_CAPTURE_DRIVE_PIN	2
+
+#define TL_TIMEOUT_DEFAULT				30000 /* CPU cycles */
+
+/*
+ * Electrode is charged from 0 V to the bandgap voltage (1.1 V) of a 5 V supply:
+ * t = R * C * ln(5 / (5 - 1.1)).
+ */
+#define TL_THRESHOLD_FACTOR				((float) 0.2485)
+
+#define TL_REFERENCE_VALUE_DEFAULT			((float) 1000) /* 1 MOhm (in kOhm) */
+#define TL_SCALE_FACTOR_DEFAULT				((float) 1)
+#define TL_OFFSET_VALUE_DEFAULT				((float) 0) /* pF */
+
+#define TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT		false
+
+#define TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT	0.5
+#define TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT	0.4
+#define TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT	2.0
+#define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	1.6
+
+#if IS_ATMEGA
+/* ACSR before the first PreSample of this scan enabled the bandgap */
+static uint8_t acsrSaved = 0;
+static bool acsrIsSaved = false;
+
+#if TL_ENABLE_INPUT_CAPTURE_INTERRUPT
+#define TL_CAPTURE_PENDING				0
+#define TL_CAPTURE_DONE					1
+#define TL_CAPTURE_TIMED_OUT				2
+
+static volatile uint8_t captureState = TL_CAPTURE_PENDING;
+static volatile uint16_t captureTime = 0;
+
+/*
+ * Timer 1 input capture interrupt. Stores the time of the edge and wakes up
+ * the CPU.
+ */
+ISR(TIMER1_CAPT_vect)
+{
+	TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+	if (captureState == TL_CAPTURE_PENDING) {
+		captureTime = ICR1;
+		captureState = TL_CAPTURE_DONE;
+	}
+}
+
+/* Timer 1 overflow interrupt: the timeout has been reached. */
+ISR(TIMER1_OVF_vect)
+{
+	TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+	if (captureState == TL_CAPTURE_PENDING) {
+		captureState = TL_CAPTURE_TIMED_OUT;
+	}
+}
+
+/*
+ * Wait in idle mode (timer 1 and the comparator keep running) until the
+ * capture or the timeout interrupt. Returns the number of timer ticks from
+ * start to the capture, or timeout if there was none.
+ */
+static uint16_t TLInputCaptureCollect(uint16_t start, uint16_t timeout)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	sleep_enable();
+	while (captureState == TL_CAPTURE_PENDING) {
+		/* sei() directly followed by sleep_cpu() can't miss a wakeup */
+		sei();
+		sleep_cpu();
+		cli();
+	}
+	sleep_disable();
+	SREG = sreg;
+
+	return (captureState == TL_CAPTURE_DONE) ?
+		(uint16_t) (captureTime - start) : timeout;
+}
+#else
+/* Poll the capture and overflow flags; see TL_ENABLE_INPUT_CAPTURE_INTERRUPT */
+static uint16_t TLInputCaptureCollect(uint16_t start, uint16_t timeout)
+{
+	while (!(TIFR1 & (_BV(ICF1) | _BV(TOV1))));
+
+	return (TIFR1 & _BV(ICF1)) ? (uint16_t) (ICR1 - start) : timeout;
+}
+#endif
+#endif
+
+int TLSampleMethodInputCapturePreSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch)
+{
+	#if IS_ATMEGA
+	/*
+	 * Enable bandgap on positive comparator input already; it needs some
+	 * time to settle. It stays on until the end of the scan.
+	 */
+	if (!acsrIsSaved) {
+		acsrSaved = ACSR;
+		acsrIsSaved = true;
+	}
+	ACSR |= _BV(ACBG);
+	#endif
+
+	return 0;
+}
+
+int TLSampleMethodInputCaptureSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv)
+{
+	int sample = 0;
+
+	#if IS_ATMEGA
+	struct TLStruct * dCh;
+	int pin, drivePin;
+	uint16_t timeout, start;
+	uint8_t tccr1a, tccr1b, timsk1, acsr, adcsra, driveBit;
+	volatile uint8_t * driveOut;
+
+	if (inv) {
+		/* Pseudo differential measurements are not supported */
+		return 0;
+	}
+
+	dCh = &(data[ch]);
+	pin = dCh->tlStructSampleMethod.inputCapture.pin;
+	drivePin = dCh->tlStructSampleMethod.inputCapture.drivePin;
+	timeout = dCh->tlStructSampleMethod.inputCapture.timeout;
+	if (timeout > INT16_MAX) {
+		timeout = INT16_MAX;
+	}
+
+	if ((pin < 0) || (drivePin < 0)) {
+		return 0; /* An error occurred */
+	}
+
+	driveOut = portOutputRegister(digitalPinToPort(drivePin));
+	driveBit = digitalPinToBitMask(drivePin);
+
+	/* Discharge electrode */
+	pinMode(drivePin, OUTPUT);
+	digitalWrite(drivePin, LOW);
+	pinMode(pin, OUTPUT);
+	digitalWrite(pin, LOW);
+	pinMode(pin, INPUT);
+
+	/*
+	 * Connect electrode to negative comparator input through the ADC
+	 * multiplexer (only possible when ADC is disabled) and route the
+	 * comparator output to the input capture unit of timer 1.
+	 */
+	adcsra = ADCSRA;
+	acsr = ACSR;
+	ADCSRA &= ~_BV(ADEN);
+	ADCSRB |= _BV(ACME);
+	TLSetAdcReferencePin(pin);
+	ACSR = _BV(ACBG) | _BV(ACIC);
+
+	/*
+	 * Comparator output falls when electrode voltage rises above bandgap;
+	 * capture on falling edge with noise canceler. The timer starts at
+	 * start so that it overflows when the timeout is reached.
+	 */
+	tccr1a = TCCR1A;
+	tccr1b = TCCR1B;
+	timsk1 = TIMSK1;
+	start = (uint16_t) (0 - timeout);
+	TCCR1A = 0;
+	TCCR1B = _BV(ICNC1) | _BV(CS10);
+	TIFR1 = _BV(ICF1) | _BV(TOV1);
+	#if TL_ENABLE_INPUT_CAPTURE_INTERRUPT
+	captureState = TL_CAPTURE_PENDING;
+	TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+	#endif
+
+	/*
+	 * Write the port directly: digitalWrite() would add tens of cycles
+	 * between starting the timer and starting the charge to every sample.
+	 */
+	noInterrupts();
+	TCNT1 = start;
+	*driveOut |= driveBit;
+	interrupts();
+
+	/* The timer holds the exact time of the edge. */
+	sample = TLInputCaptureCollect(start, timeout);
+	if (sample > timeout) {
+		sample = timeout;
+	}
+
+	/* Discharge electrode and restore timer, comparator and ADC */
+	digitalWrite(drivePin, LOW);
+	pinMode(pin, OUTPUT);
+	digitalWrite(pin, LOW);
+
+	TCCR1B = tccr1b;
+	TCCR1A = tccr1a;
+	TIFR1 = _BV(ICF1) | _BV(TOV1);
+	TIMSK1 = timsk1;
+	ACSR = acsr;
+	ADCSRB &= ~_BV(ACME);
+	ADCSRA = adcsra;
+	#endif
+
+	return sample;
+}
+
+int TLSampleMethodInputCapturePostSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch)
+{
+	TLStruct * d;
+	float tmp, scale;
+
+	d = &(data[ch]);
+
+	#if IS_ATMEGA
+	/* Switch bandgap off again (unless it was on before the scan) */
+	if (acsrIsSaved) {
+		ACSR = acsrSaved;
+		acsrIsSaved = false;
+	}
+	#endif
+
+	if (d->enableSlewrateLimiter) {
+		scale = (float) 2;
+	} else {
+		scale = (float) (d->nMeasurementsPerSensor << 1);
+	}
+
+	/* Average number of CPU cycles to reach the bandgap voltage */
+	tmp = ((float) d->raw) / scale;
+
+	/* C = t / (R * ln(...)); with R in kOhm and C in pF */
+	tmp = tmp * ((float) 1e9) / ((float) F_CPU) / d->referenceValue /
+		TL_THRESHOLD_FACTOR;
+	tmp = d->scaleFactor * tmp;
+	d->value = TLValueFromFloat(tmp);
+
+	return 0;
+}
+
+int TLSampleMethodInputCaptureMapDelta(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch, int length)
+{
+	int n = -1;
+	struct TLStruct * d;
+	float delta;
+
+	d = &(data[ch]);
+
+	delta = TLValueToFloat(d->delta);
+
+	n = map(100 * log(delta), 0, 80 * log(d->calibratedMaxDelta), 0,
+		length);
+
+	n = (n < 0) ? 0 : n;
+	n = (n > length) ? length : n;
+
+	return n;
+}
+
+int TLSampleMethodInputCapture(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	d->sampleMethodPreSample = TLSampleMethodInputCapturePreSample;
+	d->sampleMethodSample = TLSampleMethodInputCaptureSample;
+	d->sampleMethodPostSample = TLSampleMethodInputCapturePostSample;
+	d->sampleMethodMapDelta = TLSampleMethodInputCaptureMapDelta;
+
+	d->tlStructSampleMethod.inputCapture.pin = A0 + ch;
+	d->tlStructSampleMethod.inputCapture.drivePin = ch +
+		TL_SAMPLE_METHOD_INPUT_CAPTURE_DRIVE_PIN;
+	d->tlStructSampleMethod.inputCapture.timeout = TL_TIMEOUT_DEFAULT;
+
+	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
+	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
+	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
+	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
+
+	d->releasedToApproachedThreshold =
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
+	d->approachedToReleasedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
+	d->approachedToPressedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
+	d->pressedToApproachedThreshold =
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
+
+	d->direction = TLStruct::directionPositive;
+	d->sampleType = TLStruct::sampleTypeNormal;
+
+	d->pin = &(d->tlStructSampleMethod.inputCapture.pin);
+
+	return 0;
+}
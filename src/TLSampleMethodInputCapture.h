@@ -0,0 +1,89 @@
+/*
+ * TLSampleMethodInputCapture.h - Capacitive sensing implementation using RC
+ * timing with timer input capture for TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLSampleMethodInputCapture_h
+#define TLSampleMethodInputCapture_h
+
+#include <TouchLib.h>
+
+/*
+ * RC timing method with hardware input capture (ATmega only). The electrode is
+ * connected to an analog pin and through a large resistor (typically 1 MOhm)
+ * to drivePin. When drivePin is switched high, timer 1 starts counting. The
+ * analog comparator compares the electrode voltage (via the ADC multiplexer)
+ * to the internal bandgap reference and captures the timer value at the exact
+ * CPU cycle the electrode voltage crosses it, so the resolution does not
+ * depend on the speed of a polling loop. The CPU waits until the capture (or
+ * the timeout) has happened, in idle sleep mode if
+ * TL_ENABLE_INPUT_CAPTURE_INTERRUPT is set.
+ *
+ * Timer 1 and the analog comparator are borrowed during each measurement and
+ * restored afterwards; PWM on the timer 1 pins and libraries that use timer 1
+ * (such as Servo) may be disturbed.
+ */
+/*
+ * Set TL_ENABLE_INPUT_CAPTURE_INTERRUPT to 1 to let the CPU sleep in idle
+ * mode while it waits for the capture instead of polling the timer flags
+ * (less switching noise from the CPU). This defines the timer 1 input capture
+ * and overflow interrupts (TIMER1_CAPT_vect and TIMER1_OVF_vect), so it can't
+ * be used together with another library or sketch that defines them. It must
+ * be set as compiler flag for the library, not with a #define in the sketch.
+ */
+#ifndef TL_ENABLE_INPUT_CAPTURE_INTERRUPT
+#define TL_ENABLE_INPUT_CAPTURE_INTERRUPT	0
+#endif
+
+struct TLStructSampleMethodInputCapture {
+	int pin;
+	int drivePin;
+
+	/*
+	 * Maximum measurement time in timer ticks (CPU cycles); at most
+	 * INT16_MAX since a measurement is returned as int.
+	 */
+	uint16_t timeout;
+};
+
+int TLSampleMethodInputCapturePreSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch);
+
+int TLSampleMethodInputCaptureSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv);
+
+int TLSampleMethodInputCapturePostSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch);
+
+int TLSampleMethodInputCaptureMapDelta(struct TLStruct * d, uint8_t nSensors,
+		uint8_t ch, int length);
+
+int TLSampleMethodInputCapture(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+#endif
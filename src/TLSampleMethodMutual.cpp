@@ -0,0 +1,230 @@
+/*
+ * TLSampleMethodMutual.cpp - Mutual capacitance sensing implementation for
+ * TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLSampleMethodMutual.h"
+#include "TLSampleMethodCVD.h"
+#include "BoardID.h"
+
+/* Default matrix: RX lines A0 - A3, TX lines starting at pin 2 */
+#define TL_SAMPLE_METHOD_MUTUAL_N_RX			4
+#define TL_SAMPLE_METHOD_MUTUAL_TX_PIN			2
+
+#define TL_DISCHARGE_DELAY_DEFAULT			0
+
+/* Capacitance of RX line including ADC sample and hold capacitor */
+#define TL_REFERENCE_VALUE_DEFAULT			((float) 30) /* 30 pF */
+#define TL_SCALE_FACTOR_DEFAULT				((float) 1)
+#define TL_OFFSET_VALUE_DEFAULT				((float) 0) /* pF */
+
+#define TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT		false
+
+#define TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT	0.05
+#define TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT	0.04
+#define TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT	0.2
+#define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	0.16
+
+#if IS_PARTICLE
+#define TL_ADC_RESOLUTION_BIT					12
+#elif IS_ATMEGA
+#define TL_ADC_RESOLUTION_BIT					10
+#else
+#define TL_ADC_RESOLUTION_BIT					10
+#endif
+
+#define TL_ADC_MAX						((1 << TL_ADC_RESOLUTION_BIT) - 1)
+
+int TLSampleMethodMutualPreSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+	int txPin, rxPin;
+
+	d = &(data[ch]);
+	txPin = d->tlStructSampleMethod.mutual.txPin;
+	rxPin = d->tlStructSampleMethod.mutual.rxPin;
+
+	/*
+	 * Park TX and RX lines low so that the lines of the nodes that are not
+	 * being measured act as a ground plane during the scan.
+	 */
+	if (txPin >= 0) {
+		pinMode(txPin, OUTPUT);
+		digitalWrite(txPin, LOW);
+	}
+	if (rxPin >= 0) {
+		pinMode(rxPin, OUTPUT);
+		digitalWrite(rxPin, LOW);
+	}
+
+	return 0;
+}
+
+int TLSampleMethodMutualSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv)
+{
+	struct TLStruct * dCh;
+	int txPin, rxPin, sample;
+	unsigned int d;
+
+	dCh = &(data[ch]);
+	txPin = dCh->tlStructSampleMethod.mutual.txPin;
+	rxPin = dCh->tlStructSampleMethod.mutual.rxPin;
+	d = dCh->tlStructSampleMethod.mutual.dischargeDelay;
+
+	if ((txPin < 0) || (rxPin < 0)) {
+		/* An error occurred! */
+		return 0;
+	}
+
+	/*
+	 * Discharge RX line (or charge if inverted) and set TX line to the
+	 * opposite level.
+	 */
+	pinMode(txPin, OUTPUT);
+	digitalWrite(txPin, inv ? HIGH : LOW);
+	pinMode(rxPin, OUTPUT);
+	digitalWrite(rxPin, inv ? HIGH : LOW);
+
+	/* Connect ADC to RX line (discharge Chold). */
+	TLSetAdcReferencePin(rxPin);
+
+	if (d) {
+		delayMicroseconds(d);
+	}
+
+	/* Let RX line float and step TX line to couple charge into it. */
+	pinMode(rxPin, INPUT);
+	digitalWrite(txPin, inv ? LOW : HIGH);
+
+	/* Read RX line. */
+	sample = TLAnalogRead(rxPin);
+
+	if (inv) {
+		sample = TL_ADC_MAX - sample;
+	}
+
+	/* Park lines low again. */
+	digitalWrite(txPin, LOW);
+	pinMode(rxPin, OUTPUT);
+	digitalWrite(rxPin, LOW);
+
+	return sample;
+}
+
+int TLSampleMethodMutualPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	TLStruct * d;
+	float tmp, scale;
+
+	d = &(data[ch]);
+
+	if (d->enableSlewrateLimiter) {
+		scale = (float) ((TL_ADC_MAX + 1) << 2);
+	} else {
+		scale = ((float) (d->nMeasurementsPerSensor << 1)) *
+			((float) (TL_ADC_MAX + 1));
+	}
+
+	tmp = d->raw / scale;
+
+	/*
+	 * RX voltage is Cm / (Cm + Crx), with Crx the capacitance of the RX
+	 * line including Chold (referenceValue).
+	 */
+	if (tmp > ((float) 0.99)) {
+		tmp = (float) 0.99;
+	}
+	tmp = d->scaleFactor * d->referenceValue * tmp / (1 - tmp);
+
+	d->value = TLValueFromFloat(tmp);
+
+	return 0;
+}
+
+int TLSampleMethodMutualMapDelta(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, int length)
+{
+	int n = -1;
+	struct TLStruct * d;
+	float delta;
+
+	d = &(data[ch]);
+	delta = TLValueToFloat(d->delta -
+		d->releasedToApproachedThreshold / 2);
+
+	n = map(100 * delta, 0, 100 * d->calibratedMaxDelta, 0, length);
+
+	n = (n < 0) ? 0 : n;
+	n = (n > length) ? length : n;
+
+	return n;
+}
+
+int TLSampleMethodMutual(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+{
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	d->sampleMethodPreSample = TLSampleMethodMutualPreSample;
+	d->sampleMethodSample = TLSampleMethodMutualSample;
+	d->sampleMethodPostSample = TLSampleMethodMutualPostSample;
+	d->sampleMethodMapDelta = TLSampleMethodMutualMapDelta;
+
+	d->tlStructSampleMethod.mutual.rxPin = A0 +
+		(ch % TL_SAMPLE_METHOD_MUTUAL_N_RX);
+	d->tlStructSampleMethod.mutual.txPin = TL_SAMPLE_METHOD_MUTUAL_TX_PIN +
+		(ch / TL_SAMPLE_METHOD_MUTUAL_N_RX);
+	d->tlStructSampleMethod.mutual.dischargeDelay =
+		TL_DISCHARGE_DELAY_DEFAULT;
+
+	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
+	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
+	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
+	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
+
+	d->releasedToApproachedThreshold =
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
+	d->approachedToReleasedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
+	d->approachedToPressedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
+	d->pressedToApproachedThreshold =
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
+
+	d->direction = TLStruct::directionNegative;
+	d->sampleType = TLStruct::sampleTypeDifferential;
+
+	d->pin = &(d->tlStructSampleMethod.mutual.rxPin);
+
+	return 0;
+}
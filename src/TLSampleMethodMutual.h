@@ -0,0 +1,71 @@
+/*
+ * TLSampleMethodMutual.h - Mutual capacitance sensing implementation for
+ * TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLSampleMethodMutual_h
+#define TLSampleMethodMutual_h
+
+#include <TouchLib.h>
+
+/*
+ * Mutual capacitance sensing on a matrix of nTx transmit (row) lines and nRx
+ * receive (column) lines, giving nTx * nRx nodes with only nTx + nRx pins.
+ * Every node is a separate channel. The TX lines can be any digital pin; the
+ * RX lines must be analog pins. A measurement discharges the RX line and the
+ * ADC sample and hold capacitor, steps the TX line and converts the charge
+ * that was coupled into the RX line through the mutual capacitance. All other
+ * TX and RX lines are held low. A finger reduces the mutual capacitance, so
+ * the value decreases on touch.
+ *
+ * Use TLSensors::initializeMatrix() to map a complete matrix to consecutive
+ * channels.
+ */
+struct TLStructSampleMethodMutual {
+	int txPin;
+	int rxPin;
+
+	/* delay to discharge RX line and ADC in microseconds (us) */
+	unsigned int dischargeDelay;
+};
+
+int TLSampleMethodMutualPreSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+int TLSampleMethodMutualSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv);
+
+int TLSampleMethodMutualPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+int TLSampleMethodMutualMapDelta(struct TLStruct * d, uint8_t nSensors,
+		uint8_t ch, int length);
+
+int TLSampleMethodMutual(struct TLStruct * data, uint8_t nSensors, uint8_t ch);
+
+#endif
@@ -35,6 +35,7 @@
 
 #define TL_SAMPLE_METHOD_RESISTIVE_GND_PIN		2
 #define TL_SAMPLE_METHOD_RESISTIVE_USE_INTERNAL_PULLUP	true
+#define TL_SAMPLE_METHOD_RESISTIVE_USE_BATCHED_SAMPLING	false
 
 /* ATmega2560 has internal pull-ups of 20 - 50 kOhm. Assume it is 35 kOhm */
 #define TL_REFERENCE_VALUE_DEFAULT			((float) 35) /* 35 kOhm */
@@ -75,9 +76,96 @@
 
 #endif
 
+static void TLConfigurePins(struct TLStruct * d)
+{
+	int ch_pin, gnd_pin;
+
+	ch_pin = d->tlStructSampleMethod.resistive.pin;
+	gnd_pin = d->tlStructSampleMethod.resistive.gndPin;
+
+	if (d->tlStructSampleMethod.resistive.useInternalPullup) {
+		/* Enable internal pull-up on analog input */
+		pinMode(ch_pin, INPUT_PULLUP);
+	} else {
+		/* Disable internal pull-up on analog input */
+		pinMode(ch_pin, INPUT);
+	}
+
+	if (gnd_pin >= 0) {
+		/* Configure gnd_pin as digital output, low (gnd) */
+		pinMode(gnd_pin, OUTPUT);
+		digitalWrite(gnd_pin, LOW);
+	}
+}
+
+static void TLRestorePins(struct TLStruct * d)
+{
+	int ch_pin, gnd_pin;
+
+	ch_pin = d->tlStructSampleMethod.resistive.pin;
+	gnd_pin = d->tlStructSampleMethod.resistive.gndPin;
+
+	/* Disable internal pull-up on analog input */
+	pinMode(ch_pin, INPUT);
+
+	if (gnd_pin >= 0) {
+		/* Leave gnd_pin floating */
+		pinMode(gnd_pin, INPUT);
+		digitalWrite(gnd_pin, LOW);
+	}
+}
+
+/*
+ * Pins can only be configured once per scan if no other sensor reconfigures
+ * them in between.
+ */
+static bool TLCanBatch(struct TLStruct * data, uint8_t nSensors, uint8_t ch)
+{
+	struct TLStruct * d;
+	uint8_t n;
+	int pin, gnd_pin;
+
+	d = &(data[ch]);
+	pin = d->tlStructSampleMethod.resistive.pin;
+	gnd_pin = d->tlStructSampleMethod.resistive.gndPin;
+
+	for (n = 0; n < nSensors; n++) {
+		if ((n == ch) || (data[n].pin == NULL)) {
+			continue;
+		}
+		if (data[n].sampleMethod == TLSampleMethodResistive) {
+			if (data[n].tlStructSampleMethod.resistive.useBatchedSampling) {
+				continue;
+			}
+			if ((gnd_pin >= 0) && (gnd_pin ==
+					data[n].tlStructSampleMethod.resistive.gndPin)) {
+				return false;
+			}
+		}
+		if ((*(data[n].pin) == pin) || (*(data[n].pin) == gnd_pin)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 int TLSampleMethodResistivePreSample(struct TLStruct * data, uint8_t nSensors,
 		uint8_t ch)
 {
+	struct TLStruct * d;
+
+	d = &(data[ch]);
+
+	d->tlStructSampleMethod.resistive.batched =
+		d->tlStructSampleMethod.resistive.useBatchedSampling &&
+		(d->tlStructSampleMethod.resistive.pin >= 0) &&
+		TLCanBatch(data, nSensors, ch);
+
+	if (d->tlStructSampleMethod.resistive.batched) {
+		TLConfigurePins(d);
+	}
+
 	return 0;
 }
 
@@ -85,8 +173,7 @@ int TLSampleMethodResistiveSample(struct TLStruct * data, uint8_t nSensors,
 		uint8_t ch, bool inv)
 {
 	struct TLStruct * dCh;
-	int ch_pin, gnd_pin, sample;
-	bool useInternalPullup;
+	int ch_pin, sample;
 	
 	if (inv) {
 		/* Pseudo differential measurements are not supported */
@@ -94,39 +181,22 @@ int TLSampleMethodResistiveSample(struct TLStruct * data, uint8_t nSensors,
 	} else {
 		dCh = &(data[ch]);
 		ch_pin = dCh->tlStructSampleMethod.resistive.pin;
-		gnd_pin = dCh->tlStructSampleMethod.resistive.gndPin;
-		useInternalPullup =
-			dCh->tlStructSampleMethod.resistive.useInternalPullup;
 
 		if (ch_pin < 0) {
 			return 0; /* An error occurred */
 		}
 
-		if (useInternalPullup) {
-			/* Enable internal pull-up on analog input */
-			pinMode(ch_pin, INPUT_PULLUP);
-		} else {
-			/* Disable internal pull-up on analog input */
-			pinMode(ch_pin, INPUT);
-		}
-		
-		if (gnd_pin >= 0) {
-			/* Configure gnd_pin as digital output, low (gnd) */
-			pinMode(gnd_pin, OUTPUT);
-			digitalWrite(gnd_pin, LOW);
+		if (dCh->tlStructSampleMethod.resistive.batched) {
+			/* Pins have been configured in PreSample */
+			return analogRead(ch_pin);
 		}
 
+		TLConfigurePins(dCh);
+
 		/* Read */
 		sample = analogRead(ch_pin);
 
-		/* Disable internal pull-up on analog input */
-		pinMode(ch_pin, INPUT);
-		
-		if (gnd_pin >= 0) {
-			/* Leave gnd_pin floating */
-			pinMode(gnd_pin, INPUT);
-			digitalWrite(gnd_pin, LOW);
-		}
+		TLRestorePins(dCh);
 	}
 
 	return sample;
@@ -140,6 +210,10 @@ int TLSampleMethodResistivePostSample(struct TLStruct * data, uint8_t nSensors,
 
 	d = &(data[ch]);
 
+	if (d->tlStructSampleMethod.resistive.batched) {
+		TLRestorePins(d);
+	}
+
 	if (d->enableSlewrateLimiter) {
 		scale = (float) ((TL_ADC_MAX + 1) << 2);
 	} else {
@@ -171,7 +245,7 @@ int TLSampleMethodResistivePostSample(struct TLStruct * data, uint8_t nSensors,
 
 	#endif
 
-	d->value = tmp;
+	d->value = TLValueFromFloat(tmp);
 	/* Resistance can be negative due to noise! */
 
 	return 0;
@@ -185,7 +259,8 @@ int TLSampleMethodResistiveMapDelta(struct TLStruct * data, uint8_t nSensors,
 	float delta;
 
 	d = &(data[ch]);
-	delta = d->delta - d->releasedToApproachedThreshold / 2;
+	delta = TLValueToFloat(d->delta -
+		d->releasedToApproachedThreshold / 2);
 
 	n = map(100 * delta, 0, 100 * d->calibratedMaxDelta, 0, length);
 
@@ -212,6 +287,9 @@ int TLSampleMethodResistive(struct TLStruct * data, uint8_t nSensors,
 		TL_SAMPLE_METHOD_RESISTIVE_GND_PIN;
 	d->tlStructSampleMethod.resistive.useInternalPullup =
 		TL_SAMPLE_METHOD_RESISTIVE_USE_INTERNAL_PULLUP;
+	d->tlStructSampleMethod.resistive.useBatchedSampling =
+		TL_SAMPLE_METHOD_RESISTIVE_USE_BATCHED_SAMPLING;
+	d->tlStructSampleMethod.resistive.batched = false;
 
 	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
 	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
@@ -220,13 +298,13 @@ int TLSampleMethodResistive(struct TLStruct * data, uint8_t nSensors,
 	d->tlStructSampleMethod.resistive.valueMax = TL_VALUE_MAX_DEFAULT;
 
 	d->releasedToApproachedThreshold = 
-		TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
 	d->approachedToReleasedThreshold =
-		TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
 	d->approachedToPressedThreshold =
-		TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT;     
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
 	d->pressedToApproachedThreshold =
-		TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT; 
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
 
 	d->direction = TLStruct::directionNegative;
 
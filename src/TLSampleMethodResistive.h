@@ -38,6 +38,18 @@ struct TLStructSampleMethodResistive {
 	int gndPin;
 	int useInternalPullup;
 	float valueMax;
+
+	/*
+	 * Set useBatchedSampling to true to configure the pull-up and gndPin
+	 * only once per scan instead of for every measurement; measurements are
+	 * then just conversions. If pin or gndPin is shared with a sensor that
+	 * uses another sample method, the pins are still configured for every
+	 * measurement.
+	 */
+	bool useBatchedSampling;
+
+	/* These members will be set by the sample method. */
+	bool batched;
 };
 
 int TLSampleMethodResistivePreSample(struct TLStruct * data, uint8_t nSensors,
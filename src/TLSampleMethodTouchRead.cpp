@@ -30,6 +30,7 @@
 
 #include "TouchLib.h"
 #include "TLSampleMethodTouchRead.h"
+#include "BoardID.h"
 
 #define TL_REFERENCE_VALUE_DEFAULT			((float) 20000) /* 0.02 pF */
 #define TL_SCALE_FACTOR_DEFAULT				((float) 1)
@@ -43,9 +44,165 @@
 #define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	6.0
 #define TL_TOUCHREAD_MAX				((1 << 16) - 1)
 
+#define TL_USE_HARDWARE_SCAN_DEFAULT			false
+
+#define TL_HAS_TSI_SCAN		(IS_TEENSY30 || IS_TEENSY31 || IS_TEENSY32)
+
+#if TL_HAS_TSI_SCAN
+/* Same settings as touchRead() in the Teensy core */
+#define TL_TSI_CURRENT					2
+#define TL_TSI_NSCAN					9
+#define TL_TSI_PRESCALE					2
+
+#define TL_TSI_N_CHANNELS				16
+#define TL_TSI_INVALID					255
+
+/* Copied from touch.c in the Teensy core */
+static const uint8_t pin2tsi[] = {
+	/* 0    1    2    3    4    5    6    7    8    9 */
+	   9,  10, 255, 255, 255, 255, 255, 255, 255, 255,
+	 255, 255, 255, 255, 255,  13,   0,   6,   8,   7,
+	 255, 255,  14,  15, 255,  12, 255, 255, 255, 255,
+	 255, 255,  11,   5
+};
+
+/* TSI channels that take part in the hardware scan */
+static uint16_t tsiEnabledMask = 0;
+
+/* TSI channels of which the result has not yet been used */
+static uint16_t tsiFreshMask = 0;
+
+/* TSI channels that have a result */
+static uint16_t tsiValidMask = 0;
+
+static bool tsiScanInProgress = false;
+static uint16_t tsiCount[TL_TSI_N_CHANNELS];
+
+static uint8_t TLPinToTsi(int pin)
+{
+	if ((pin < 0) || (pin >= (int) sizeof(pin2tsi))) {
+		return TL_TSI_INVALID;
+	}
+
+	return pin2tsi[pin];
+}
+
+static void TLTsiStartScan(void)
+{
+	/*
+	 * Stop the module and clear the end of scan and out of range flags
+	 * (write 1 to clear); a touchRead() leaves them set.
+	 */
+	TSI0_GENCS = TSI_GENCS_EOSF | TSI_GENCS_OUTRGF;
+	TSI0_PEN = tsiEnabledMask;
+	TSI0_SCANC = TSI_SCANC_REFCHRG(3) | TSI_SCANC_EXTCHRG(TL_TSI_CURRENT);
+	TSI0_GENCS = TSI_GENCS_NSCN(TL_TSI_NSCAN) |
+		TSI_GENCS_PS(TL_TSI_PRESCALE) | TSI_GENCS_TSIEN |
+		TSI_GENCS_SWTS;
+
+	tsiScanInProgress = true;
+}
+
+static void TLTsiFinishScan(void)
+{
+	uint8_t n;
+
+	/* Wait for end of scan */
+	while (!(TSI0_GENCS & TSI_GENCS_EOSF));
+	TSI0_GENCS |= TSI_GENCS_EOSF;
+
+	for (n = 0; n < TL_TSI_N_CHANNELS; n++) {
+		if (tsiEnabledMask & (1 << n)) {
+			tsiCount[n] = *((volatile uint16_t *) (&TSI0_CNTR1) + n);
+		}
+	}
+
+	tsiFreshMask = tsiEnabledMask;
+	tsiValidMask = tsiEnabledMask;
+	tsiScanInProgress = false;
+}
+
+static int TLTsiRead(uint8_t tsi)
+{
+	uint16_t mask = (1 << tsi);
+	int sample;
+
+	if (!(tsiFreshMask & mask)) {
+		if ((!tsiScanInProgress) && (!tsiFreshMask)) {
+			TLTsiStartScan();
+		}
+
+		if ((tsiScanInProgress) && ((TSI0_GENCS & TSI_GENCS_EOSF) ||
+				(!(tsiValidMask & mask)))) {
+			/*
+			 * Scan has finished, or there is no result for this
+			 * channel yet; wait for it.
+			 */
+			TLTsiFinishScan();
+		}
+
+		if (!(tsiFreshMask & mask)) {
+			/*
+			 * Result of this channel was already used and the next
+			 * scan is still running or waits until the other
+			 * channels have used their results (this channel is
+			 * measured again first, e.g. with randomized scan
+			 * order or multiple measurements per sensor). Use the
+			 * last result again instead of waiting for a scan of
+			 * all channels.
+			 */
+			return tsiCount[tsi];
+		}
+	}
+
+	sample = tsiCount[tsi];
+	tsiFreshMask &= ~mask;
+
+	if (tsiFreshMask == 0) {
+		/*
+		 * All results are used; start the next scan in the background
+		 * while the CPU does other work.
+		 */
+		TLTsiStartScan();
+	}
+
+	return sample;
+}
+#endif
+
 int TLSampleMethodTouchReadPreSample(struct TLStruct * data, uint8_t nSensors,
 		uint8_t ch)
 {
+	#if TL_HAS_TSI_SCAN
+	struct TLStruct * dCh;
+	uint8_t tsi;
+	uint16_t mask;
+
+	dCh = &(data[ch]);
+	if (!dCh->tlStructSampleMethod.touchRead.useHardwareScan) {
+		return 0;
+	}
+
+	tsi = TLPinToTsi(dCh->tlStructSampleMethod.touchRead.pin);
+	if (tsi == TL_TSI_INVALID) {
+		return 0;
+	}
+
+	mask = (1 << tsi);
+	if (!(tsiEnabledMask & mask)) {
+		/* New channel; configure pin for TSI and restart scanning */
+		*portConfigRegister(dCh->tlStructSampleMethod.touchRead.pin) =
+			PORT_PCR_MUX(0);
+		SIM_SCGC5 |= SIM_SCGC5_TSI;
+
+		if (tsiScanInProgress) {
+			TLTsiFinishScan();
+		}
+		tsiEnabledMask |= mask;
+		tsiFreshMask = 0;
+	}
+	#endif
+
 	return 0;
 }
 
@@ -67,7 +224,22 @@ int TLSampleMethodTouchReadSample(struct TLStruct * data, uint8_t nSensors,
 		sample = 0;
 	} else {
 
+		#if TL_HAS_TSI_SCAN
+		if ((dCh->tlStructSampleMethod.touchRead.useHardwareScan) &&
+				(TLPinToTsi(ch_pin) != TL_TSI_INVALID)) {
+			sample = TLTsiRead(TLPinToTsi(ch_pin));
+		} else
+		#endif
 		if (ch_pin >= 0) {
+			#if TL_HAS_TSI_SCAN
+			if (tsiScanInProgress) {
+				/*
+				 * touchRead() reprograms the TSI and would
+				 * abort the hardware scan.
+				 */
+				TLTsiFinishScan();
+			}
+			#endif
 			sample = touchRead(ch_pin);
 		}
 	}
@@ -102,7 +274,7 @@ int TLSampleMethodTouchReadPostSample(struct TLStruct * data, uint8_t nSensors,
 
         tmp = d->raw / scale;
         tmp = d->scaleFactor * d->referenceValue * tmp;
-        d->value = tmp;
+        d->value = TLValueFromFloat(tmp);
         /* Capacitance can be negative due to noise! */
 
         return 0;
@@ -118,7 +290,7 @@ int TLSampleMethodTouchReadMapDelta(struct TLStruct * data, uint8_t nSensors,
 
 	d = &(data[ch]);
 
-	delta = d->delta;
+	delta = TLValueToFloat(d->delta);
 
 	n = map(100 * log(delta), 0, 80 * log(d->calibratedMaxDelta), 0,
 		length);
@@ -151,19 +323,22 @@ int TLSampleMethodTouchRead(struct TLStruct * data, uint8_t nSensors,
 		d->tlStructSampleMethod.touchRead.pin = (ch - 9 + 29);
 	}
 
+	d->tlStructSampleMethod.touchRead.useHardwareScan =
+		TL_USE_HARDWARE_SCAN_DEFAULT;
+
 	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
 	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
 	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
 	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
 
 	d->releasedToApproachedThreshold =
-		TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
 	d->approachedToReleasedThreshold =
-		TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
 	d->approachedToPressedThreshold =
-		TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
 	d->pressedToApproachedThreshold =
-		TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT;
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
 
 	d->direction = TLStruct::directionPositive;
 	d->sampleType = TLStruct::sampleTypeNormal;
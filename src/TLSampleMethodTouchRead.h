@@ -35,6 +35,17 @@
 
 struct TLStructSampleMethodTouchRead {
         int pin;
+
+	/*
+	 * Set useHardwareScan to true to let the TSI peripheral measure all
+	 * touchRead channels in a single hardware scan instead of calling
+	 * touchRead() for each measurement. The next scan is started in the
+	 * background as soon as all results of the previous scan have been
+	 * used; a channel that is measured again before the next scan has
+	 * finished gets its last result again. Only supported on Teensy 3.0 / 3.1 / 3.2; ignored
+	 * elsewhere.
+	 */
+	bool useHardwareScan;
 };
 
 int TLSampleMethodTouchReadPreSample(struct TLStruct * data, uint8_t nSensors,
@@ -0,0 +1,314 @@
+/*
+ * TLSampleMethodTouchScreen.cpp - 4-wire resistive touch screen implementation
+ * for TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLSampleMethodTouchScreen.h"
+
+#define TL_SAMPLE_METHOD_TOUCH_SCREEN_XP_PIN		8
+#define TL_SAMPLE_METHOD_TOUCH_SCREEN_XM_PIN		(A0 + 2)
+#define TL_SAMPLE_METHOD_TOUCH_SCREEN_YP_PIN		(A0 + 3)
+#define TL_SAMPLE_METHOD_TOUCH_SCREEN_YM_PIN		9
+
+#define TL_SETTLE_DELAY_DEFAULT				0
+
+/* Resistance of the X plate */
+#define TL_REFERENCE_VALUE_DEFAULT			((float) 300) /* 300 Ohm */
+#define TL_SCALE_FACTOR_DEFAULT				((float) 1)
+#define TL_OFFSET_VALUE_DEFAULT				((float) 0)
+
+#define TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT		false
+
+#define TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT	200
+#define TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT	150
+#define TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT	1000
+#define TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT	800
+
+#if IS_PARTICLE
+#define TL_ADC_RESOLUTION_BIT					12
+#elif IS_ATMEGA
+#define TL_ADC_RESOLUTION_BIT					10
+#else
+#define TL_ADC_RESOLUTION_BIT					10
+#endif
+
+#define TL_ADC_MAX						((1 << TL_ADC_RESOLUTION_BIT) - 1)
+
+static void TLSettle(struct TLStructSampleMethodTouchScreen * t)
+{
+	if (t->settleDelay) {
+		delayMicroseconds(t->settleDelay);
+	}
+}
+
+/* Y drive: gradient over Y plate; read X plate */
+static void TLDriveY(struct TLStructSampleMethodTouchScreen * t)
+{
+	pinMode(t->xpPin, INPUT);
+	pinMode(t->xmPin, INPUT);
+	pinMode(t->ypPin, OUTPUT);
+	digitalWrite(t->ypPin, HIGH);
+	pinMode(t->ymPin, OUTPUT);
+	digitalWrite(t->ymPin, LOW);
+}
+
+/* Pressure drive (from Y drive): XP low, YM high; read XM and YP */
+static void TLDrivePressure(struct TLStructSampleMethodTouchScreen * t)
+{
+	pinMode(t->ypPin, INPUT);
+	digitalWrite(t->ymPin, HIGH);
+	pinMode(t->xpPin, OUTPUT);
+	digitalWrite(t->xpPin, LOW);
+}
+
+/* X drive (from pressure drive): gradient over X plate; read Y plate */
+static void TLDriveX(struct TLStructSampleMethodTouchScreen * t)
+{
+	pinMode(t->ymPin, INPUT);
+	digitalWrite(t->xpPin, HIGH);
+	pinMode(t->xmPin, OUTPUT);
+	digitalWrite(t->xmPin, LOW);
+}
+
+static void TLRelease(struct TLStructSampleMethodTouchScreen * t)
+{
+	pinMode(t->xpPin, INPUT);
+	pinMode(t->xmPin, INPUT);
+	pinMode(t->ypPin, INPUT);
+	pinMode(t->ymPin, INPUT);
+}
+
+static uint8_t TLFindPressureChannel(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStructSampleMethodTouchScreen * t;
+	struct TLStructSampleMethodTouchScreen * tN;
+	uint8_t n;
+
+	t = &(data[ch].tlStructSampleMethod.touchScreen);
+
+	for (n = 0; n < nSensors; n++) {
+		tN = &(data[n].tlStructSampleMethod.touchScreen);
+		if ((data[n].sampleMethod == TLSampleMethodTouchScreen) &&
+				(tN->axis == TL_TOUCH_SCREEN_AXIS_PRESSURE) &&
+				(tN->xpPin == t->xpPin) &&
+				(tN->xmPin == t->xmPin) &&
+				(tN->ypPin == t->ypPin) &&
+				(tN->ymPin == t->ymPin)) {
+			return n;
+		}
+	}
+
+	return 0xFF;
+}
+
+int TLSampleMethodTouchScreenPreSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch)
+{
+	struct TLStructSampleMethodTouchScreen * t;
+
+	t = &(data[ch].tlStructSampleMethod.touchScreen);
+
+	t->chPressure = TLFindPressureChannel(data, nSensors, ch);
+
+	if (t->axis == TL_TOUCH_SCREEN_AXIS_PRESSURE) {
+		t->count = 0;
+		t->xSum = 0;
+		t->ySum = 0;
+		t->z1Sum = 0;
+		t->z2Sum = 0;
+
+		/* Every measurement starts and ends with Y drive */
+		TLDriveY(t);
+	}
+
+	return 0;
+}
+
+int TLSampleMethodTouchScreenSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv)
+{
+	struct TLStructSampleMethodTouchScreen * t;
+	int z1;
+
+	if (inv) {
+		/* Pseudo differential measurements are not supported */
+		return 0;
+	}
+
+	t = &(data[ch].tlStructSampleMethod.touchScreen);
+
+	if (t->axis != TL_TOUCH_SCREEN_AXIS_PRESSURE) {
+		/* Readings are taken by the pressure channel */
+		return 0;
+	}
+
+	TLDrivePressure(t);
+	TLSettle(t);
+	z1 = analogRead(t->xmPin);
+	t->z1Sum += z1;
+	t->z2Sum += analogRead(t->ypPin);
+
+	TLDriveX(t);
+	TLSettle(t);
+	t->xSum += analogRead(t->ypPin);
+
+	TLDriveY(t);
+	TLSettle(t);
+	t->ySum += analogRead(t->xmPin);
+
+	t->count++;
+
+	return z1;
+}
+
+int TLSampleMethodTouchScreenPostSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch)
+{
+	struct TLStruct * d;
+	struct TLStructSampleMethodTouchScreen * t;
+	struct TLStructSampleMethodTouchScreen * tP;
+	float x, tmp;
+
+	d = &(data[ch]);
+	t = &(d->tlStructSampleMethod.touchScreen);
+
+	if (t->chPressure == 0xFF) {
+		/* An error occurred! */
+		return -1;
+	}
+	tP = &(data[t->chPressure].tlStructSampleMethod.touchScreen);
+
+	if (tP->count == 0) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	switch (t->axis) {
+	case TL_TOUCH_SCREEN_AXIS_X:
+		tmp = ((float) tP->xSum) / ((float) tP->count) /
+			((float) (TL_ADC_MAX + 1));
+		break;
+	case TL_TOUCH_SCREEN_AXIS_Y:
+		tmp = ((float) tP->ySum) / ((float) tP->count) /
+			((float) (TL_ADC_MAX + 1));
+		break;
+	default:
+		TLRelease(t);
+
+		/*
+		 * Touch resistance is Rx * (1 - x) * (z2 / z1 - 1), with Rx
+		 * the resistance of the X plate (referenceValue) and Rx * (1 -
+		 * x) the part between touch and xpPin. Use conductance so that
+		 * no touch gives 0 instead of infinity.
+		 */
+		x = 1 - ((float) tP->xSum) / ((float) tP->count) /
+			((float) (TL_ADC_MAX + 1));
+		if ((tP->z1Sum <= 0) || (x <= 0)) {
+			tmp = 0;
+		} else if (tP->z2Sum <= tP->z1Sum) {
+			/* Touch resistance below resolution; clip */
+			tmp = ((float) 1e6) / d->referenceValue / x *
+				((float) tP->z1Sum);
+		} else {
+			tmp = ((float) 1e6) / d->referenceValue / x *
+				((float) tP->z1Sum) /
+				((float) (tP->z2Sum - tP->z1Sum));
+		}
+		break;
+	}
+
+	d->value = TLValueFromFloat(d->scaleFactor * tmp);
+
+	return 0;
+}
+
+int TLSampleMethodTouchScreenMapDelta(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch, int length)
+{
+	int n = -1;
+	struct TLStruct * d;
+	float delta;
+
+	d = &(data[ch]);
+	delta = TLValueToFloat(d->delta -
+		d->releasedToApproachedThreshold / 2);
+
+	n = map(100 * delta, 0, 100 * d->calibratedMaxDelta, 0, length);
+
+	n = (n < 0) ? 0 : n;
+	n = (n > length) ? length : n;
+
+	return n;
+}
+
+int TLSampleMethodTouchScreen(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	struct TLStruct * d;
+	struct TLStructSampleMethodTouchScreen * t;
+
+	d = &(data[ch]);
+	t = &(d->tlStructSampleMethod.touchScreen);
+
+	d->sampleMethodPreSample = TLSampleMethodTouchScreenPreSample;
+	d->sampleMethodSample = TLSampleMethodTouchScreenSample;
+	d->sampleMethodPostSample = TLSampleMethodTouchScreenPostSample;
+	d->sampleMethodMapDelta = TLSampleMethodTouchScreenMapDelta;
+
+	t->xpPin = TL_SAMPLE_METHOD_TOUCH_SCREEN_XP_PIN;
+	t->xmPin = TL_SAMPLE_METHOD_TOUCH_SCREEN_XM_PIN;
+	t->ypPin = TL_SAMPLE_METHOD_TOUCH_SCREEN_YP_PIN;
+	t->ymPin = TL_SAMPLE_METHOD_TOUCH_SCREEN_YM_PIN;
+	t->axis = TL_TOUCH_SCREEN_AXIS_PRESSURE;
+	t->settleDelay = TL_SETTLE_DELAY_DEFAULT;
+	t->chPressure = 0xFF;
+	t->count = 0;
+
+	d->referenceValue = TL_REFERENCE_VALUE_DEFAULT;
+	d->offsetValue = TL_OFFSET_VALUE_DEFAULT;
+	d->scaleFactor = TL_SCALE_FACTOR_DEFAULT;
+	d->setOffsetValueManually = TL_SET_OFFSET_VALUE_MANUALLY_DEFAULT;
+
+	d->releasedToApproachedThreshold =
+		TLValueFromFloat(TL_RELEASED_TO_APPROACHED_THRESHOLD_DEFAULT);
+	d->approachedToReleasedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_RELEASED_THRESHOLD_DEFAULT);
+	d->approachedToPressedThreshold =
+		TLValueFromFloat(TL_APPROACHED_TO_PRESSED_THRESHOLD_DEFAULT);
+	d->pressedToApproachedThreshold =
+		TLValueFromFloat(TL_PRESSED_TO_APPROACHED_THRESHOLD_DEFAULT);
+
+	d->direction = TLStruct::directionPositive;
+	d->sampleType = TLStruct::sampleTypeNormal;
+
+	d->pin = &(t->xmPin);
+
+	return 0;
+}
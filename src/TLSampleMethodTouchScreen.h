@@ -0,0 +1,87 @@
+/*
+ * TLSampleMethodTouchScreen.h - 4-wire resistive touch screen implementation
+ * for TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLSampleMethodTouchScreen_h
+#define TLSampleMethodTouchScreen_h
+
+#include <TouchLib.h>
+
+#define TL_TOUCH_SCREEN_AXIS_X				0
+#define TL_TOUCH_SCREEN_AXIS_Y				1
+#define TL_TOUCH_SCREEN_AXIS_PRESSURE			2
+
+/*
+ * 4-wire resistive touch screen. A touch screen uses 3 channels with the same
+ * pins: an X and Y position channel and a pressure channel. xmPin and ypPin
+ * must be analog pins. The pressure channel takes all readings: each of its
+ * measurements cycles through the pressure, X and Y drives in an order where
+ * only the pins that change between drives are reconfigured. Its value is the
+ * conductance of the touch in micro Siemens (uS); it is the only channel with
+ * a touch state machine. The value of the position channels is the position
+ * as fraction (0 - 1) of the screen times scaleFactor; it is only valid while
+ * the pressure channel is pressed.
+ *
+ * Use TLSensors::initializeTouchScreen() to set up all 3 channels.
+ */
+struct TLStructSampleMethodTouchScreen {
+	int xpPin;
+	int xmPin;
+	int ypPin;
+	int ymPin;
+	uint8_t axis;
+
+	/* delay after switching drives in microseconds (us) */
+	unsigned int settleDelay;
+
+	/* These members will be set by the sample method. */
+	uint8_t chPressure; /* 0xFF if not found */
+	uint16_t count;
+	int32_t xSum;
+	int32_t ySum;
+	int32_t z1Sum;
+	int32_t z2Sum;
+};
+
+int TLSampleMethodTouchScreenPreSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch);
+
+int TLSampleMethodTouchScreenSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv);
+
+int TLSampleMethodTouchScreenPostSample(struct TLStruct * data,
+		uint8_t nSensors, uint8_t ch);
+
+int TLSampleMethodTouchScreenMapDelta(struct TLStruct * d, uint8_t nSensors,
+		uint8_t ch, int length);
+
+int TLSampleMethodTouchScreen(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch);
+
+#endif
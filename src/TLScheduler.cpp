@@ -0,0 +1,106 @@
+/*
+ * TLScheduler.cpp - Shared ADC scheduler for multiple TLSensors instances for
+ * TouchLibrary for Arduino
+ * 
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TouchLib.h"
+#include "TLScheduler.h"
+
+TLScheduler::TLScheduler(void)
+{
+	nInstances = 0;
+}
+
+int8_t TLScheduler::add(void * sensors, int8_t (*sample)(void * sensors,
+	uint8_t step), unsigned long scanPeriod)
+{
+	uint8_t n;
+
+	if ((sensors == NULL) || (sample == NULL) || (nInstances >= TL_SCHEDULER_N_INSTANCES_MAX)) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	n = nInstances;
+	this->sensors[n] = sensors;
+	this->sample[n] = sample;
+	this->scanPeriod[n] = scanPeriod;
+	this->scanStartTime[n] = micros();
+	this->scanIsActive[n] = false;
+	nInstances++;
+
+	return n;
+}
+
+int8_t TLScheduler::update(void)
+{
+	unsigned long now, deadline = 0, t;
+	int8_t k = -1;
+	uint8_t n;
+
+	now = micros();
+
+	/* Earliest deadline first, using wrap around safe time differences */
+	for (n = 0; n < nInstances; n++) {
+		if ((!scanIsActive[n]) &&
+				((long) (now - scanStartTime[n]) < 0)) {
+			/* Waiting for next scan period */
+			continue;
+		}
+		t = scanStartTime[n] + scanPeriod[n];
+		if ((k < 0) || ((long) (t - deadline) < 0)) {
+			k = n;
+			deadline = t;
+		}
+	}
+
+	if (k < 0) {
+		return -2;
+	}
+
+	if (!scanIsActive[k]) {
+		sample[k](sensors[k], TL_SCHEDULER_SAMPLE_BEGIN);
+		scanIsActive[k] = true;
+	}
+
+	if (!sample[k](sensors[k], TL_SCHEDULER_SAMPLE_STEP)) {
+		return -1;
+	}
+
+	sample[k](sensors[k], TL_SCHEDULER_SAMPLE_END);
+	scanIsActive[k] = false;
+
+	scanStartTime[k] += scanPeriod[k];
+	now = micros();
+	if ((long) (now - scanStartTime[k]) > (long) scanPeriod[k]) {
+		/* More than a scan period behind; don't try to catch up */
+		scanStartTime[k] = now;
+	}
+
+	return k;
+}
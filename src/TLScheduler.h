@@ -0,0 +1,129 @@
+/*
+ * TLScheduler.h - Shared ADC scheduler for multiple TLSensors instances for
+ * TouchLibrary for Arduino
+ *
+ * https://github.com/AdmarSchoonen/TLSensor
+ * Copyright (c) 2016 - 2017 Admar Schoonen
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TLScheduler_h
+#define TLScheduler_h
+
+#include <TouchLib.h>
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+class TLSensors;
+
+/* Steps of a scan; see TLSchedulerSample() */
+#define TL_SCHEDULER_SAMPLE_BEGIN		0
+#define TL_SCHEDULER_SAMPLE_STEP		1
+#define TL_SCHEDULER_SAMPLE_END			2
+
+/*
+ * Takes a step of a scan of sensors, a TLSensors instance. sample() is
+ * equivalent to TL_SCHEDULER_SAMPLE_BEGIN, TL_SCHEDULER_SAMPLE_STEP until it
+ * returns 1 and TL_SCHEDULER_SAMPLE_END. The scheduler stores a pointer to an
+ * instantiation of this function next to each instance, so instances with
+ * different N_SENSORS and N_MEASUREMENTS_PER_SENSOR can be registered with the
+ * same TLScheduler without virtual functions (whose vtables are copied to RAM
+ * on AVR).
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+int8_t TLSchedulerSample(void * sensors, uint8_t step)
+{
+	TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR> * s;
+
+	s = (TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR> *) sensors;
+
+	switch (step) {
+	case TL_SCHEDULER_SAMPLE_BEGIN:
+		s->sampleBegin();
+		return 0;
+	case TL_SCHEDULER_SAMPLE_STEP:
+		return s->sampleStep() ? 1 : 0;
+	default:
+		return s->sampleEnd();
+	}
+}
+
+#define TL_SCHEDULER_N_INSTANCES_MAX		4
+
+/*
+ * Acquisition scheduler for multiple TLSensors instances that share the same
+ * ADC. Instead of calling sample() of each instance (which blocks the ADC for
+ * a full scan), register the instances with add() and call update() as often
+ * as possible. Every call takes a single measurement of the instance with the
+ * earliest deadline (the end of its current scan period), so the measurements
+ * of a slow instance (for example proximity sensors with many measurements per
+ * sensor) are interleaved with those of a fast instance (buttons) and both
+ * meet their scan rates as long as the ADC is not overloaded. When overloaded,
+ * the next scan of an instance starts immediately instead of trying to catch
+ * up.
+ *
+ * The instances must not share multiplexer select lines: each instance only
+ * changes the select lines when it thinks the address has changed.
+ */
+class TLScheduler
+{
+	public:
+		TLScheduler(void);
+
+		/*
+		 * Register sensors with a target scan period in microseconds
+		 * (us). Returns the index of the instance, or -1 if there are
+		 * already TL_SCHEDULER_N_INSTANCES_MAX instances.
+		 */
+		template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+		int8_t add(TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR> *
+			sensors, unsigned long scanPeriod)
+		{
+			return add((void *) sensors, TLSchedulerSample<N_SENSORS,
+				N_MEASUREMENTS_PER_SENSOR>, scanPeriod);
+		}
+
+		/* Same as above with an explicit step function */
+		int8_t add(void * sensors, int8_t (*sample)(void * sensors,
+			uint8_t step), unsigned long scanPeriod);
+
+		/*
+		 * Take one measurement. Returns the index of the instance that
+		 * completed a scan with this measurement, -1 if no scan was
+		 * completed or -2 if all instances are idle (waiting for
+		 * their next scan period).
+		 */
+		int8_t update(void);
+
+		uint8_t nInstances;
+
+	private:
+		void * sensors[TL_SCHEDULER_N_INSTANCES_MAX];
+		int8_t (*sample[TL_SCHEDULER_N_INSTANCES_MAX])(void * sensors,
+			uint8_t step);
+		unsigned long scanPeriod[TL_SCHEDULER_N_INSTANCES_MAX];
+		unsigned long scanStartTime[TL_SCHEDULER_N_INSTANCES_MAX];
+		bool scanIsActive[TL_SCHEDULER_N_INSTANCES_MAX];
+};
+
+#endif
@@ -43,14 +43,223 @@
 #endif
 #include <math.h>
 
+#if ARDUINO >= 100 || !defined(SPARK)
+#include <avr/pgmspace.h>
+#endif
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+#ifndef pgm_read_byte
+#define pgm_read_byte(addr) (*((const uint8_t *) (addr)))
+#endif
+
+#ifndef pgm_read_word
+#define pgm_read_word(addr) (*((const uint16_t *) (addr)))
+#endif
+
+#ifndef pgm_read_dword
+#define pgm_read_dword(addr) (*((const uint32_t *) (addr)))
+#endif
+
 #ifdef EEPROM_h
 #include <avr/eeprom.h>
 #endif
 
+/*
+ * Set TL_USE_FIXED_POINT to 1 to use fixed point instead of floating point for
+ * value, avg, delta, maxDelta, noisePower and the thresholds in TLStruct and in
+ * the processing of every scan (updateAvg(), processSample(), isPressed(),
+ * ...). This avoids soft float operations on 8 bit parts. It changes the layout
+ * of TLStruct, so it must be set as compiler flag for all source files (the
+ * sketch and the library), not with a #define in the sketch.
+ *
+ * The fixed point format is Q23.8: a 32 bit signed integer with 8 fractional
+ * bits (range -8388608 - 8388607.996, resolution 1/256). The CVD sample method
+ * computes the value with integer operations; the other sample methods still
+ * compute it in floating point and convert it with TLValueFromFloat().
+ * Use TLValueFromFloat() to set thresholds and TLValueToFloat() to print
+ * values; both work with and without fixed point.
+ */
+#ifndef TL_USE_FIXED_POINT
+#define TL_USE_FIXED_POINT					0
+#endif
+
+#if TL_USE_FIXED_POINT
+typedef int32_t TLValue;
+
+#define TL_VALUE_FRAC_BITS					8
+#define TL_VALUE_ONE						(((TLValue) 1) << TL_VALUE_FRAC_BITS)
+#define TL_VALUE_MAX						((TLValue) 0x7FFFFFFFL)
+#define TL_VALUE_MIN						(-TL_VALUE_MAX - 1)
+
+/* Largest value whose square does not overflow 32 bits */
+#define TL_VALUE_SQUARE_MAX					46340
+
+static inline TLValue TLValueFromFloat(float f)
+{
+	f = f * (float) TL_VALUE_ONE;
+
+	/* Saturate and round to nearest */
+	if (!(f < (float) TL_VALUE_MAX)) {
+		return (f == f) ? TL_VALUE_MAX : 0;
+	}
+	if (f <= (float) TL_VALUE_MIN) {
+		return TL_VALUE_MIN;
+	}
+
+	return (TLValue) ((f < 0) ? (f - (float) 0.5) : (f + (float) 0.5));
+}
+
+static inline float TLValueToFloat(TLValue v)
+{
+	return ((float) v) / ((float) TL_VALUE_ONE);
+}
+
+/* (counter * avg + x) / (counter + 1), rounded to nearest */
+static inline TLValue TLValueAverage(TLValue avg, TLValue x, uint32_t counter)
+{
+	int32_t d;
+	uint32_t n, h;
+
+	d = x - avg;
+	n = counter + 1;
+	h = n >> 1;
+
+	if (d >= 0) {
+		return avg + (TLValue) ((((uint32_t) d) + h) / n);
+	} else {
+		return avg - (TLValue) ((((uint32_t) -d) + h) / n);
+	}
+}
+
+/* avg + (x - avg) / 2^shift, rounded to nearest */
+static inline TLValue TLValueAverageShift(TLValue avg, TLValue x, uint8_t shift)
+{
+	int32_t d;
+	uint32_t h;
+
+	if (shift == 0) {
+		return x;
+	}
+
+	d = x - avg;
+	h = 1UL << (shift - 1);
+
+	if (d >= 0) {
+		return avg + (TLValue) ((((uint32_t) d) + h) >> shift);
+	} else {
+		return avg - (TLValue) ((((uint32_t) -d) + h) >> shift);
+	}
+}
+
+/* a * b, rounded to nearest and saturated */
+static inline TLValue TLValueMultiply(TLValue a, TLValue b)
+{
+	uint32_t ua, ub;
+	uint64_t p;
+	bool negative;
+
+	negative = ((a < 0) != (b < 0));
+	ua = (a < 0) ? -((uint32_t) a) : (uint32_t) a;
+	ub = (b < 0) ? -((uint32_t) b) : (uint32_t) b;
+
+	if ((ua < TL_VALUE_SQUARE_MAX) && (ub < TL_VALUE_SQUARE_MAX)) {
+		/* Fast path: 32 bit multiplication */
+		p = ((ua * ub) + (TL_VALUE_ONE >> 1)) >> TL_VALUE_FRAC_BITS;
+	} else {
+		p = ((((uint64_t) ua) * ub) + (TL_VALUE_ONE >> 1)) >>
+			TL_VALUE_FRAC_BITS;
+		if (p > (uint64_t) TL_VALUE_MAX) {
+			p = TL_VALUE_MAX;
+		}
+	}
+
+	return negative ? -((TLValue) p) : (TLValue) p;
+}
+#else
+typedef float TLValue;
+
+static inline TLValue TLValueFromFloat(float f)
+{
+	return f;
+}
+
+static inline float TLValueToFloat(TLValue v)
+{
+	return v;
+}
+
+static inline TLValue TLValueAverage(TLValue avg, TLValue x, uint32_t counter)
+{
+	return (counter * avg + x) / (counter + 1);
+}
+
+/*
+ * ldexp() only changes the exponent, so this is cheaper than the division of
+ * TLValueAverage(), but the subtraction and addition remain soft float
+ * operations on 8 bit parts.
+ */
+static inline TLValue TLValueAverageShift(TLValue avg, TLValue x, uint8_t shift)
+{
+	return avg + ldexp(x - avg, -shift);
+}
+
+static inline TLValue TLValueMultiply(TLValue a, TLValue b)
+{
+	return a * b;
+}
+#endif
+
+/*
+ * log2(filterCoeff) rounded to the nearest power of two; the shift of the
+ * filter once it has warmed up.
+ */
+static inline uint8_t TLFilterShiftMax(uint16_t filterCoeff)
+{
+	uint8_t shiftMax = 0;
+
+	while ((shiftMax < 15) && (((uint32_t) filterCoeff) * filterCoeff >=
+			(2UL << (2 * shiftMax)))) {
+		shiftMax++;
+	}
+
+	return shiftMax;
+}
+
+/*
+ * Shift for TLValueAverageShift() that replaces the division by counter + 1 of
+ * TLValueAverage(): log2(counter + 1) rounded down during warm-up, limited to
+ * shiftMax (see TLFilterShiftMax()).
+ */
+static inline uint8_t TLFilterShift(uint32_t counter, uint8_t shiftMax)
+{
+	uint8_t shift = 0;
+
+	if (counter >= (1UL << shiftMax)) {
+		/* Warmed up */
+		return shiftMax;
+	}
+
+	while ((shift < shiftMax) && ((counter + 1) >> (shift + 1))) {
+		shift++;
+	}
+
+	return shift;
+}
+
+#include <TLSampleMethodChargeTransfer.h>
 #include <TLSampleMethodCustom.h>
 #include <TLSampleMethodCVD.h>
+#include <TLSampleMethodInputCapture.h>
+#include <TLSampleMethodMutual.h>
+#include <TLSampleMethodBulk.h>
+#include <TLSampleMethodFSR.h>
+#include <TLSampleMethodTouchScreen.h>
 #include <TLSampleMethodResistive.h>
 #include <TLSampleMethodTouchRead.h>
+#include <TLScheduler.h>
 #include <BoardID.h>
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -79,9 +288,14 @@ struct TLStruct {
 		 * than or equal to buttonStateApproached and smaller than or
 		 * equal to buttonStateApproachedToReleased as "approached".
 		 *
-		 * Additionally, button state smaller than or equal to
-		 * buttonStateNoisePowerMeasurement can be considered as
-		 * "calibrating".
+		 * Additionally, button state smaller than
+		 * buttonStateReleased can be considered as "calibrating".
+		 *
+		 * buttonStateNoisePowerMeasurement is deprecated: noise power
+		 * is measured during buttonStateCalibrating, so the library
+		 * never enters it. It is kept so existing sketches still
+		 * build; if a sketch sets it, the button is released on the
+		 * next scan.
 		 */
 		buttonStatePreCalibrating = 0,
 		buttonStateCalibrating = 1,
@@ -136,6 +350,12 @@ struct TLStruct {
 		struct TLStructSampleMethodResistive resistive;
 		struct TLStructSampleMethodTouchRead touchRead;
 		struct TLStructSampleMethodCustom custom;
+		struct TLStructSampleMethodChargeTransfer chargeTransfer;
+		struct TLStructSampleMethodInputCapture inputCapture;
+		struct TLStructSampleMethodMutual mutual;
+		struct TLStructSampleMethodBulk bulk;
+		struct TLStructSampleMethodFSR FSR;
+		struct TLStructSampleMethodTouchScreen touchScreen;
 	} tlStructSampleMethod;
 
 	/*
@@ -145,10 +365,10 @@ struct TLStruct {
 	enum Direction direction;
 	enum SampleType sampleType;
 	int * pin;
-	float releasedToApproachedThreshold; /* stored in EEPROM */
-	float approachedToReleasedThreshold; /* stored in EEPROM */
-	float approachedToPressedThreshold; /* stored in EEPROM */
-	float pressedToApproachedThreshold; /* stored in EEPROM */
+	TLValue releasedToApproachedThreshold; /* stored in EEPROM */
+	TLValue approachedToReleasedThreshold; /* stored in EEPROM */
+	TLValue approachedToPressedThreshold; /* stored in EEPROM */
+	TLValue pressedToApproachedThreshold; /* stored in EEPROM */
 	float calibratedMaxDelta;
 	uint32_t releasedToApproachedTime;
 	uint32_t approachedToReleasedTime;
@@ -160,6 +380,32 @@ struct TLStruct {
 	unsigned long approachedTimeout;
 	unsigned long pressedTimeout;
 	uint16_t filterCoeff;
+	/*
+	 * Set enableShiftFilter to true to update avg and noisePower with a
+	 * shift instead of a division per scan. filterCoeff is then rounded to
+	 * the nearest power of two, 1 << filterShift. filterShift is computed
+	 * from filterCoeff when calibration starts. Only with
+	 * TL_USE_FIXED_POINT the filter is an integer shift; the float build
+	 * saves the division but still uses float operations (see
+	 * TLValueAverageShift()).
+	 */
+	bool enableShiftFilter;
+	uint8_t filterShift;
+	/*
+	 * Set enableSpikeRejection to true to drop the lowest and the highest
+	 * of the nMeasurementsPerSensor measurements of each scan (trimmed
+	 * mean), so a single spike (e.g. ESD) does not end up in raw. raw is
+	 * scaled back to the full number of measurements. Needs at least 3
+	 * measurements per sensor; ignored with enableSlewrateLimiter.
+	 */
+	bool enableSpikeRejection;
+	/*
+	 * Bit n of the forceCalibrationWhen* masks is channel n. The masks are
+	 * 32 bit, so only channels 0 - 31 can be forced to calibrate by a state
+	 * change. With more than 32 sensors (see initializeMux()), channels 32
+	 * and up can still have masks of their own, but can't be in one; put
+	 * sensors that must calibrate together in the first 32 channels.
+	 */
 	uint32_t forceCalibrationWhenReleasingFromApproached;
 	uint32_t forceCalibrationWhenApproachingFromReleased;
 	uint32_t forceCalibrationWhenApproachingFromPressed;
@@ -167,6 +413,14 @@ struct TLStruct {
 	bool setOffsetValueManually;
 	bool disableUpdateIfAnyButtonIsApproached;
 	bool disableUpdateIfAnyButtonIsPressed;
+
+	/*
+	 * Address of the sensor on an external analog multiplexer (such as
+	 * 74HC4067) or -1 if the sensor is connected directly. See
+	 * TLSensors::initializeMux().
+	 */
+	int8_t muxAddress;
+
 	float referenceValue; /* in pico Farad (pF) */
 	float offsetValue; /* in pico Farad (pF) */
 	float scaleFactor;
@@ -176,6 +430,12 @@ struct TLStruct {
 	 * - TLSampleMethodCVD
 	 * - TLSampleMethodResistive
 	 * - TLSampleMethodTouchRead (Teensy 3.x only)
+	 * - TLSampleMethodChargeTransfer
+	 * - TLSampleMethodInputCapture (AVR only)
+	 * - TLSampleMethodMutual
+	 * - TLSampleMethodBulk
+	 * - TLSampleMethodFSR
+	 * - TLSampleMethodTouchScreen
 	 * - custom method
 	 *
 	 * It is used only during initialization and should set callback
@@ -196,6 +456,7 @@ struct TLStruct {
 	 * the inv parameter indicates if an inverted measurement is requested.
 	 * This is used in pseudo differential measurements. If inverted
 	 * measurements are not supported, just check return 0 when inv == true.
+	 * It can be NULL if all readings are taken in sampleMethodPreSample.
 	 */
 	int (*sampleMethodSample)(struct TLStruct * d, uint8_t nSensors,
 		uint8_t ch, bool inv);
@@ -217,28 +478,40 @@ struct TLStruct {
 	/*
 	 * Set enableTouchStateMachine to false to only use a sensor for
 	 * capacitive sensing or during tuning. After startup, sensor will be in
-	 * state buttonStatePreCalibrating followed by buttonStateCalibrating
-	 * and buttonStateNoisePowerMeasurement. After noise measurement the
-	 * state will switch to buttonStateReleased and stay there.
+	 * state buttonStatePreCalibrating followed by buttonStateCalibrating.
+	 * After calibration the state will switch to buttonStateReleased and
+	 * stay there.
 	 */
 	bool enableTouchStateMachine;
 
 	/*
 	 * Set enableNoisePowerMeasurement to true to measure noise power.
 	 * This is useful during tuning or debugging but adds processing time.
+	 * noisePower is the variance of value, measured during calibration and
+	 * updated like avg afterwards.
 	 */
 	bool enableNoisePowerMeasurement;
 
+	/*
+	 * Set interleaveInvertedSample to true (sampleTypeDifferential only)
+	 * to take the inverted measurement of this channel after the normal
+	 * measurement of the next channel in the scan order instead of
+	 * directly after its own normal measurement. Sample methods that
+	 * support it (CVD) let the sensor settle for its next measurement while
+	 * the other channel is measured instead of waiting for it.
+	 */
+	bool interleaveInvertedSample;
+
 	/* These members will be set by the init / sample methods. */
 	uint8_t nSensors;
 	uint8_t nMeasurementsPerSensor;
 	int32_t raw;
 	/* Total value in pico Farad (pF) */
-	float value;
-	float avg;
-	float delta;
-	float maxDelta;
-	float noisePower;
+	TLValue value;
+	TLValue avg;
+	TLValue delta;
+	TLValue maxDelta;
+	TLValue noisePower;
 	enum ButtonState buttonState;
 	const char * buttonStateLabel; /* human readable label */
 	bool buttonIsCalibrating; /* use this to see if button is calibrating */
@@ -247,15 +520,146 @@ struct TLStruct {
 	bool buttonIsPressed; /* use this to see if button is pressed */
 	bool forcedCal;
 	uint32_t counter;
+	/*
+	 * Deprecated: noise power is averaged with counter now. noiseCounter
+	 * is kept for existing sketches and is always equal to counter.
+	 */
 	uint32_t noiseCounter;
 	uint32_t recalCounter;
 	unsigned long lastSampledAtTime;
 	unsigned long stateChangedAtTime;
 	bool slewrateFirstSample;
+	uint8_t nSamples;
+	int32_t sampleMin;
+	int32_t sampleMax;
 	bool stateIsBeingChanged;
 	bool disableSensor; /* set to true for dummy sensors */
 };
 
+/*
+ * Compile time generation of the default scan order. Entry i of the scan order
+ * is a pseudo random permutation of 0 .. length - 1 (a bijective mix of i on
+ * the smallest power of 2 that is large enough, cycle walking until the result
+ * is smaller than length) modulo nSensors, so every channel occurs exactly
+ * nMeasurementsPerSensor times. Only C++11 constexpr is used so this works
+ * with all supported compilers.
+ */
+constexpr uint16_t TLScanOrderMask(uint16_t n, uint16_t mask)
+{
+	return (mask >= n) ? mask : TLScanOrderMask(n, (mask << 1) | 1);
+}
+
+constexpr uint8_t TLScanOrderBits(uint16_t mask)
+{
+	return mask ? (1 + TLScanOrderBits(mask >> 1)) : 0;
+}
+
+constexpr uint32_t TLScanOrderXorShift(uint32_t x, uint8_t shift)
+{
+	return x ^ (x >> shift);
+}
+
+constexpr uint32_t TLScanOrderMix(uint32_t x, uint16_t mask, uint8_t shift)
+{
+	return TLScanOrderXorShift(((TLScanOrderXorShift((x * 0x9E3779B1UL +
+		0x7F4AUL) & mask, shift)) * 0x85EBCA6BUL) & mask, shift);
+}
+
+constexpr uint32_t TLScanOrderWalk(uint32_t x, uint16_t length, uint16_t mask,
+		uint8_t shift)
+{
+	return (x < length) ? x : TLScanOrderWalk(TLScanOrderMix(x, mask,
+		shift), length, mask, shift);
+}
+
+constexpr uint8_t TLScanOrderEntry(uint8_t nSensors, uint16_t length,
+		uint16_t mask, uint16_t i)
+{
+	return TLScanOrderWalk(TLScanOrderMix(i, mask,
+		(TLScanOrderBits(mask) + 1) >> 1), length, mask,
+		(TLScanOrderBits(mask) + 1) >> 1) % nSensors;
+}
+
+/*
+ * Index sequence 0 .. N - 1 (std::index_sequence is C++14); built by
+ * concatenating halves so the template depth is only log2(N).
+ */
+template <uint16_t... I>
+struct TLIndexSequence {
+	typedef TLIndexSequence type;
+};
+
+template <class S1, class S2>
+struct TLIndexSequenceConcat;
+
+template <uint16_t... I1, uint16_t... I2>
+struct TLIndexSequenceConcat<TLIndexSequence<I1...>, TLIndexSequence<I2...> > :
+	TLIndexSequence<I1..., (sizeof...(I1) + I2)...> {};
+
+template <uint16_t N>
+struct TLMakeIndexSequence : TLIndexSequenceConcat<
+	typename TLMakeIndexSequence<N / 2>::type,
+	typename TLMakeIndexSequence<N - N / 2>::type> {};
+
+template <>
+struct TLMakeIndexSequence<0> : TLIndexSequence<> {};
+
+template <>
+struct TLMakeIndexSequence<1> : TLIndexSequence<0> {};
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR,
+	class S = typename TLMakeIndexSequence<((uint16_t) N_SENSORS) *
+	((uint16_t) N_MEASUREMENTS_PER_SENSOR)>::type>
+struct TLScanOrderTable;
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR, uint16_t... I>
+struct TLScanOrderTable<N_SENSORS, N_MEASUREMENTS_PER_SENSOR,
+		TLIndexSequence<I...> > {
+	static const uint8_t order[sizeof...(I)];
+};
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR, uint16_t... I>
+const uint8_t TLScanOrderTable<N_SENSORS, N_MEASUREMENTS_PER_SENSOR,
+		TLIndexSequence<I...> >::order[sizeof...(I)] PROGMEM = {
+	TLScanOrderEntry(N_SENSORS, sizeof...(I),
+		TLScanOrderMask(sizeof...(I) - 1, 1), I)...
+};
+
+/*
+ * Strides for randomizeScanOrder: TL_N_SCAN_STRIDES values spread over
+ * 1 .. length - 1 that are coprime with length (so the walk with them is a
+ * permutation), generated at compile time so no gcd has to be computed while
+ * scanning.
+ */
+#define TL_N_SCAN_STRIDES					16
+
+constexpr uint16_t TLScanStrideGcd(uint16_t a, uint16_t b)
+{
+	return (b == 0) ? a : TLScanStrideGcd(b, a % b);
+}
+
+constexpr uint16_t TLScanStrideFrom(uint16_t stride, uint16_t length)
+{
+	return (stride >= length) ? 1 : ((TLScanStrideGcd(length, stride) ==
+		1) ? stride : TLScanStrideFrom(stride + 1, length));
+}
+
+template <uint16_t LENGTH, class S = typename
+	TLMakeIndexSequence<TL_N_SCAN_STRIDES>::type>
+struct TLScanStrideTable;
+
+template <uint16_t LENGTH, uint16_t... I>
+struct TLScanStrideTable<LENGTH, TLIndexSequence<I...> > {
+	static const uint16_t stride[sizeof...(I)];
+};
+
+template <uint16_t LENGTH, uint16_t... I>
+const uint16_t TLScanStrideTable<LENGTH, TLIndexSequence<I...> >::stride[
+		sizeof...(I)] PROGMEM = {
+	TLScanStrideFrom(1 + ((uint32_t) I) * LENGTH / TL_N_SCAN_STRIDES,
+		LENGTH)...
+};
+
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
 class TLSensors
 {
@@ -265,26 +669,63 @@ class TLSensors
 		bool enableReadSettingsFromEeprom;
 		int eepromOffset;
 
-		/*
-		 * Ideally scanOrder would be a static const uint8_t array the
-		 * size of nSensors * nMeasurementPerSensor with a pseudo random
-		 * sequence generated by the C preprocessor. I just don't know
-		 * how to do this (or if it is possible at all). For now, we'll
-		 * just use RAM and initialize it at start up, wasting some
-		 * precious RAM space.
-		 */
-		uint8_t scanOrder[N_SENSORS * N_MEASUREMENTS_PER_SENSOR];
 		uint8_t	nMeasurementsPerSensor;
 		int8_t error;
 
+		/*
+		 * Select lines of external analog multiplexers (such as
+		 * 74HC4067), least significant bit first. The select lines
+		 * are shared by all multiplexers; the common pin of each
+		 * multiplexer is connected to its own analog pin. The scan
+		 * order is grouped by multiplexer address (in Gray code order,
+		 * so only 1 select line changes between groups) and
+		 * muxSettleDelay is only spent when the address changes.
+		 */
+		const int * muxSelectPins;
+		uint8_t nMuxSelectPins;
+		unsigned int muxSettleDelay; /* in microseconds (us) */
+
+		/*
+		 * The scan order is pseudo random but the same every scan, so
+		 * periodic interference that aliases with the scan period is
+		 * not averaged out. Set randomizeScanOrder to true to permute
+		 * the scan order before every scan and set scanGapMax to
+		 * insert a random gap of 0 - scanGapMax microseconds (us)
+		 * before every measurement. This spreads narrowband
+		 * interference over the spectrum so the same noise power can
+		 * be reached with fewer measurements per sensor. Ignored for
+		 * custom scan orders. The permutation is a walk over the scan
+		 * order in flash with a random offset and one of
+		 * TL_N_SCAN_STRIDES strides, not a Fisher-Yates shuffle, which
+		 * would need a copy of the scan order in RAM.
+		 */
+		bool randomizeScanOrder;
+		unsigned int scanGapMax; /* in microseconds (us) */
+
 		void writeSettingsToEeprom(void);
 		int8_t setDefaults(void);
 		int initialize(uint8_t ch, int (*sampleMethod)(
 			struct TLStruct * d, uint8_t nSensors, uint8_t ch));
+		int initializeMatrix(uint8_t chStart, const int * txPins,
+			uint8_t nTx, const int * rxPins, uint8_t nRx,
+			int (*sampleMethod)(struct TLStruct * d,
+			uint8_t nSensors, uint8_t ch) = TLSampleMethodMutual);
+		int initializeTouchScreen(uint8_t chStart, int xpPin,
+			int xmPin, int ypPin, int ymPin);
+		int initializeMux(uint8_t ch, int (*sampleMethod)(
+			struct TLStruct * d, uint8_t nSensors, uint8_t ch),
+			int pin, int8_t muxAddress);
+		int calibrateChargeDelays(uint8_t ch, unsigned int delayMax =
+			TL_CHARGE_DELAY_CALIBRATION_MAX_DEFAULT);
+		int setMergeMask(uint8_t ch, uint32_t mask);
 		int8_t sample(void);
+		void sampleBegin(void);
+		bool sampleStep(void);
+		int8_t sampleEnd(void);
 		int findSensorPair(uint8_t ch, uint8_t chStart);
 		int printBar(uint8_t ch_k, int length);
 		void printScanOrder(void);
+		uint8_t getScanOrder(uint16_t pos);
 		bool setForceCalibratingStates(int ch, uint32_t mask,
 			enum TLStruct::ButtonState * newState);
 		float getRaw(int n);
@@ -302,6 +743,7 @@ class TLSensors
 			enum TLStruct::ButtonState newState);
 		void setState(int n, enum TLStruct::ButtonState newState);
 		TLSensors(void);
+		TLSensors(const uint8_t customScanOrder[]);
 		~TLSensors(void);
 
 		/* call backs: */
@@ -310,7 +752,22 @@ class TLSensors
 			enum TLStruct::ButtonState newState);
 
 	private:
-		bool useCustomScanOrder;
+		/*
+		 * The default scan order is generated at compile time and read
+		 * from flash (TLScanOrderTable); a custom scan order is read
+		 * from customScanOrder.
+		 */
+		const uint8_t * customScanOrder;
+		uint16_t scanOffset;
+		uint16_t scanStride;
+		uint16_t scanPos;
+		uint16_t scanIndex;
+		int16_t scanKey;
+		uint16_t scanKeyRemaining;
+		int8_t muxAddressSelected;
+		uint8_t pendingCh;
+		int pendingSample;
+		uint16_t lfsr;
 		bool anyButtonIsApproached;
 		bool anyButtonIsPressed;
 
@@ -336,16 +793,18 @@ class TLSensors
 		void writeSensorSettingToEeprom(int n, int * addr, 
 			uint16_t * crc);
 		void readSettingsFromEeprom(void);
-		int8_t addChannel(uint8_t ch);
 		void addSample(uint8_t ch, int32_t sample);
+		void trimSamples(uint8_t ch);
+		void samplePendingInverted(void);
+		void sampleChannel(uint8_t ch);
 		bool isPressed(TLStruct * d);
 		bool isApproached(TLStruct * d);
 		bool isReleased(TLStruct * d);
 		bool isCalibrating(TLStruct * d);
+		uint32_t filterCounterMax(TLStruct * d);
 		void updateAvg(uint8_t ch);
 		void processStatePreCalibrating(uint8_t ch);
 		void processStateCalibrating(uint8_t ch);
-		void processStateNoisePowerMeasurement(uint8_t ch);
 		void processStateReleased(uint8_t ch);
 		void processStateReleasedToApproached(uint8_t ch);
 		void processStateApproached(uint8_t ch);
@@ -355,7 +814,12 @@ class TLSensors
 		void processStateApproachedToReleased(uint8_t ch);
 		void processSample(uint8_t ch);
 		void resetButtonStateSummaries(uint8_t ch);
-		void initScanOrder(void);
+		uint16_t scanGroupKey(uint8_t ch);
+		int16_t nextScanGroupKey(int16_t key);
+		void nextScanIndex(uint16_t length);
+		uint16_t random16(void);
+		void randomizeScanIndex(void);
+		void selectMuxAddress(int8_t muxAddress);
 
 		/* These strings are for human readability */
 		const char * const buttonStateLabels[TLStruct::buttonStateMax +
@@ -377,16 +841,26 @@ class TLSensors
 #define TL_PRE_CALIBRATION_TIME_DEFAULT				100
 #define TL_CALIBRATION_TIME_DEFAULT				500
 #define TL_FILTER_COEFF_DEFAULT					16
+#define TL_ENABLE_SHIFT_FILTER_DEFAULT				false
+#define TL_ENABLE_SPIKE_REJECTION_DEFAULT			false
 #define TL_APPROACHED_TIMEOUT_DEFAULT				300000
 #define TL_PRESSED_TIMEOUT_DEFAULT				TL_APPROACHED_TIMEOUT_DEFAULT
 #define TL_FORCE_CALIBRATION_WHEN_RELEASING_FROM_APPROACHED_DEFAULT	0
 #define TL_FORCE_CALIBRATION_WHEN_APPROACHING_FROM_RELEASED_DEFAULT	0
 #define TL_FORCE_CALIBRATION_WHEN_APPROACHING_FROM_PRESSED_DEFAULT	0
 #define TL_FORCE_CALIBRATION_WHEN_PRESSING_DEFAULT		0
-#define TL_USE_CUSTOM_SCAN_ORDER_DEFAULT			false
+#define TL_MUX_ADDRESS_DEFAULT					-1
+#define TL_MUX_SETTLE_DELAY_DEFAULT				1
+/* Scan group keys of FSR rows; above those of all multiplexer addresses */
+#define TL_SCAN_GROUP_KEY_ROW					0x100
+#define TL_RANDOMIZE_SCAN_ORDER_DEFAULT				false
+#define TL_SCAN_GAP_MAX_DEFAULT					0
+#define TL_LFSR_SEED						0xACE1
+#define TL_LFSR_TAPS						0xB400
 
 #define TL_ENABLE_TOUCH_STATE_MACHINE_DEFAULT			true
 #define TL_ENABLE_NOISE_POWER_MEASUREMENT_DEFAULT		false
+#define TL_INTERLEAVE_INVERTED_SAMPLE_DEFAULT			false
 
 #define TL_DISABLE_UPDATE_IF_ANY_BUTTON_IS_APPROACHED_DEFAULT	false
 #define TL_DISABLE_UPDATE_IF_ANY_BUTTON_IS_PRESSED_DEFAULT	false
@@ -398,6 +872,7 @@ class TLSensors
 #define TL_EEPROM_OFFSET_DEFAULT				0
 #define TL_EEPROM_KEY						0xC7
 #define TL_EEPROM_FORMAT_VERSION				0
+#define TL_EEPROM_FORMAT_VERSION_LARGE				1
 #define TL_EEPROM_FORMAT_MASK					0x7
 #define TL_EEPROM_FORMAT_SHIFT					5
 #define TL_EEPROM_N_SENSORS_MASK				0x1F
@@ -410,58 +885,165 @@ class TLSensors
  * EEPROM overhead:
  * 1 byte key
  * 1 byte description (EEPROM format version + nSensors)
+ * 1 byte nSensors (only for more than 32 sensors; format version 1)
  * 1 byte config
  * 2 byte CRC
  */
 #define TL_EEPROM_N_BYTES_OVERHEAD				(1+1+1+2)
 
+/*
+ * Channel at position pos of the scan order. The default scan order is read
+ * from flash, a custom scan order from RAM.
+ */
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::addChannel(uint8_t ch)
+uint8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::getScanOrder(uint16_t pos)
 {
-	long r;
-	uint16_t n, pos, length;
-	int8_t err = -1;
+	if (customScanOrder != NULL) {
+		return customScanOrder[pos];
+	}
 
-	length = ((uint16_t) nSensors) * ((uint16_t) nMeasurementsPerSensor);
-	
-	r = random(0, length);
+	return pgm_read_byte(&(TLScanOrderTable<N_SENSORS,
+		N_MEASUREMENTS_PER_SENSOR>::order[pos]));
+}
 
-	for (n = 0; n < length; n++) {
-		pos = (n + r) % length;
-		if (scanOrder[pos] == 255) {
-			scanOrder[pos] = ch;
-			err = 0;
-			break;
+/*
+ * Sort key of a channel in the scan order: 1 + position of the multiplexer
+ * address in Gray code order for channels behind an external multiplexer,
+ * TL_SCAN_GROUP_KEY_ROW + row pin for nodes of an FSR grid (so a row is driven
+ * once per scan), otherwise 0.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+uint16_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::scanGroupKey(uint8_t ch)
+{
+	uint8_t g, key;
+
+	if (data[ch].muxAddress < 0) {
+		if ((data[ch].sampleMethod == TLSampleMethodFSR) &&
+				(data[ch].tlStructSampleMethod.FSR.rowPin >= 0)) {
+			return TL_SCAN_GROUP_KEY_ROW +
+				data[ch].tlStructSampleMethod.FSR.rowPin;
 		}
+		return 0;
+	}
+
+	g = data[ch].muxAddress;
+	key = g;
+	while (g >>= 1) {
+		key ^= g;
 	}
 
-	error = err;
-	return err;
+	return key + 1;
 }
 
+/*
+ * Smallest scan group key of all channels that is larger than key, or -1 if
+ * there is none. The scan order is grouped by multiplexer address (and FSR
+ * row) by scanning it once per scan group key (the order itself is in flash
+ * and can't be sorted), so the select lines change as little as possible
+ * while within a group the order stays pseudo random. Sets scanKeyRemaining to
+ * the number of measurements with the returned key, so the scan for it can
+ * stop as soon as all of them have been taken.
+ */
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::initScanOrder(void)
+int16_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::nextScanGroupKey(int16_t key)
 {
-	uint16_t pos, length;
-	uint8_t n, k;
+	int16_t next = -1;
+	uint16_t k;
+	uint8_t ch, n = 0;
 
-	length = ((uint16_t) nSensors) * ((uint16_t) nMeasurementsPerSensor);
+	for (ch = 0; ch < nSensors; ch++) {
+		k = scanGroupKey(ch);
+		if (((int16_t) k <= key) || ((next >= 0) &&
+				((int16_t) k > next))) {
+			continue;
+		}
+		if (k != next) {
+			next = k;
+			n = 0;
+		}
+		n++;
+	}
+	scanKeyRemaining = ((uint16_t) n) * ((uint16_t) nMeasurementsPerSensor);
 
-	for (pos = 0; pos < length; pos++) {
-		scanOrder[pos] = 255;
+	return next;
+}
+
+/*
+ * Advance scanIndex to the next position of the randomized scan order,
+ * (scanOffset + scanPos * scanStride) % length, without a multiplication or
+ * division.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::nextScanIndex(
+		uint16_t length)
+{
+	if ((scanStride == 1) && (scanOffset == 0)) {
+		scanIndex++;
+	} else if (scanIndex >= length - scanStride) {
+		/* Written this way so it can't overflow 16 bits */
+		scanIndex -= length - scanStride;
+	} else {
+		scanIndex += scanStride;
 	}
-	
-	/*
-	 * Use a fixed seed so that scan order is pseudo random but always the
-	 * same.
-	 */
-	randomSeed(nMeasurementsPerSensor);
+}
 
-	for (k = 0; k < nMeasurementsPerSensor; k++) {
-		for (n = 0; n < nSensors; n++) {
-			addChannel(n);
+/* 16 bit Galois LFSR; much cheaper than random() */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+uint16_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::random16(void)
+{
+	if (lfsr & 1) {
+		lfsr = (lfsr >> 1) ^ TL_LFSR_TAPS;
+	} else {
+		lfsr = lfsr >> 1;
+	}
+
+	return lfsr;
+}
+
+/*
+ * Randomize the scan order without RAM copy: position pos is mapped to
+ * (scanOffset + pos * scanStride) % length, which is a permutation since
+ * scanStride (from TLScanStrideTable) and length are coprime. No division:
+ * the offset is scaled with a multiplication.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::randomizeScanIndex(void)
+{
+	uint16_t length;
+
+	length = ((uint16_t) N_SENSORS) * ((uint16_t) N_MEASUREMENTS_PER_SENSOR);
+
+	scanOffset = (((uint32_t) random16()) * length) >> 16;
+	scanStride = pgm_read_word(&(TLScanStrideTable<((uint16_t) N_SENSORS) *
+		((uint16_t) N_MEASUREMENTS_PER_SENSOR)>::stride[random16() &
+		(TL_N_SCAN_STRIDES - 1)]));
+}
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::selectMuxAddress(
+		int8_t muxAddress)
+{
+	uint8_t n;
+
+	if ((muxAddress < 0) || (muxAddress == muxAddressSelected) ||
+			(muxSelectPins == NULL)) {
+		return;
+	}
+
+	/* Only touch the select lines that change */
+	for (n = 0; n < nMuxSelectPins; n++) {
+		if ((muxAddressSelected < 0) ||
+				((muxAddress ^ muxAddressSelected) & (1 << n))) {
+			pinMode(muxSelectPins[n], OUTPUT);
+			digitalWrite(muxSelectPins[n],
+				(muxAddress & (1 << n)) ? HIGH : LOW);
 		}
 	}
+	muxAddressSelected = muxAddress;
+
+	if (muxSettleDelay) {
+		delayMicroseconds(muxSettleDelay);
+	}
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -480,19 +1062,20 @@ int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setDefaults(void)
 		this->anyButtonIsPressed = false;
 	}
 
-	if (error == 0) {
-		this->useCustomScanOrder = TL_USE_CUSTOM_SCAN_ORDER_DEFAULT;
-	
-		if (useCustomScanOrder == false) {
-			initScanOrder();
-		}
-	}
-
 	if (error == 0) {
 		this->enableReadSettingsFromEeprom =
 			TL_ENABLE_READ_SETTINGS_FROM_EEPROM_DEFAULT;
 		this->eepromOffset = TL_EEPROM_OFFSET_DEFAULT;
 		buttonStateChangeCallback = NULL;
+		this->muxSelectPins = NULL;
+		this->nMuxSelectPins = 0;
+		this->muxSettleDelay = TL_MUX_SETTLE_DELAY_DEFAULT;
+		this->randomizeScanOrder = TL_RANDOMIZE_SCAN_ORDER_DEFAULT;
+		this->scanGapMax = TL_SCAN_GAP_MAX_DEFAULT;
+		this->lfsr = TL_LFSR_SEED;
+		this->scanOffset = 0;
+		this->scanStride = 1;
+		this->muxAddressSelected = -1;
 	}
 
 	if (error == 0) {
@@ -514,6 +1097,12 @@ int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setDefaults(void)
 				TL_CALIBRATION_TIME_DEFAULT;
 			data[n].filterCoeff =
 				TL_FILTER_COEFF_DEFAULT;
+			data[n].enableShiftFilter =
+				TL_ENABLE_SHIFT_FILTER_DEFAULT;
+			data[n].filterShift =
+				TLFilterShiftMax(data[n].filterCoeff);
+			data[n].enableSpikeRejection =
+				TL_ENABLE_SPIKE_REJECTION_DEFAULT;
 			data[n].approachedTimeout =
 				TL_APPROACHED_TIMEOUT_DEFAULT;
 			data[n].pressedTimeout =
@@ -530,11 +1119,14 @@ int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setDefaults(void)
 				TL_ENABLE_TOUCH_STATE_MACHINE_DEFAULT;
 			data[n].enableNoisePowerMeasurement =
 				TL_ENABLE_NOISE_POWER_MEASUREMENT_DEFAULT;
+			data[n].interleaveInvertedSample =
+				TL_INTERLEAVE_INVERTED_SAMPLE_DEFAULT;
 			data[n].disableUpdateIfAnyButtonIsApproached =
 				TL_DISABLE_UPDATE_IF_ANY_BUTTON_IS_APPROACHED_DEFAULT;
 			data[n].disableUpdateIfAnyButtonIsPressed =
 				TL_DISABLE_UPDATE_IF_ANY_BUTTON_IS_PRESSED_DEFAULT;
 			data[n].stateIsBeingChanged = false;
+			data[n].muxAddress = TL_MUX_ADDRESS_DEFAULT;
 			data[n].sampleMethod = TL_SAMPLE_METHOD_DEFAULT;
 			if (!data[n].setOffsetValueManually) {
 				/*
@@ -667,16 +1259,16 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::readSensorSettingFromEepro
 	#ifdef EEPROM_h
 	if (applySettings) {
 		data[n].releasedToApproachedThreshold =
-			readFloatFromEeprom(addr, crc);
+			TLValueFromFloat(readFloatFromEeprom(addr, crc));
 
 		data[n].approachedToReleasedThreshold =
-			readFloatFromEeprom(addr, crc);
+			TLValueFromFloat(readFloatFromEeprom(addr, crc));
 
 		data[n].approachedToPressedThreshold =
-			readFloatFromEeprom(addr, crc);
+			TLValueFromFloat(readFloatFromEeprom(addr, crc));
 
 		data[n].pressedToApproachedThreshold =
-			readFloatFromEeprom(addr, crc);
+			TLValueFromFloat(readFloatFromEeprom(addr, crc));
 	} else {
 		readFloatFromEeprom(addr, crc);
 		readFloatFromEeprom(addr, crc);
@@ -693,16 +1285,16 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::writeSensorSettingToEeprom
 	#ifdef EEPROM_h
 	float f;
 
-	f = data[n].releasedToApproachedThreshold;
+	f = TLValueToFloat(data[n].releasedToApproachedThreshold);
 	writeFloatToEeprom(f, addr, crc);
 	
-	f = data[n].approachedToReleasedThreshold;
+	f = TLValueToFloat(data[n].approachedToReleasedThreshold);
 	writeFloatToEeprom(f, addr, crc);
 	
-	f = data[n].approachedToPressedThreshold;
+	f = TLValueToFloat(data[n].approachedToPressedThreshold);
 	writeFloatToEeprom(f, addr, crc);
 	
-	f = data[n].pressedToApproachedThreshold;
+	f = TLValueToFloat(data[n].pressedToApproachedThreshold);
 	writeFloatToEeprom(f, addr, crc);
 	#endif
 }
@@ -710,7 +1302,14 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::writeSensorSettingToEeprom
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
 uint16_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::eepromSizeRequired(void)
 {
-	return nSensors * 4 * sizeof(float) + TL_EEPROM_N_BYTES_OVERHEAD;
+	uint16_t size;
+
+	size = nSensors * 4 * sizeof(float) + TL_EEPROM_N_BYTES_OVERHEAD;
+	if (nSensors - 1 > TL_EEPROM_N_SENSORS_MASK) {
+		size++;
+	}
+
+	return size;
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -722,10 +1321,6 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::writeSettingsToEeprom(void
 	uint16_t crc = 0;
 	uint8_t tmp;
 
-	if (((nSensors - 1) & TL_EEPROM_N_SENSORS_MASK) != (nSensors - 1)) {
-		error = -28; /* not enough space; return ENOSPC */
-	}
-
 	if (eepromOffset + eepromSizeRequired() > EEPROM_length()) {
 		error = -28; /* not enough space; return ENOSPC */
 	}
@@ -740,11 +1335,24 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::writeSettingsToEeprom(void
 		EEPROM_update(addr++, tmp);
 		crc = crcUpdate(crc, tmp);
 
-		tmp = (TL_EEPROM_FORMAT_VERSION << TL_EEPROM_FORMAT_SHIFT) |
-			(((nSensors - 1) & TL_EEPROM_N_SENSORS_MASK) << 
-			TL_EEPROM_N_SENSORS_SHIFT);
-		EEPROM_update(addr++, tmp);
-		crc = crcUpdate(crc, tmp);
+		if (nSensors - 1 > TL_EEPROM_N_SENSORS_MASK) {
+			/* nSensors does not fit; store it in a separate byte */
+			tmp = (TL_EEPROM_FORMAT_VERSION_LARGE <<
+				TL_EEPROM_FORMAT_SHIFT);
+			EEPROM_update(addr++, tmp);
+			crc = crcUpdate(crc, tmp);
+
+			tmp = nSensors - 1;
+			EEPROM_update(addr++, tmp);
+			crc = crcUpdate(crc, tmp);
+		} else {
+			tmp = (TL_EEPROM_FORMAT_VERSION <<
+				TL_EEPROM_FORMAT_SHIFT) |
+				(((nSensors - 1) & TL_EEPROM_N_SENSORS_MASK) <<
+				TL_EEPROM_N_SENSORS_SHIFT);
+			EEPROM_update(addr++, tmp);
+			crc = crcUpdate(crc, tmp);
+		}
 
 		for (n = 0; n < nSensors; n++) {
 			writeSensorSettingToEeprom(n, &addr, &crc);
@@ -770,10 +1378,6 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::readSettingsFromEeprom(voi
 	uint8_t config = 0;
 	bool b;
 
-	if (((nSensors - 1) & TL_EEPROM_N_SENSORS_MASK) != (nSensors - 1)) {
-		error = -28; /* not enough space; return ENOSPC */
-	}
-
 	if (eepromOffset + eepromSizeRequired() > EEPROM_length()) {
 		error = -28; /* not enough space; return ENOSPC */
 	}
@@ -792,10 +1396,18 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::readSettingsFromEeprom(voi
 		nSensorsEeprom = ((tmp >> TL_EEPROM_N_SENSORS_SHIFT) &
 			TL_EEPROM_N_SENSORS_MASK) + 1;
 
+		if (formatVersion == TL_EEPROM_FORMAT_VERSION_LARGE) {
+			tmp = EEPROM.read(addr++);
+			crc = crcUpdate(crc, tmp);
+			nSensorsEeprom = tmp + 1;
+		}
+
 		config = EEPROM.read(addr++);
 		crc = crcUpdate(crc, tmp);
 
-		if (formatVersion != TL_EEPROM_FORMAT_VERSION) {
+		if ((formatVersion != TL_EEPROM_FORMAT_VERSION) &&
+				(formatVersion !=
+				TL_EEPROM_FORMAT_VERSION_LARGE)) {
 			error = -5; /* incorrect version; return EIO */
 		}
 
@@ -849,14 +1461,27 @@ TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::~TLSensors(void)
 	/* Nothing to destroy */
 }
 
-#warning overload constructor with uint8_t customScanOrder[]
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::TLSensors(void)
+TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::TLSensors(void) :
+	TLSensors((const uint8_t *) NULL)
+{
+	/* Use default scan order */
+}
+
+/*
+ * customScanOrder must have N_SENSORS * N_MEASUREMENTS_PER_SENSOR entries in
+ * RAM (not PROGMEM) and must outlive this object. It is used as is: it is not
+ * grouped by multiplexer address or FSR row and not randomized.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::TLSensors(
+		const uint8_t customScanOrder[])
 {
 	uint8_t n;
 	unsigned long now;
 	
 	error = 0;
+	this->customScanOrder = customScanOrder;
 
 	if (N_SENSORS < 1) {
 		error = -1;
@@ -870,10 +1495,6 @@ TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::TLSensors(void)
 		error = -1;
 	}
 
-	if (error == 0) {
-		initScanOrder();
-	}
-
 	if (error == 0) {
 		setDefaults();
 	}
@@ -924,7 +1545,67 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::addSample(uint8_t ch, int3
 		}
 	} else {
 		data[ch].raw += sample;
+
+		if (data[ch].enableSpikeRejection) {
+			if ((data[ch].nSamples == 0) ||
+					(sample < data[ch].sampleMin)) {
+				data[ch].sampleMin = sample;
+			}
+			if ((data[ch].nSamples == 0) ||
+					(sample > data[ch].sampleMax)) {
+				data[ch].sampleMax = sample;
+			}
+			data[ch].nSamples++;
+		}
+	}
+}
+
+/*
+ * Remove the lowest and the highest measurement from raw (see
+ * enableSpikeRejection) and scale it back to nSamples measurements.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::trimSamples(uint8_t ch)
+{
+	TLStruct * d;
+	int32_t n;
+
+	d = &(data[ch]);
+
+	if ((!d->enableSpikeRejection) || (d->enableSlewrateLimiter) ||
+			(d->nSamples < 3)) {
+		return;
 	}
+
+	n = d->nSamples;
+	d->raw = ((d->raw - d->sampleMin - d->sampleMax) * n + ((n - 2) >> 1)) /
+		(n - 2);
+}
+
+/*
+ * Take the inverted measurement of the channel whose normal measurement has
+ * been taken before the last measurement (see interleaveInvertedSample).
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::samplePendingInverted(void)
+{
+	int sample2 = 0;
+	uint8_t ch;
+
+	if (pendingCh == 0xFF) {
+		return;
+	}
+
+	ch = pendingCh;
+	pendingCh = 0xFF;
+
+	selectMuxAddress(data[ch].muxAddress);
+
+	if (data[ch].sampleMethodSample != NULL) {
+		sample2 = data[ch].sampleMethodSample(data, nSensors, ch, true);
+	}
+
+	addSample(ch, ((int32_t) pendingSample) + sample2);
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -948,7 +1629,7 @@ bool TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::isCalibrating(TLStruct * d
 {
 	bool ret = false;
 
-	if (d->buttonState <= TLStruct::buttonStateNoisePowerMeasurement) {
+	if (d->buttonState < TLStruct::buttonStateReleased) {
 		ret = true;
 	}
 
@@ -1015,11 +1696,27 @@ bool TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::isPressed(int n)
 	return isPressed(&(data[n]));
 }
 
+/*
+ * Value at which counter stops. The shift filter needs counter to reach
+ * 1 << filterShift, which can be larger than filterCoeff - 1.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+uint32_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::filterCounterMax(
+		TLStruct * d)
+{
+	if (d->enableShiftFilter) {
+		return 1UL << d->filterShift;
+	}
+
+	return ((uint32_t) d->filterCoeff) - 1;
+}
+
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
 void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::updateAvg(uint8_t ch)
 {
-	float s;
+	TLValue s, prev;
 	TLStruct * d;
+	uint8_t shift = 0;
 
 	d = &(data[ch]);
 
@@ -1036,43 +1733,35 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::updateAvg(uint8_t ch)
 		return;
 	}
 
-	d->avg = (d->counter * d->avg + d->value) / (d->counter + 1);
-	/*Serial.print("ch: ");
-	Serial.print(ch);
-	Serial.print("; state: ");
-	Serial.print(d->buttonState);
-	Serial.print("; counter: ");
-	Serial.print(d->counter);
-	Serial.print("; value: ");
-	Serial.print(d->value);
-	Serial.print("; avg: ");
-	Serial.print(d->avg);*/
-
-	/* Only perform noise measurement when not calibrating any more */
-	if ((d->enableNoisePowerMeasurement) && (d->buttonState >
-			TLStruct::buttonStateCalibrating)) {
-		s = d->delta * d->delta;
-		d->noisePower = (d->noiseCounter * d->noisePower + s) / 
-			(d->noiseCounter + 1);
-		
-		/*Serial.print("; noiseCounter: ");
-		Serial.print(d->noiseCounter);
-		Serial.print("; delta: ");
-		Serial.print(d->delta);
-		Serial.print(", s: ");
-		Serial.print(s);
-		Serial.print("; noisePower: ");
-		Serial.print(d->noisePower);*/
-	
-		if (d->noiseCounter < d->filterCoeff - 1) {
-			d->noiseCounter++;
+	prev = d->avg;
+	if (d->enableShiftFilter) {
+		shift = TLFilterShift(d->counter, d->filterShift);
+		d->avg = TLValueAverageShift(d->avg, d->value, shift);
+	} else {
+		d->avg = TLValueAverage(d->avg, d->value, d->counter);
+	}
+
+	/*
+	 * Welford's update of the variance of value: average
+	 * (value - previous avg) * (value - new avg) with the same weights as
+	 * avg. This does not depend on avg having converged, so it runs during
+	 * calibration.
+	 */
+	if (d->enableNoisePowerMeasurement) {
+		s = TLValueMultiply(d->value - prev, d->value - d->avg);
+		if (d->enableShiftFilter) {
+			d->noisePower = TLValueAverageShift(d->noisePower, s,
+				shift);
+		} else {
+			d->noisePower = TLValueAverage(d->noisePower, s,
+				d->counter);
 		}
 	}
-	//Serial.println("");
 
-	if (d->counter < d->filterCoeff - 1) {
+	if (d->counter < filterCounterMax(d)) {
 		d->counter++;
 	}
+	d->noiseCounter = d->counter;
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -1083,7 +1772,7 @@ bool TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setForceCalibratingStates(
 	bool chStateChanged = false;
 
 	for (n = 0; n < N_SENSORS; n++) {
-		if (mask & (1 << n)) {
+		if ((n < 32) && (mask & (1UL << n))) {
 			if (n == ch) {
 				chStateChanged = true;
 				*newState = TLStruct::buttonStatePreCalibrating;
@@ -1114,7 +1803,7 @@ float TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::getValue(int ch)
 
 	d = &(data[ch]);
 
-	return d->value; 
+	return TLValueToFloat(d->value);
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -1124,7 +1813,7 @@ float TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::getDelta(int ch)
 
 	d = &(data[ch]);
 
-	return d->delta; 
+	return TLValueToFloat(d->delta);
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -1134,7 +1823,7 @@ float TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::getAvg(int ch)
 
 	d = &(data[ch]);
 
-	return d->avg; 
+	return TLValueToFloat(d->avg);
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
@@ -1230,6 +1919,7 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setState(int ch,
 		case TLStruct::buttonStateCalibrating:
 			d->counter = 0;
 			d->noiseCounter = 0;
+			d->filterShift = TLFilterShiftMax(d->filterCoeff);
 			d->avg = 0;
 			d->maxDelta = 0;
 			d->noisePower = 0;
@@ -1243,8 +1933,6 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setState(int ch,
 				d->offsetValue = 0;
 			}
 			break;
-		case TLStruct::buttonStateNoisePowerMeasurement:
-			break;
 		case TLStruct::buttonStateReleased:
 			if (d->buttonState == 
 					TLStruct::buttonStateApproachedToReleased) {
@@ -1319,42 +2007,163 @@ int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::initialize(
 	return ret;
 }
 
+/*
+ * Initialize a mutual capacitance matrix (TLSampleMethodMutual) or a force
+ * sensing resistor grid (TLSampleMethodFSR; txPins are the rows and rxPins the
+ * columns). Node (tx, rx) is mapped to channel chStart + tx * nRx + rx.
+ */
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processStatePreCalibrating(uint8_t ch)
+int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::initializeMatrix(
+		uint8_t chStart, const int * txPins, uint8_t nTx,
+		const int * rxPins, uint8_t nRx, int (*sampleMethod)(
+		struct TLStruct * d, uint8_t nSensors, uint8_t ch))
 {
 	TLStruct * d;
+	uint8_t tx, rx;
+	uint16_t ch;
+	int ret = 0;
 
-	d = &(data[ch]);
+	if ((((uint16_t) chStart) + ((uint16_t) nTx) * ((uint16_t) nRx) >
+			nSensors) || ((sampleMethod != TLSampleMethodMutual) &&
+			(sampleMethod != TLSampleMethodFSR))) {
+		/* An error occurred! */
+		error = -1;
+		return -1;
+	}
 
-	if (d->lastSampledAtTime - d->stateChangedAtTime >= d->preCalibrationTime) {
-		setState(ch, TLStruct::buttonStateCalibrating);
+	for (tx = 0; tx < nTx; tx++) {
+		for (rx = 0; rx < nRx; rx++) {
+			ch = chStart + ((uint16_t) tx) * nRx + rx;
+			d = &(data[ch]);
+			ret |= initialize(ch, sampleMethod);
+			if (sampleMethod == TLSampleMethodFSR) {
+				d->tlStructSampleMethod.FSR.rowPin = txPins[tx];
+				d->tlStructSampleMethod.FSR.colPin = rxPins[rx];
+			} else {
+				d->tlStructSampleMethod.mutual.txPin =
+					txPins[tx];
+				d->tlStructSampleMethod.mutual.rxPin =
+					rxPins[rx];
+			}
+		}
 	}
+
+	return ret;
 }
 
+/*
+ * Initialize a 4-wire resistive touch screen: channel chStart is the X
+ * position, chStart + 1 the Y position and chStart + 2 the pressure.
+ */
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processStateCalibrating(uint8_t ch)
+int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::initializeTouchScreen(
+		uint8_t chStart, int xpPin, int xmPin, int ypPin, int ymPin)
 {
-	unsigned long t, t_max;
 	TLStruct * d;
+	uint8_t axis;
+	uint16_t ch;
+	int ret = 0;
+
+	if (((uint16_t) chStart) + 3 > nSensors) {
+		/* An error occurred! */
+		error = -1;
+		return -1;
+	}
+
+	for (axis = TL_TOUCH_SCREEN_AXIS_X;
+			axis <= TL_TOUCH_SCREEN_AXIS_PRESSURE; axis++) {
+		ch = chStart + axis;
+		d = &(data[ch]);
+		ret |= initialize(ch, TLSampleMethodTouchScreen);
+		d->tlStructSampleMethod.touchScreen.xpPin = xpPin;
+		d->tlStructSampleMethod.touchScreen.xmPin = xmPin;
+		d->tlStructSampleMethod.touchScreen.ypPin = ypPin;
+		d->tlStructSampleMethod.touchScreen.ymPin = ymPin;
+		d->tlStructSampleMethod.touchScreen.axis = axis;
+		if (axis != TL_TOUCH_SCREEN_AXIS_PRESSURE) {
+			/* Position is read by the pressure channel */
+			d->sampleMethodSample = NULL;
+			d->enableTouchStateMachine = false;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Initialize a sensor behind an external analog multiplexer. pin is the analog
+ * pin the common pin of the multiplexer is connected to. Set muxSelectPins and
+ * nMuxSelectPins as well. Channels 32 and up can't be in the
+ * forceCalibrationWhen* masks.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::initializeMux(
+		uint8_t ch, int (*sampleMethod)(struct TLStruct * d,
+		uint8_t nSensors, uint8_t ch), int pin, int8_t muxAddress)
+{
+	TLStruct * d;
+	int ret;
 
 	d = &(data[ch]);
 
-	t = d->lastSampledAtTime - d->stateChangedAtTime;
-	t_max = d->calibrationTime;
+	ret = initialize(ch, sampleMethod);
+	if (ret == 0) {
+		*(d->pin) = pin;
+		d->muxAddress = muxAddress;
+	}
 
-	if ((d->counter < d->filterCoeff - 1) || (t < t_max)) {
-		updateAvg(ch);
-	} else {
-		setState(ch, TLStruct::buttonStateNoisePowerMeasurement);
-	
-		if (!d->setOffsetValueManually) {
-			d->offsetValue = d->avg;
-		}
+	return ret;
+}
+
+/*
+ * Calibrate chargeDelaySensor and chargeDelayADC of CVD channel ch (see
+ * TLSampleMethodCVDCalibrateChargeDelays()). Sensor must not be touched.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::calibrateChargeDelays(
+		uint8_t ch, unsigned int delayMax)
+{
+	if (ch >= nSensors) {
+		/* An error occurred! */
+		return -1;
 	}
+
+	selectMuxAddress(data[ch].muxAddress);
+
+	return TLSampleMethodCVDCalibrateChargeDelays(data, nSensors, ch,
+		delayMax);
 }
 
+/*
+ * Turn CVD channel ch into a merged sensor of the channels in mask (see
+ * TLSampleMethodCVDSetMergeMask()). Initialize all channels first.
+ */
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processStateNoisePowerMeasurement(uint8_t ch)
+int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::setMergeMask(uint8_t ch,
+		uint32_t mask)
+{
+	if (ch >= nSensors) {
+		/* An error occurred! */
+		return -1;
+	}
+
+	return TLSampleMethodCVDSetMergeMask(data, nSensors, ch, mask);
+}
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processStatePreCalibrating(uint8_t ch)
+{
+	TLStruct * d;
+
+	d = &(data[ch]);
+
+	if (d->lastSampledAtTime - d->stateChangedAtTime >= d->preCalibrationTime) {
+		setState(ch, TLStruct::buttonStateCalibrating);
+	}
+}
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processStateCalibrating(uint8_t ch)
 {
 	unsigned long t, t_max;
 	TLStruct * d;
@@ -1364,10 +2173,15 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processStateNoisePowerMeas
 	t = d->lastSampledAtTime - d->stateChangedAtTime;
 	t_max = d->calibrationTime;
 
-	if ((d->enableNoisePowerMeasurement) && (t < t_max)) {
+	if ((d->counter < filterCounterMax(d)) || (t < t_max)) {
 		updateAvg(ch);
 	} else {
+		/* Noise power has been measured during calibration */
 		setState(ch, TLStruct::buttonStateReleased);
+	
+		if (!d->setOffsetValueManually) {
+			d->offsetValue = TLValueToFloat(d->avg);
+		}
 	}
 }
 
@@ -1516,7 +2330,7 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processSample(uint8_t ch)
 
 	d = &(data[ch]);
 
-	if (d->buttonState < TLStruct::buttonStateNoisePowerMeasurement) {
+	if (d->buttonState <= TLStruct::buttonStateCalibrating) {
 		/* Do not calculate delta when avg is not yet known */
 		d->delta = 0;
 	} else {
@@ -1530,19 +2344,6 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processSample(uint8_t ch)
 			d->maxDelta = d->delta;
 		}
 	}
-	/*Serial.print("ch: ");
-	Serial.print(ch);
-	Serial.print("; state: ");
-	Serial.print(d->buttonState);
-	Serial.print("; counter: ");
-	Serial.print(d->counter);
-	Serial.print("; value: ");
-	Serial.print(d->value);
-	Serial.print("; avg: ");
-	Serial.print(d->avg);
-	Serial.print("; delta: ");
-	Serial.println(d->delta);*/
-
 	switch (d->buttonState) {
 	case TLStruct::buttonStatePreCalibrating:
 		processStatePreCalibrating(ch);
@@ -1551,7 +2352,8 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::processSample(uint8_t ch)
 		processStateCalibrating(ch);
 		break;
 	case TLStruct::buttonStateNoisePowerMeasurement:
-		processStateNoisePowerMeasurement(ch);
+		/* Deprecated; only entered if set by the sketch */
+		setState(ch, TLStruct::buttonStateReleased);
 		break;
 	case TLStruct::buttonStateReleased:
 		processStateReleased(ch);
@@ -1592,20 +2394,74 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::resetButtonStateSummaries(
 }
 
 template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
-int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sample(void)
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sampleChannel(uint8_t ch)
 {
-	uint16_t length, pos;
-	uint8_t ch;
 	int sample1 = 0, sample2 = 0;
 	int32_t sum;
-	unsigned long now;
 
-	length = ((uint16_t) nSensors) * ((uint16_t)
-		nMeasurementsPerSensor);
+	if (ch == pendingCh) {
+		/* Nothing to interleave with */
+		samplePendingInverted();
+	}
+
+	selectMuxAddress(data[ch].muxAddress);
+
+	if (data[ch].sampleType &
+			TLStruct::sampleTypeNormal) {
+		if (data[ch].sampleMethodSample != NULL) {
+			sample1 = data[ch].sampleMethodSample(data,
+				nSensors, ch, false);
+		}
+	}
+
+	if ((data[ch].interleaveInvertedSample) &&
+			(data[ch].sampleType ==
+			TLStruct::sampleTypeDifferential)) {
+		/*
+		 * Take inverted measurement of previous channel now
+		 * and postpone the one of this channel.
+		 */
+		samplePendingInverted();
+		pendingCh = ch;
+		pendingSample = sample1;
+		return;
+	}
+
+	if (data[ch].sampleType &
+			TLStruct::sampleTypeInverted) {
+		if (data[ch].sampleMethodSample != NULL) {
+			sample2 = data[ch].sampleMethodSample(data,
+				nSensors, ch, true);
+		}
+	}
+
+	/*
+	 * For sampleTypeNormal and sampleTypeInverted: scale by factor
+	 * 2 to get same amplitude as with sampleTypeDifferential.
+	 */
+	if (data[ch].sampleType == TLStruct::sampleTypeNormal) {
+		sample1 = sample1 << 1;
+	}
+	if (data[ch].sampleType == TLStruct::sampleTypeInverted) {
+		sample2 = sample2 << 1;
+	}
+
+	sum = sample1 + sample2;
+
+	addSample(ch, sum);
+
+	samplePendingInverted();
+}
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sampleBegin(void)
+{
+	uint8_t ch;
 
 	for (ch = 0; ch < nSensors; ch++) {
 		data[ch].raw = 0;
 		data[ch].slewrateFirstSample = true;
+		data[ch].nSamples = 0;
 	}
 
 	for (ch = 0; ch < nSensors; ch++) {
@@ -1614,57 +2470,99 @@ int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sample(void)
 		}
 	}
 
-	for (pos = 0; pos < length; pos++) {
-		sample1 = 0;
-		sample2 = 0;
-		ch = scanOrder[pos];
-		/*Serial.print("ch: ");
-		Serial.print(ch);
-		Serial.print("; sampleMethodSample: ");
-		if (data[ch].sampleMethod == NULL) {
-			Serial.print("NULL");
-		} else if (data[ch].sampleMethod == TLSampleMethodCVD) {
-			Serial.print("CVD");
-		} else if (data[ch].sampleMethod == TLSampleMethodResistive) {
-			Serial.print("Resistive");
-		} else if (data[ch].sampleMethod == TLSampleMethodTouchRead) {
-			Serial.print("touchRead");
+	if (randomizeScanOrder) {
+		randomizeScanIndex();
+	} else {
+		scanOffset = 0;
+		scanStride = 1;
+	}
+
+	pendingCh = 0xFF;
+	scanPos = 0;
+	scanIndex = scanOffset;
+	if (customScanOrder != NULL) {
+		scanKey = 0;
+	} else {
+		scanKey = nextScanGroupKey(-1);
+	}
+}
+
+/*
+ * Take the next measurement of the scan. Returns true if all measurements have
+ * been taken.
+ */
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+bool TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sampleStep(void)
+{
+	uint16_t length;
+	uint8_t ch;
+
+	length = ((uint16_t) nSensors) * ((uint16_t)
+		nMeasurementsPerSensor);
+
+	if (customScanOrder != NULL) {
+		if (scanPos < length) {
+			sampleChannel(getScanOrder(scanPos));
+			scanPos++;
 		}
-		Serial.println("");*/
-			
-		if (data[ch].sampleType &
-				TLStruct::sampleTypeNormal) {
-			if (data[ch].sampleMethodSample != NULL) {
-				sample1 = data[ch].sampleMethodSample(data,
-					nSensors, ch, false);
+		return (scanPos >= length);
+	}
+
+	while (scanKey >= 0) {
+		while ((scanKeyRemaining > 0) && (scanPos < length)) {
+			ch = getScanOrder(scanIndex);
+			scanPos++;
+			nextScanIndex(length);
+			if ((int16_t) scanGroupKey(ch) != scanKey) {
+				continue;
 			}
-		}
-		if (data[ch].sampleType &
-				TLStruct::sampleTypeInverted) {
-			if (data[ch].sampleMethodSample != NULL) {
-				sample2 = data[ch].sampleMethodSample(data,
-					nSensors, ch, true);
+			scanKeyRemaining--;
+
+			if (scanGapMax > 0) {
+				delayMicroseconds(random16() %
+					(scanGapMax + 1));
 			}
-		}
 
-		/*
-		 * For sampleTypeNormal and sampleTypeInverted: scale by factor
-		 * 2 to get same amplitude as with sampleTypeDifferential.
-		 */
-		if (data[ch].sampleType == TLStruct::sampleTypeNormal) {
-			sample1 = sample1 << 1;
-		}
-		if (data[ch].sampleType == TLStruct::sampleTypeInverted) {
-			sample2 = sample2 << 1;
+			sampleChannel(ch);
+			return false;
 		}
+		scanPos = 0;
+		scanIndex = scanOffset;
+		scanKey = nextScanGroupKey(scanKey);
+	}
 
-		sum = sample1 + sample2;
+	return true;
+}
 
-		addSample(ch, sum);
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sample(void)
+{
+	sampleBegin();
+	while (!sampleStep()) {
+		/* Take all measurements of this scan */
 	}
+
+	return sampleEnd();
+}
+
+template <uint8_t N_SENSORS, uint8_t N_MEASUREMENTS_PER_SENSOR>
+int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sampleEnd(void)
+{
+	uint8_t ch;
+	unsigned long now;
+
+	samplePendingInverted();
 	
 	now = millis();
 
+	/*
+	 * Trim all channels first: the post sample callback of one channel may
+	 * read raw of others.
+	 */
+	for (ch = 0; ch < nSensors; ch++) {
+		trimSamples(ch);
+	}
+
 	for (ch = 0; ch < nSensors; ch++) {
 		if (data[ch].sampleMethodPostSample != NULL) {
 			data[ch].sampleMethodPostSample(data, nSensors, ch);
@@ -1677,8 +2575,7 @@ int8_t TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::sample(void)
 	this->anyButtonIsPressed = false;
 	for (ch = 0; ch < nSensors; ch++) {
 		resetButtonStateSummaries(ch);
-		if (data[ch].buttonState <=
-				TLStruct::buttonStateNoisePowerMeasurement) {
+		if (data[ch].buttonState < TLStruct::buttonStateReleased) {
 			data[ch].buttonIsCalibrating = true;
 		}
 		if ((data[ch].buttonState >= TLStruct::buttonStateReleased) &&
@@ -1718,7 +2615,14 @@ int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::findSensorPair(uint8_t ch,
 				break;
 			}
 		}
-		if (pin == *(data[k].pin)) {
+		/*
+		 * Sensors behind a multiplexer share its common pin; nodes of a
+		 * mutual capacitance matrix share their RX pin.
+		 */
+		if ((pin == *(data[k].pin)) &&
+				(d->muxAddress == data[k].muxAddress) &&
+				((d->sampleMethod != TLSampleMethodMutual) ||
+				(data[k].sampleMethod != TLSampleMethodMutual))) {
 			n = k;
 			break;
 		}
@@ -1757,21 +2661,35 @@ int TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::printBar(uint8_t ch_k,
 		d_n = &(data[ch_n]);
 		tmp = d_n->sampleMethodMapDelta(data, N_SENSORS, ch_n,
 			barLength);
-		if (d_n->sampleMethod == TLSampleMethodResistive) {
+		if ((d_n->sampleMethod == TLSampleMethodResistive) ||
+				(d_n->sampleMethod == TLSampleMethodFSR) ||
+				(d_n->sampleMethod ==
+				TLSampleMethodTouchScreen)) {
 			nHashes = tmp;
 		}
 		if ((d_n->sampleMethod == TLSampleMethodCVD) ||
 				(d_n->sampleMethod ==
-				TLSampleMethodTouchRead)) {
+				TLSampleMethodTouchRead) ||
+				(d_n->sampleMethod ==
+				TLSampleMethodChargeTransfer) ||
+				(d_n->sampleMethod ==
+				TLSampleMethodInputCapture) ||
+				(d_n->sampleMethod ==
+				TLSampleMethodMutual)) {
 			nDashes = tmp;
 		}
 	}
 	tmp = d_k->sampleMethodMapDelta(data, N_SENSORS, ch_k, barLength);
-	if (d_k->sampleMethod == TLSampleMethodResistive) {
+	if ((d_k->sampleMethod == TLSampleMethodResistive) ||
+			(d_k->sampleMethod == TLSampleMethodFSR) ||
+			(d_k->sampleMethod == TLSampleMethodTouchScreen)) {
 		nHashes = tmp;
 	}
 	if ((d_k->sampleMethod == TLSampleMethodCVD) ||
-			(d_k->sampleMethod == TLSampleMethodTouchRead)) {
+			(d_k->sampleMethod == TLSampleMethodTouchRead) ||
+			(d_k->sampleMethod == TLSampleMethodChargeTransfer) ||
+			(d_k->sampleMethod == TLSampleMethodInputCapture) ||
+			(d_k->sampleMethod == TLSampleMethodMutual)) {
 		nDashes = tmp;
 	}
 
@@ -1807,7 +2725,7 @@ void TLSensors<N_SENSORS, N_MEASUREMENTS_PER_SENSOR>::printScanOrder(void)
 
 	for (n = 0; n < ((uint16_t) nSensors) * ((uint16_t)
 			nMeasurementsPerSensor); n++) {
-		Serial.print(scanOrder[n]);
+		Serial.print(getScanOrder(n));
 		Serial.print(" ");
 	}
 	Serial.println();
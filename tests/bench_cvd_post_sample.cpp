@@ -0,0 +1,88 @@
+/*
+ * bench_cvd_post_sample.cpp - Host cycle count of the CVD post processing
+ *
+ * Built twice by "make bench": with the default float build and with
+ * TL_USE_FIXED_POINT=1. Each build runs TLSampleMethodCVDPostSample() over a
+ * sweep of raw values for 1 - 16 charges and prints the fastest of several
+ * rounds in host cycles (time stamp counter on x86, nanoseconds elsewhere) per
+ * call. The host has a hardware FPU, so the numbers only compare the two builds
+ * on the host; on 8 bit AVR every float operation is a soft float library call
+ * and the difference is larger. Not part of "make check": timings vary.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT			"cycles"
+#else
+#define BENCH_UNIT			"ns"
+#endif
+
+#define N_MEASUREMENTS			16
+#define N_CHARGES_MAX			16
+#define N_RAW				256
+#define N_ROUNDS			20
+
+static TLSensors<1, N_MEASUREMENTS> sensors;
+
+static uint64_t benchCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return ((uint64_t) t.tv_sec) * 1000000000ULL + t.tv_nsec;
+#endif
+}
+
+/* Cycles of one round of N_CHARGES_MAX * N_RAW calls */
+static uint64_t benchRound(void)
+{
+	struct TLStruct * d;
+	uint32_t scale, nCharges;
+	uint64_t t0;
+	uint16_t i;
+
+	d = &(sensors.data[0]);
+	scale = ((uint32_t) (N_MEASUREMENTS << 1)) * 1024;
+
+	t0 = benchCycles();
+	for (nCharges = 1; nCharges <= N_CHARGES_MAX; nCharges++) {
+		for (i = 0; i < N_RAW; i++) {
+			d->raw = scale / 20 + i * (scale * 9 / 10 / N_RAW);
+			d->tlStructSampleMethod.CVD.nCharges = nCharges;
+			TLSampleMethodCVDPostSample(sensors.data, 1, 0);
+		}
+	}
+
+	return benchCycles() - t0;
+}
+
+int main(void)
+{
+	uint64_t t, best = 0;
+	uint8_t k;
+
+	mockReset();
+	sensors.initialize(0, TLSampleMethodCVD);
+	sensors.data[0].tlStructSampleMethod.CVD.nChargesMax = N_CHARGES_MAX;
+
+	for (k = 0; k < N_ROUNDS; k++) {
+		t = benchRound();
+		if ((k == 0) || (t < best)) {
+			best = t;
+		}
+	}
+
+	printf("TLSampleMethodCVDPostSample() (%s): %.1f %s per call\n",
+		TL_USE_FIXED_POINT ? "fixed point" : "float",
+		(double) best / (N_CHARGES_MAX * N_RAW), BENCH_UNIT);
+
+	return 0;
+}
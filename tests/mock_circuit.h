@@ -0,0 +1,452 @@
+/*
+ * mock_circuit.h - Circuit model of an ATmega328P ADC with CVD sensors
+ *
+ * Every analog pin is a node with a capacitance to ground (the electrode,
+ * Cx). The ADC sample and hold capacitor (Chold) is connected to the node
+ * that the ADMUX multiplexer selects. A selection must last tConnect before
+ * charge is shared; shorter glitches (such as the intermediate mux value of a
+ * read-modify-write of ADMUX) are ignored. Output pins are ideal sources; an
+ * input pin keeps its charge. The internal channels are the bandgap (1.1 V)
+ * and GND.
+ *
+ * Optionally the electrodes have a series resistance, the mux an on resistance
+ * and the bandgap an output resistance; then nodes settle exponentially
+ * instead of instantly. A driven
+ * pin charges its electrode through the series resistance and Chold through
+ * the mux resistance; an input pin shares charge between Chold and the
+ * electrode through both.
+ *
+ * A conversion takes 13 ADC clocks and samples Chold after 1.5 clocks.
+ * Gaussian noise is added to every conversion; it is lower when the CPU
+ * sleeps in ADC noise reduction or idle mode.
+ */
+
+#ifndef mock_circuit_h
+#define mock_circuit_h
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#define MOCK_MUX_BANDGAP		0x0E
+#define MOCK_MUX_GND			0x0F
+
+class CvdCircuit : public MockCircuit {
+	public:
+		/* Supply and bandgap voltage in volts (V) */
+		double vcc;
+		double vBandgap;
+
+		/* Sample and hold capacitance in picofarad (pF) */
+		double cHold;
+
+		/* Electrode capacitance of each analog pin in picofarad (pF) */
+		double cx[NUM_ANALOG_INPUTS];
+
+		/* Noise in LSB with CPU running and sleeping */
+		double noiseActive;
+		double noiseSleep;
+
+		/* Minimum time that the mux must select a node in us */
+		double tConnect;
+
+		/*
+		 * Electrode series and mux resistance in kiloohm (kOhm); 0 for
+		 * instant settling
+		 */
+		double rSeries;
+		double rMux;
+
+		/* Bandgap output resistance in kiloohm (kOhm); 0 for instant */
+		double rBandgap;
+
+		/* ADC clock period in us */
+		double tAdcClock;
+
+		/*
+		 * Time at which a timer interrupt wakes up the CPU, or < 0 if
+		 * none is pending
+		 */
+		double timerWakeupAt;
+
+		/* Statistics */
+		unsigned long conversions;
+		unsigned long timerWakeups;
+
+		double vHold;
+		double vx[NUM_ANALOG_INPUTS];
+
+		CvdCircuit(void)
+		{
+			uint8_t n;
+
+			vcc = 5.0;
+			vBandgap = 1.1;
+			cHold = 14.0;
+			for (n = 0; n < NUM_ANALOG_INPUTS; n++) {
+				cx[n] = 20.0;
+				vx[n] = 0;
+			}
+			noiseActive = 0;
+			noiseSleep = 0;
+			tConnect = 0.25;
+			rSeries = 0;
+			rMux = 0;
+			rBandgap = 0;
+			tAdcClock = 8.0;
+			timerWakeupAt = -1;
+			conversions = 0;
+			timerWakeups = 0;
+			vHold = 0;
+			mux = 0;
+			selectedFor = 0;
+			converting = false;
+			sampled = false;
+			sampledInSleep = false;
+			asleep = false;
+			adcInterruptPending = false;
+			rngState = 12345;
+		}
+
+		void advance(double dt)
+		{
+			double t, step;
+
+			t = mockTime;
+			while (dt > 0) {
+				step = dt;
+				if ((converting) && (!sampled) &&
+						(sampleAt - t < step)) {
+					step = sampleAt - t;
+				}
+				if ((converting) && (doneAt - t < step)) {
+					step = doneAt - t;
+				}
+				if (step < 0) {
+					step = 0;
+				}
+				connect(step);
+				t += step;
+				dt -= step;
+				if ((converting) && (!sampled) &&
+						(t >= sampleAt)) {
+					sampled = true;
+					sampledInSleep = asleep;
+					sampledVoltage = vHold;
+				}
+				if ((converting) && (t >= doneAt)) {
+					finishConversion();
+				}
+			}
+		}
+
+		void pinChanged(uint8_t pin)
+		{
+			int n;
+
+			n = pin - A0;
+			if ((n < 0) || (n >= NUM_ANALOG_INPUTS) || (isRc())) {
+				return;
+			}
+			if (mockPinMode[pin] == OUTPUT) {
+				vx[n] = mockPinLevel[pin] ? vcc : 0;
+			} else if (mockPinMode[pin] == INPUT_PULLUP) {
+				vx[n] = vcc;
+			}
+			if ((selectedFor >= tConnect) && (mux == n)) {
+				share();
+			}
+		}
+
+		void registerWritten(const void * reg)
+		{
+			uint8_t m;
+
+			if (reg == &ADMUX) {
+				m = ADMUX.get() & 0x0F;
+				if (m != mux) {
+					mux = m;
+					selectedFor = 0;
+				}
+			} else if (reg == &ADCSRA) {
+				if ((ADCSRA.get() & _BV(ADSC)) && (!converting)) {
+					startConversion();
+				}
+			}
+		}
+
+		int analogRead(uint8_t ch)
+		{
+			startConversion();
+			mockAdvance(doneAt - mockTime);
+
+			return (((int) ADCH.get()) << 8) | ADCL.get();
+		}
+
+		void sleep(uint8_t mode)
+		{
+			double wakeAt;
+
+			if (!(SREG.get() & SREG_I)) {
+				/* Nothing can wake up the CPU */
+				printf("sleep with interrupts disabled\n");
+				exit(1);
+			}
+
+			if ((mode == SLEEP_MODE_ADC) && (!converting) &&
+					(ADCSRA.get() & _BV(ADEN))) {
+				startConversion();
+			}
+
+			if (adcInterruptPending) {
+				/*
+				 * A conversion finished just before sleep_cpu(); the
+				 * interrupt wakes up the CPU right away.
+				 */
+				deliverAdcInterrupt();
+				return;
+			}
+
+			wakeAt = -1;
+			if ((converting) && (ADCSRA.get() & _BV(ADIE))) {
+				wakeAt = doneAt;
+			}
+			if ((timerWakeupAt >= 0) && ((wakeAt < 0) ||
+					(timerWakeupAt < wakeAt))) {
+				wakeAt = timerWakeupAt;
+			}
+			if (wakeAt < 0) {
+				printf("sleep without wakeup source\n");
+				exit(1);
+			}
+
+			asleep = true;
+			if (wakeAt > mockTime) {
+				mockAdvance(wakeAt - mockTime);
+			}
+			asleep = false;
+
+			if ((timerWakeupAt >= 0) && (mockTime >= timerWakeupAt)) {
+				timerWakeupAt = -1;
+				timerWakeups++;
+			}
+			if (adcInterruptPending) {
+				deliverAdcInterrupt();
+			}
+		}
+
+		/* Gaussian noise with standard deviation sigma */
+		double gauss(double sigma)
+		{
+			double u1, u2;
+
+			if (sigma <= 0) {
+				return 0;
+			}
+			u1 = (nextRandom() + 1.0) / 4294967297.0;
+			u2 = nextRandom() / 4294967296.0;
+
+			return sigma * sqrt(-2.0 * log(u1)) *
+				cos(2.0 * M_PI * u2);
+		}
+
+	private:
+		uint8_t mux;
+		double selectedFor;
+		bool converting;
+		bool sampled;
+		bool sampledInSleep;
+		bool asleep;
+		bool adcInterruptPending;
+		double sampleAt;
+		double doneAt;
+		double sampledVoltage;
+		uint32_t rngState;
+
+		uint32_t nextRandom(void)
+		{
+			rngState ^= rngState << 13;
+			rngState ^= rngState >> 17;
+			rngState ^= rngState << 5;
+
+			return rngState;
+		}
+
+		bool isRc(void)
+		{
+			return (rSeries > 0) || (rMux > 0) || (rBandgap > 0);
+		}
+
+		/* Remaining fraction after dt for time constant tau */
+		static double decay(double dt, double tau)
+		{
+			return (tau > 0) ? exp(-dt / tau) : 0;
+		}
+
+		void connect(double dt)
+		{
+			bool wasConnected;
+			double before;
+
+			wasConnected = (selectedFor >= tConnect);
+			if (isRc()) {
+				before = wasConnected ? 0 : tConnect - selectedFor;
+				if (before > dt) {
+					before = dt;
+				}
+				settle(before, false);
+				settle(dt - before, selectedFor + dt >= tConnect);
+				selectedFor += dt;
+				return;
+			}
+			selectedFor += dt;
+			if ((!wasConnected) && (selectedFor >= tConnect)) {
+				share();
+			}
+		}
+
+		/*
+		 * Let the nodes settle for dt us. Each node is either driven or
+		 * only connected to Chold, so every step has an exact solution.
+		 */
+		void settle(double dt, bool connected)
+		{
+			double level, c, v, k;
+			uint8_t n, pin;
+
+			if (dt <= 0) {
+				return;
+			}
+			for (n = 0; n < NUM_ANALOG_INPUTS; n++) {
+				pin = A0 + n;
+				if (mockPinMode[pin] == OUTPUT) {
+					level = mockPinLevel[pin] ? vcc : 0;
+				} else if (mockPinMode[pin] == INPUT_PULLUP) {
+					level = vcc;
+				} else {
+					continue;
+				}
+				k = decay(dt, rSeries * cx[n] * 1e-3);
+				vx[n] = level + (vx[n] - level) * k;
+				if ((connected) && (mux == n)) {
+					k = decay(dt, rMux * cHold * 1e-3);
+					vHold = level + (vHold - level) * k;
+				}
+			}
+			if (!connected) {
+				return;
+			}
+			if (mux == MOCK_MUX_BANDGAP) {
+				k = decay(dt, (rMux + rBandgap) * cHold * 1e-3);
+				vHold = vBandgap + (vHold - vBandgap) * k;
+				return;
+			}
+			if (mux == MOCK_MUX_GND) {
+				vHold *= decay(dt, rMux * cHold * 1e-3);
+				return;
+			}
+			if (mux >= NUM_ANALOG_INPUTS) {
+				return;
+			}
+			pin = A0 + mux;
+			if ((mockPinMode[pin] == OUTPUT) ||
+					(mockPinMode[pin] == INPUT_PULLUP)) {
+				return;
+			}
+			c = cHold * cx[mux] / (cHold + cx[mux]);
+			v = (cHold * vHold + cx[mux] * vx[mux]) / (cHold + cx[mux]);
+			k = decay(dt, (rMux + rSeries) * c * 1e-3);
+			vHold = v + (vHold - v) * k;
+			vx[mux] = v + (vx[mux] - v) * k;
+		}
+
+		void share(void)
+		{
+			uint8_t pin;
+
+			if (mux == MOCK_MUX_BANDGAP) {
+				vHold = vBandgap;
+				return;
+			}
+			if (mux == MOCK_MUX_GND) {
+				vHold = 0;
+				return;
+			}
+			if (mux >= NUM_ANALOG_INPUTS) {
+				return;
+			}
+			pin = A0 + mux;
+			if ((mockPinMode[pin] == OUTPUT) ||
+					(mockPinMode[pin] == INPUT_PULLUP)) {
+				vHold = vx[mux];
+				return;
+			}
+			vHold = (cHold * vHold + cx[mux] * vx[mux]) /
+				(cHold + cx[mux]);
+			vx[mux] = vHold;
+		}
+
+		void deliverAdcInterrupt(void)
+		{
+			adcInterruptPending = false;
+			ADCSRA.set(ADCSRA.get() & ~_BV(ADIF));
+			mockCallVector(ADC_vect);
+		}
+
+		void startConversion(void)
+		{
+			conversions++;
+			converting = true;
+			sampled = false;
+			sampleAt = mockTime + 1.5 * tAdcClock;
+			doneAt = mockTime + 13 * tAdcClock;
+			ADCSRA.set(ADCSRA.get() | _BV(ADSC));
+		}
+
+		void finishConversion(void)
+		{
+			double v;
+			long code;
+
+			v = sampledVoltage / vcc * 1024.0;
+			v += gauss(sampledInSleep ? noiseSleep : noiseActive);
+			code = lround(v);
+			if (code < 0) {
+				code = 0;
+			}
+			if (code > 1023) {
+				code = 1023;
+			}
+			ADCL.set(code & 0xFF);
+			ADCH.set(code >> 8);
+			converting = false;
+			ADCSRA.set((ADCSRA.get() & ~_BV(ADSC)) | _BV(ADIF));
+			if (ADCSRA.get() & _BV(ADIE)) {
+				adcInterruptPending = true;
+			}
+		}
+};
+
+/* Minimal check helpers shared by the tests */
+static int mockFailures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+			#cond); \
+		mockFailures++; \
+	} \
+} while (0)
+
+static int mockResult(void)
+{
+	if (mockFailures) {
+		printf("FAILED (%d)\n", mockFailures);
+		return 1;
+	}
+	printf("OK\n");
+
+	return 0;
+}
+
+#endif
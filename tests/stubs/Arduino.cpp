@@ -0,0 +1,250 @@
+/*
+ * Arduino.cpp - Host stub of the Arduino core for the TouchLib tests
+ */
+
+#include "Arduino.h"
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+MockCircuit * mockCircuit = NULL;
+double mockTime = 0;
+double mockCallCost = 0;
+uint8_t mockPinMode[MOCK_N_PINS];
+uint8_t mockPinLevel[MOCK_N_PINS];
+MockSerial Serial;
+
+MockRegister8 SREG;
+MockRegister8 SMCR;
+MockRegister8 ADMUX;
+MockRegister8 ADCSRA;
+MockRegister8 ADCSRB;
+MockRegister8 ADCL;
+MockRegister8 ADCH;
+MockRegister8 ACSR;
+MockRegister8 TCCR1A;
+MockRegister8 TCCR1B;
+MockRegister8 TIMSK1;
+MockRegister8 TIFR1;
+MockRegister16 TCNT1;
+MockRegister16 ICR1;
+volatile uint8_t mockPortOutput[MOCK_N_PORTS];
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__) || \
+	defined(__MKL26Z64__)
+MockRegister32 TSI0_GENCS;
+MockRegister32 TSI0_SCANC;
+MockRegister32 TSI0_PEN;
+volatile uint16_t mockTsiCntr[16];
+uint32_t mockSimScgc5;
+uint32_t mockPortConfig[64];
+#endif
+
+static unsigned long mockRandomState = 1;
+
+int MockCircuit::digitalRead(uint8_t pin)
+{
+	return mockPinLevel[pin];
+}
+
+static void mockSetPortBit(uint8_t pin, uint8_t level)
+{
+	if (digitalPinToPort(pin) >= MOCK_N_PORTS) {
+		return;
+	}
+	if (level) {
+		mockPortOutput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+	} else {
+		mockPortOutput[digitalPinToPort(pin)] &=
+			~digitalPinToBitMask(pin);
+	}
+}
+
+/* Apply direct writes to the output ports to the pins */
+static void mockSyncPorts(void)
+{
+	uint8_t pin, level;
+
+	for (pin = 0; pin < 8 * MOCK_N_PORTS; pin++) {
+		level = (mockPortOutput[digitalPinToPort(pin)] &
+			digitalPinToBitMask(pin)) ? HIGH : LOW;
+		if (level == mockPinLevel[pin]) {
+			continue;
+		}
+		mockPinLevel[pin] = level;
+		if (mockCircuit != NULL) {
+			mockCircuit->pinChanged(pin);
+		}
+	}
+}
+
+void mockAdvance(double dt)
+{
+	mockSyncPorts();
+	if (dt <= 0) {
+		return;
+	}
+	if (mockCircuit != NULL) {
+		mockCircuit->advance(dt);
+	}
+	mockTime += dt;
+}
+
+void mockReset(void)
+{
+	mockCircuit = NULL;
+	mockTime = 0;
+	mockCallCost = 0;
+	memset(mockPinMode, INPUT, sizeof(mockPinMode));
+	memset(mockPinLevel, LOW, sizeof(mockPinLevel));
+	memset((void *) mockPortOutput, 0, sizeof(mockPortOutput));
+	SMCR.set(0);
+	SREG.set(SREG_I);
+	mockRandomState = 1;
+}
+
+void mockRegisterRead(const void * reg)
+{
+	mockAdvance(MOCK_CYCLE);
+}
+
+void mockRegisterWritten(const void * reg)
+{
+	mockAdvance(MOCK_CYCLE);
+	if (mockCircuit != NULL) {
+		mockCircuit->registerWritten(reg);
+	}
+}
+
+bool mockCallVector(void (*vector)(void))
+{
+	if ((vector == NULL) || !(SREG.get() & SREG_I)) {
+		return false;
+	}
+	SREG.set(SREG.get() & ~SREG_I);
+	vector();
+	SREG.set(SREG.get() | SREG_I);
+
+	return true;
+}
+
+void sleep_cpu(void)
+{
+	mockAdvance(mockCallCost);
+	if (!(SMCR.get() & _BV(SE))) {
+		return;
+	}
+	if (mockCircuit != NULL) {
+		mockCircuit->sleep(SMCR.get() &
+			(_BV(SM0) | _BV(SM1) | _BV(SM2)));
+	}
+}
+
+unsigned long micros(void)
+{
+	return (unsigned long) mockTime;
+}
+
+unsigned long millis(void)
+{
+	return (unsigned long) (mockTime / 1000);
+}
+
+void delay(unsigned long ms)
+{
+	mockAdvance(1000.0 * ms);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	mockAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	mockAdvance(mockCallCost);
+	mockPinMode[pin] = mode;
+	if (mode == INPUT_PULLUP) {
+		mockPinLevel[pin] = HIGH;
+		mockSetPortBit(pin, HIGH);
+	}
+	if (mockCircuit != NULL) {
+		mockCircuit->pinChanged(pin);
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+	mockAdvance(mockCallCost);
+	mockPinLevel[pin] = level ? HIGH : LOW;
+	mockSetPortBit(pin, level);
+	if (mockCircuit != NULL) {
+		mockCircuit->pinChanged(pin);
+	}
+}
+
+int digitalRead(uint8_t pin)
+{
+	mockAdvance(mockCallCost);
+	if (mockCircuit != NULL) {
+		return mockCircuit->digitalRead(pin);
+	}
+
+	return mockPinLevel[pin];
+}
+
+int analogRead(uint8_t ch)
+{
+	if (ch >= A0) {
+		ch -= A0;
+	}
+	mockAdvance(mockCallCost);
+
+	/* Like the AVR core: AVcc reference, select channel */
+	ADMUX = (uint8_t) (_BV(REFS0) | (ch & 0x07));
+	if (mockCircuit != NULL) {
+		return mockCircuit->analogRead(ch);
+	}
+
+	return 0;
+}
+
+void noInterrupts(void)
+{
+	cli();
+}
+
+void interrupts(void)
+{
+	sei();
+}
+
+long random(long max)
+{
+	if (max <= 0) {
+		return 0;
+	}
+	mockRandomState = mockRandomState * 1103515245UL + 12345UL;
+
+	return (long) ((mockRandomState >> 8) % (unsigned long) max);
+}
+
+long random(long min, long max)
+{
+	if (min >= max) {
+		return min;
+	}
+
+	return min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+	if (seed != 0) {
+		mockRandomState = seed;
+	}
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+	return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
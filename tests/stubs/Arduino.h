@@ -0,0 +1,129 @@
+/*
+ * Arduino.h - Host stub of the Arduino core for the TouchLib tests
+ *
+ * Only what TouchLib uses is provided. Time is simulated: it only advances in
+ * delay(), delayMicroseconds(), by mockCallCost for every pin access and by
+ * MOCK_CYCLE for every register access. Tests attach a circuit model (struct
+ * MockCircuit) to give pins and the ADC a physical behaviour.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <avr/io.h>
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__) || \
+	defined(__MKL26Z64__)
+#include "kinetis.h"
+#endif
+
+#define HIGH				1
+#define LOW				0
+#define INPUT				0
+#define OUTPUT				1
+#define INPUT_PULLUP			2
+
+#define A0				14
+#define NUM_ANALOG_INPUTS		8
+#define MOCK_N_PINS			64
+
+#ifndef F_CPU
+#define F_CPU				16000000UL
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(s)				((const __FlashStringHelper *) (s))
+
+/*
+ * Physical behaviour of the pins and the ADC. The mock calls advance() before
+ * every change so the model can integrate up to the current time with the old
+ * pin configuration.
+ */
+struct MockCircuit {
+	virtual ~MockCircuit(void) {}
+
+	/* Time has advanced by dt microseconds (us) */
+	virtual void advance(double dt) {}
+
+	/* Mode or level of pin has changed */
+	virtual void pinChanged(uint8_t pin) {}
+
+	/* A register has been written by the code under test */
+	virtual void registerWritten(const void * reg) {}
+
+	virtual int digitalRead(uint8_t pin);
+
+	/* analogRead() of ADC channel ch (pin - A0) */
+	virtual int analogRead(uint8_t ch) { return 0; }
+
+	/* sleep_cpu() with the sleep mode set by set_sleep_mode() */
+	virtual void sleep(uint8_t mode) {}
+};
+
+extern MockCircuit * mockCircuit;
+
+/* Simulated time in microseconds (us) */
+extern double mockTime;
+
+/* Time that every pin access takes in microseconds (us) */
+extern double mockCallCost;
+
+/* Time that every register access takes: 1 cycle at 16 MHz */
+#define MOCK_CYCLE			0.0625
+
+extern uint8_t mockPinMode[MOCK_N_PINS];
+extern uint8_t mockPinLevel[MOCK_N_PINS];
+
+void mockAdvance(double dt);
+void mockReset(void);
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+#define digitalPinToPort(pin)		((uint8_t) ((pin) / 8))
+#define digitalPinToBitMask(pin)	((uint8_t) (1 << ((pin) % 8)))
+#define portOutputRegister(port)	(&mockPortOutput[(port)])
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t ch);
+
+void noInterrupts(void);
+void interrupts(void);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+class MockSerial {
+	public:
+		void begin(unsigned long baud) {}
+		void end(void) {}
+		int available(void) { return 0; }
+		int read(void) { return -1; }
+		void setTimeout(unsigned long t) {}
+		operator bool(void) { return true; }
+
+		template <typename T> void print(T x) {}
+		template <typename T> void print(T x, int format) {}
+		template <typename T> void println(T x) {}
+		template <typename T> void println(T x, int format) {}
+		void println(void) {}
+};
+
+extern MockSerial Serial;
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * avr/interrupt.h - Host stub
+ *
+ * cli() and sei() change the I bit of SREG. Interrupt vectors are ordinary
+ * functions that the circuit model calls (see mockCallVector()).
+ */
+
+#ifndef avr_interrupt_h
+#define avr_interrupt_h
+
+#include <avr/io.h>
+
+#define SREG_I				0x80
+
+#define cli()				(SREG = (uint8_t) (SREG & ~SREG_I))
+#define sei()				(SREG = (uint8_t) (SREG | SREG_I))
+
+#define ADC_vect			mock_vector_ADC
+#define TIMER1_CAPT_vect		mock_vector_TIMER1_CAPT
+#define TIMER1_OVF_vect			mock_vector_TIMER1_OVF
+
+#define ISR(vector)			extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector)		extern "C" void vector(void) {}
+
+extern "C" void mock_vector_ADC(void) __attribute__((weak));
+extern "C" void mock_vector_TIMER1_CAPT(void) __attribute__((weak));
+extern "C" void mock_vector_TIMER1_OVF(void) __attribute__((weak));
+
+/*
+ * Call vector if it is defined and interrupts are enabled, like the CPU does
+ * (with interrupts disabled during the handler). Returns true if called.
+ */
+bool mockCallVector(void (*vector)(void));
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * avr/io.h - Host stub of the ATmega328P registers used by TouchLib
+ *
+ * Registers are objects so the circuit model of a test sees every access (see
+ * MockCircuit in Arduino.h). set() and get() access a register without
+ * notifying the model; use them in the model itself.
+ */
+
+#ifndef avr_io_h
+#define avr_io_h
+
+#include <stdint.h>
+
+void mockRegisterRead(const void * reg);
+void mockRegisterWritten(const void * reg);
+
+template <typename T>
+class MockRegister {
+	public:
+		MockRegister(void) : v(0) {}
+
+		operator T(void) const
+		{
+			mockRegisterRead(this);
+			return v;
+		}
+
+		MockRegister & operator=(T x)
+		{
+			v = x;
+			mockRegisterWritten(this);
+			return *this;
+		}
+
+		MockRegister & operator=(const MockRegister & r)
+		{
+			return *this = (T) r;
+		}
+
+		/* int like the integer promotion on the target (~_BV(n)) */
+		MockRegister & operator|=(int x) { return *this = (T) (v | x); }
+		MockRegister & operator&=(int x) { return *this = (T) (v & x); }
+		MockRegister & operator^=(int x) { return *this = (T) (v ^ x); }
+
+		T get(void) const { return v; }
+		void set(T x) { v = x; }
+
+	private:
+		T v;
+};
+
+typedef MockRegister<uint8_t> MockRegister8;
+typedef MockRegister<uint16_t> MockRegister16;
+
+#define _BV(bit)			(1 << (bit))
+
+extern MockRegister8 SREG;
+
+/* Sleep mode control */
+extern MockRegister8 SMCR;
+
+#define SM2				3
+#define SM1				2
+#define SM0				1
+#define SE				0
+
+/* ADC */
+extern MockRegister8 ADMUX;
+extern MockRegister8 ADCSRA;
+extern MockRegister8 ADCSRB;
+extern MockRegister8 ADCL;
+extern MockRegister8 ADCH;
+
+#define REFS1				7
+#define REFS0				6
+#define ADLAR				5
+#define ADEN				7
+#define ADSC				6
+#define ADATE				5
+#define ADIF				4
+#define ADIE				3
+#define ACME				6
+
+/* Analog comparator */
+extern MockRegister8 ACSR;
+
+#define ACD				7
+#define ACBG				6
+#define ACO				5
+#define ACI				4
+#define ACIE				3
+#define ACIC				2
+
+/* Timer 1 */
+extern MockRegister8 TCCR1A;
+extern MockRegister8 TCCR1B;
+extern MockRegister8 TIMSK1;
+extern MockRegister8 TIFR1;
+extern MockRegister16 TCNT1;
+extern MockRegister16 ICR1;
+
+#define ICNC1				7
+#define ICES1				6
+#define CS12				2
+#define CS11				1
+#define CS10				0
+#define ICIE1				5
+#define TOIE1				0
+#define ICF1				5
+#define TOV1				0
+
+/*
+ * Output ports; pin n of the mock is bit (n % 8) of port n / 8. They are plain
+ * memory like on the target, so they can be written through a pointer (see
+ * portOutputRegister()). The mock applies writes to the pins before time
+ * advances.
+ */
+#define MOCK_N_PORTS			3
+
+extern volatile uint8_t mockPortOutput[MOCK_N_PORTS];
+
+#endif
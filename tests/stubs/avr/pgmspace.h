@@ -0,0 +1,15 @@
+/*
+ * avr/pgmspace.h - Host stub; flash is ordinary memory on the host
+ */
+
+#ifndef avr_pgmspace_h
+#define avr_pgmspace_h
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr)		(*((const uint8_t *) (addr)))
+#define pgm_read_word(addr)		(*((const uint16_t *) (addr)))
+#define pgm_read_dword(addr)		(*((const uint32_t *) (addr)))
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * avr/sleep.h - Host stub
+ *
+ * The sleep mode and sleep enable bits are in SMCR like on the ATmega328P.
+ * sleep_cpu() hands over to the circuit model (MockCircuit::sleep()), which
+ * decides what wakes up the CPU.
+ */
+
+#ifndef avr_sleep_h
+#define avr_sleep_h
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE			0
+#define SLEEP_MODE_ADC			_BV(SM0)
+#define SLEEP_MODE_PWR_DOWN		_BV(SM1)
+
+#define set_sleep_mode(mode)		(SMCR = (uint8_t) ((SMCR & \
+		~(_BV(SM0) | _BV(SM1) | _BV(SM2))) | (mode)))
+#define sleep_enable()			(SMCR |= _BV(SE))
+#define sleep_disable()			(SMCR &= ~_BV(SE))
+
+void sleep_cpu(void);
+
+#endif
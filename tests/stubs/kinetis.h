@@ -0,0 +1,48 @@
+/*
+ * kinetis.h - Host stub of the Teensy 3.x registers used by TouchLib
+ *
+ * Only the touch sense input (TSI) module is provided. The count registers
+ * are an array of 16 bit values like on the target, so TSI0_CNTR1 can be
+ * accessed as uint16_t array.
+ */
+
+#ifndef kinetis_h
+#define kinetis_h
+
+#include <stdint.h>
+#include <avr/io.h>
+
+typedef MockRegister<uint32_t> MockRegister32;
+
+extern MockRegister32 TSI0_GENCS;
+extern MockRegister32 TSI0_SCANC;
+extern MockRegister32 TSI0_PEN;
+extern volatile uint16_t mockTsiCntr[16];
+extern uint32_t mockSimScgc5;
+extern uint32_t mockPortConfig[64];
+
+#define TSI0_CNTR1			(mockTsiCntr[0])
+
+#define TSI_GENCS_NSCN(n)		(((n) & 31) << 19)
+#define TSI_GENCS_PS(n)			(((n) & 7) << 16)
+#define TSI_GENCS_EOSF			(1 << 15)
+#define TSI_GENCS_OUTRGF		(1 << 14)
+#define TSI_GENCS_EXTERF		(1 << 13)
+#define TSI_GENCS_OVRF			(1 << 12)
+#define TSI_GENCS_SCNIP			(1 << 9)
+#define TSI_GENCS_SWTS			(1 << 8)
+#define TSI_GENCS_TSIEN			(1 << 7)
+
+#define TSI_SCANC_REFCHRG(n)		(((n) & 15) << 24)
+#define TSI_SCANC_EXTCHRG(n)		(((n) & 15) << 16)
+
+#define SIM_SCGC5			mockSimScgc5
+#define SIM_SCGC5_TSI			(1 << 5)
+
+#define PORT_PCR_MUX(n)			(((n) & 7) << 8)
+#define portConfigRegister(pin)		(&mockPortConfig[(pin)])
+
+/* Provided by the test (the Teensy core implements it on top of the TSI) */
+int touchRead(uint8_t pin);
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * test_adc_noise_reduction.cpp - TLAnalogReadNoiseReduction() on the ADC model
+ *
+ * Checks the register sequence: the first sleep is in ADC noise reduction mode
+ * with the ADC interrupt and global interrupts enabled, later sleeps (after
+ * another interrupt woke up the CPU early) are in idle mode so no second
+ * conversion starts, the CPU only sleeps until the ADC interrupt has set
+ * adcConversionDone, and SMCR, ADIE and SREG are restored afterwards.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodCVD.cpp"
+
+#define MAX_SLEEPS				8
+
+/* Records the registers every time the CPU goes to sleep */
+struct RecordingCircuit : public CvdCircuit {
+	int nSleeps;
+	uint8_t smcr[MAX_SLEEPS];
+	uint8_t adcsra[MAX_SLEEPS];
+	uint8_t sreg[MAX_SLEEPS];
+	bool done[MAX_SLEEPS];
+
+	RecordingCircuit(void) : nSleeps(0) {}
+
+	void sleep(uint8_t mode)
+	{
+		if (nSleeps < MAX_SLEEPS) {
+			smcr[nSleeps] = SMCR.get();
+			adcsra[nSleeps] = ADCSRA.get();
+			sreg[nSleeps] = SREG.get();
+			done[nSleeps] = adcConversionDone;
+		}
+		nSleeps++;
+		CvdCircuit::sleep(mode);
+	}
+};
+
+static RecordingCircuit * setup(void)
+{
+	static RecordingCircuit * c = NULL;
+
+	mockReset();
+	delete c;
+	c = new RecordingCircuit();
+	mockCircuit = c;
+
+	/* A0 floats at VCC / 2 with a large capacitance. */
+	c->cx[0] = 1e6;
+	c->vx[0] = c->vcc / 2;
+	ADCSRA.set(_BV(ADEN));
+	ADMUX.set(_BV(REFS0));
+
+	return c;
+}
+
+/* Registers after a call; sreg is the SREG of the caller */
+static void checkRestored(RecordingCircuit * c, uint8_t sreg)
+{
+	CHECK(c->conversions == 1);
+	CHECK(adcConversionDone);
+	CHECK(!(SMCR.get() & _BV(SE)));
+	CHECK(!(ADCSRA.get() & _BV(ADIE)));
+	CHECK(SREG.get() == sreg);
+}
+
+int main(void)
+{
+	RecordingCircuit * c;
+	double off;
+	int r, i;
+
+	/* Plain conversion: one sleep in ADC noise reduction mode */
+	c = setup();
+	r = TLAnalogReadNoiseReduction(A0);
+	CHECK(abs(r - 512) <= 1);
+	CHECK(c->nSleeps == 1);
+	CHECK(c->smcr[0] == (SLEEP_MODE_ADC | _BV(SE)));
+	CHECK(c->adcsra[0] & _BV(ADIE));
+	CHECK(c->sreg[0] & SREG_I);
+	CHECK(!c->done[0]);
+	checkRestored(c, SREG_I);
+
+	/*
+	 * A timer interrupt wakes up the CPU before the conversion is done; it
+	 * must go back to sleep in idle mode until the ADC interrupt
+	 */
+	c = setup();
+	c->timerWakeupAt = mockTime + 5;
+	r = TLAnalogReadNoiseReduction(A0);
+	CHECK(abs(r - 512) <= 1);
+	CHECK(c->timerWakeups == 1);
+	CHECK(c->nSleeps == 2);
+	CHECK(c->smcr[0] == (SLEEP_MODE_ADC | _BV(SE)));
+	CHECK(c->smcr[1] == (SLEEP_MODE_IDLE | _BV(SE)));
+	for (i = 0; (i < c->nSleeps) && (i < MAX_SLEEPS); i++) {
+		CHECK(c->adcsra[i] & _BV(ADIE));
+		CHECK(c->sreg[i] & SREG_I);
+		CHECK(!c->done[i]);
+	}
+	checkRestored(c, SREG_I);
+
+	/*
+	 * The wakeup comes just before the end of the conversion, so the
+	 * conversion finishes while the CPU decides to sleep again
+	 */
+	for (off = -1.0; off < 1.0; off += 0.01) {
+		c = setup();
+		mockCallCost = 0.0625;
+		c->timerWakeupAt = mockTime + 13 * c->tAdcClock - off;
+		r = TLAnalogReadNoiseReduction(A0);
+		CHECK(abs(r - 512) <= 1);
+		for (i = 0; (i < c->nSleeps) && (i < MAX_SLEEPS); i++) {
+			CHECK(!c->done[i]);
+		}
+		checkRestored(c, SREG_I);
+	}
+
+	/* Caller has interrupts disabled; they must stay disabled */
+	c = setup();
+	cli();
+	r = TLAnalogReadNoiseReduction(A0);
+	CHECK(abs(r - 512) <= 1);
+	CHECK(c->nSleeps == 1);
+	CHECK(c->sreg[0] & SREG_I);
+	checkRestored(c, 0);
+
+	/* Analog reference not set yet: falls back to analogRead() */
+	c = setup();
+	ADMUX.set(0);
+	r = TLAnalogReadNoiseReduction(A0);
+	CHECK(abs(r - 512) <= 1);
+	CHECK(c->nSleeps == 0);
+	CHECK(c->conversions == 1);
+
+	return mockResult();
+}
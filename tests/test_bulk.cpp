@@ -0,0 +1,121 @@
+/*
+ * test_bulk.cpp - Bulk read method with mock external devices
+ *
+ * Two mock devices (such as I2C touch controllers) return the readings of all
+ * their channels in one transaction. Channels 0 - 3 are on device A, channels
+ * 4 and 5 on device B. Every device must be read once per scan, no matter
+ * how many measurements per sensor are taken, and its readings must go
+ * through the normal processing of TLSensors.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_CHANNELS_A			4
+#define N_CHANNELS_B			2
+
+struct MockDevice {
+	int32_t level[8];
+	unsigned long transactions;
+	bool fail;
+};
+
+static MockDevice deviceA, deviceB;
+static int32_t samplesA[N_CHANNELS_A];
+static int32_t samplesB[N_CHANNELS_B];
+
+static int readDevice(void * context, int32_t * samples, uint8_t nSamples)
+{
+	MockDevice * dev;
+	uint8_t n;
+
+	dev = (MockDevice *) context;
+	dev->transactions++;
+	if (dev->fail) {
+		return -1;
+	}
+	for (n = 0; n < nSamples; n++) {
+		samples[n] = dev->level[n];
+	}
+
+	return 0;
+}
+
+static void scan(TLSensors<6, 4> * s, int n)
+{
+	while (n-- > 0) {
+		delay(10);
+		s->sample();
+	}
+}
+
+int main(void)
+{
+	TLSensors<6, 4> * s;
+	uint8_t n;
+
+	mockReset();
+	memset(&deviceA, 0, sizeof(deviceA));
+	memset(&deviceB, 0, sizeof(deviceB));
+	for (n = 0; n < 8; n++) {
+		deviceA.level[n] = 1000 + 10 * n;
+		deviceB.level[n] = 2000 + 10 * n;
+	}
+
+	s = new TLSensors<6, 4>();
+	for (n = 0; n < 6; n++) {
+		s->initialize(n, TLSampleMethodBulk);
+		s->data[n].tlStructSampleMethod.bulk.read = readDevice;
+		if (n < N_CHANNELS_A) {
+			s->data[n].tlStructSampleMethod.bulk.pin = n;
+			s->data[n].tlStructSampleMethod.bulk.context = &deviceA;
+			s->data[n].tlStructSampleMethod.bulk.samples = samplesA;
+			s->data[n].tlStructSampleMethod.bulk.nSamples =
+				N_CHANNELS_A;
+		} else {
+			s->data[n].tlStructSampleMethod.bulk.pin =
+				n - N_CHANNELS_A;
+			s->data[n].tlStructSampleMethod.bulk.context = &deviceB;
+			s->data[n].tlStructSampleMethod.bulk.samples = samplesB;
+			s->data[n].tlStructSampleMethod.bulk.nSamples =
+				N_CHANNELS_B;
+		}
+	}
+	s->data[5].scaleFactor = 0.5;
+
+	/* One transaction per device per scan; readings become values */
+	scan(s, 100);
+	printf("transactions: A %lu, B %lu for 100 scans\n",
+		deviceA.transactions, deviceB.transactions);
+	CHECK(deviceA.transactions == 100);
+	CHECK(deviceB.transactions == 100);
+	CHECK(s->getValue(2) == 1020);
+	CHECK(s->getValue(4) == 2000);
+	CHECK(s->getValue(5) == 1005);
+	for (n = 0; n < 6; n++) {
+		CHECK(s->getState(n) == TLStruct::buttonStateReleased);
+	}
+
+	/* A touch on channel 2 is processed like any other sensor */
+	deviceA.level[2] += 200;
+	scan(s, 10);
+	CHECK(s->isPressed(2));
+	for (n = 0; n < 6; n++) {
+		if (n != 2) {
+			CHECK(!s->isPressed(n));
+		}
+	}
+
+	/* A failed transaction keeps the readings of the previous scan */
+	deviceB.fail = true;
+	deviceB.level[0] += 500;
+	scan(s, 1);
+	CHECK(s->getValue(4) == 2000);
+	deviceB.fail = false;
+	scan(s, 1);
+	CHECK(s->getValue(4) == 2500);
+
+	delete s;
+
+	return mockResult();
+}
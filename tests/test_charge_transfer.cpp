@@ -0,0 +1,205 @@
+/*
+ * test_charge_transfer.cpp - Charge transfer method on a switched capacitor
+ * model
+ *
+ * The electrode (Cx, to GND) is on pin and the sampling capacitor (Cs) sits
+ * between pin and samplePin. Driven pins are ideal sources; the RC time
+ * constants of the pin drivers (tens of ns) are short compared to a pin
+ * operation, so charge is shared instantly. A floating node keeps its charge.
+ * digitalRead() of pin trips at 0.6 * VCC. Pin operations cost 4 us like
+ * digitalWrite() and pinMode() on a 16 MHz AVR.
+ *
+ * The timeout is a budget of all measurements of a sensor in a scan: a scan of
+ * a stalled electrode must take no longer than the timeout, while a 10 pF
+ * electrode with 16 measurements per sensor must fit in the default.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define PIN				2
+#define SAMPLE_PIN			3
+
+#define C_S				1000.0 /* pF */
+#define TIMEOUT_DEFAULT			80000 /* us */
+
+class ChargeTransferCircuit : public MockCircuit {
+	public:
+		double vcc;
+		double cx;
+		double cs;
+
+		ChargeTransferCircuit(void)
+		{
+			vcc = 5.0;
+			cx = 10.0;
+			cs = C_S;
+			vPin = 0;
+			vSample = 0;
+		}
+
+		void pinChanged(uint8_t p)
+		{
+			bool pinDriven, sampleDriven;
+			double q;
+
+			if ((p != PIN) && (p != SAMPLE_PIN)) {
+				return;
+			}
+			pinDriven = (mockPinMode[PIN] == OUTPUT);
+			sampleDriven = (mockPinMode[SAMPLE_PIN] == OUTPUT);
+
+			if ((pinDriven) && (sampleDriven)) {
+				vPin = level(PIN);
+				vSample = level(SAMPLE_PIN);
+			} else if (pinDriven) {
+				/* Cs keeps its voltage */
+				vSample = level(PIN) - (vPin - vSample);
+				vPin = level(PIN);
+			} else if (sampleDriven) {
+				/* Charge on the pin node is conserved */
+				q = cx * vPin + cs * (vPin - vSample);
+				vSample = level(SAMPLE_PIN);
+				vPin = (q + cs * vSample) / (cx + cs);
+			}
+		}
+
+		int digitalRead(uint8_t p)
+		{
+			if (p == PIN) {
+				return (vPin >= 0.6 * vcc) ? HIGH : LOW;
+			}
+
+			return mockPinLevel[p];
+		}
+
+	private:
+		double vPin;
+		double vSample;
+
+		double level(uint8_t p)
+		{
+			return mockPinLevel[p] ? vcc : 0;
+		}
+};
+
+static TLSensors<1, 2> * s = NULL;
+
+static ChargeTransferCircuit * setup(double cx)
+{
+	static ChargeTransferCircuit * c = NULL;
+
+	mockReset();
+	delete c;
+	c = new ChargeTransferCircuit();
+	mockCircuit = c;
+	mockCallCost = 4;
+	c->cx = cx;
+
+	delete s;
+	s = new TLSensors<1, 2>();
+	s->initialize(0, TLSampleMethodChargeTransfer);
+	s->data[0].tlStructSampleMethod.chargeTransfer.pin = PIN;
+	s->data[0].tlStructSampleMethod.chargeTransfer.samplePin = SAMPLE_PIN;
+
+	return c;
+}
+
+static int measure(double * t)
+{
+	int n;
+
+	*t = mockTime;
+	TLSampleMethodChargeTransferPreSample(s->data, 1, 0);
+	n = TLSampleMethodChargeTransferSample(s->data, 1, 0, false);
+	*t = mockTime - *t;
+
+	return n;
+}
+
+/* Time of a scan with 16 measurements per sensor */
+static void scanTime16(double cx, double * t, bool * timedOut)
+{
+	TLSensors<1, 16> * s16;
+
+	setup(cx);
+	s16 = new TLSensors<1, 16>();
+	s16->initialize(0, TLSampleMethodChargeTransfer);
+	s16->data[0].tlStructSampleMethod.chargeTransfer.pin = PIN;
+	s16->data[0].tlStructSampleMethod.chargeTransfer.samplePin = SAMPLE_PIN;
+	CHECK(s16->data[0].tlStructSampleMethod.chargeTransfer.timeout ==
+		TIMEOUT_DEFAULT);
+
+	*t = mockTime;
+	s16->sample();
+	*t = mockTime - *t;
+	*timedOut = s16->data[0].tlStructSampleMethod.chargeTransfer.timedOut;
+
+	delete s16;
+}
+
+int main(void)
+{
+	static const double cxs[] = {5, 10, 20, 47, 100};
+	double t, value, err;
+	bool timedOut;
+	uint8_t i;
+	int n;
+
+	/* Normal electrodes: no timeout, value is Cx in pF */
+	printf("Cx/pF  pulses   time/us  value/pF\n");
+	for (i = 0; i < sizeof(cxs) / sizeof(cxs[0]); i++) {
+		setup(cxs[i]);
+		n = measure(&t);
+		CHECK(!s->data[0].tlStructSampleMethod.chargeTransfer.timedOut);
+		CHECK((n > 0) && (n < 1000));
+		s->sample();
+		s->sample();
+		value = s->getValue(0);
+		err = value / cxs[i] - 1;
+		printf("%5.0f %7d %9.0f %9.2f\n", cxs[i], n, t, value);
+		CHECK(fabs(err) < 0.1);
+	}
+
+	/*
+	 * Open electrode: the timeout aborts the scan of the sensor as an
+	 * error, the remaining measurements are skipped and the value of the
+	 * previous scan is kept.
+	 */
+	setup(10);
+	s->data[0].tlStructSampleMethod.chargeTransfer.timeout = 20000;
+	s->sample();
+	value = s->getValue(0);
+	((ChargeTransferCircuit *) mockCircuit)->cx = 0.1;
+	t = mockTime;
+	s->sample();
+	t = mockTime - t;
+	printf("open electrode: scan of %.0f us\n", t);
+	CHECK(s->data[0].tlStructSampleMethod.chargeTransfer.timedOut);
+	CHECK(t < s->data[0].tlStructSampleMethod.chargeTransfer.timeout +
+		1000);
+	CHECK(s->getValue(0) == value);
+	n = measure(&t);
+	CHECK(n == 0);
+
+	/* Same with 16 measurements per sensor */
+	scanTime16(0.1, &t, &timedOut);
+	printf("open electrode, 16 measurements: scan of %.0f us\n", t);
+	CHECK(timedOut);
+	CHECK(t < TIMEOUT_DEFAULT + 1000);
+
+	/* A 10 pF electrode fits in the default budget */
+	scanTime16(10, &t, &timedOut);
+	printf("10 pF, 16 measurements: scan of %.0f us\n", t);
+	CHECK(!timedOut);
+
+	/* Without timeout, the burst limit bounds the measurement */
+	setup(0.1);
+	s->data[0].tlStructSampleMethod.chargeTransfer.timeout = 0;
+	n = measure(&t);
+	printf("open electrode without timeout: %d after %.0f us\n", n, t);
+	CHECK(n == s->data[0].tlStructSampleMethod.chargeTransfer.burstMax);
+	CHECK(!s->data[0].tlStructSampleMethod.chargeTransfer.timedOut);
+
+	return mockResult();
+}
@@ -0,0 +1,120 @@
+/*
+ * test_cvd_auto_ranging.cpp - Multi-charge auto-ranging of a large electrode
+ *
+ * A large electrode is measured with a single charge and with auto-ranging
+ * (nChargesMax > 1). nCharges must converge to ceil(Csense / Chold) within a
+ * few scans and stay there, the value must not depend on nCharges, padding
+ * must keep the scan time constant and the noise for the same measurement
+ * time must be lower.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_WARMUP			8
+#define N_SCANS				256
+
+#define C_HOLD				14.0
+
+struct Result {
+	double mean;
+	double stddev;
+	double scanTime;
+	double scanTimeMin;
+	double scanTimeMax;
+	uint32_t nCharges;
+	int convergedAfter;
+};
+
+static Result measure(double cx, uint32_t nChargesMax)
+{
+	static CvdCircuit * c = NULL;
+	TLSensors<2, 4> * s;
+	Result r;
+	double t, x, sum, sum2;
+	uint32_t nCharges;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new CvdCircuit();
+	mockCircuit = c;
+	mockCallCost = 3;
+	c->cHold = C_HOLD;
+	c->cx[0] = cx;
+	c->noiseActive = 1.0;
+
+	s = new TLSensors<2, 4>();
+	s->data[0].tlStructSampleMethod.CVD.nChargesMax = nChargesMax;
+
+	r.scanTimeMin = 1e9;
+	r.scanTimeMax = 0;
+	r.convergedAfter = 0;
+	nCharges = 0;
+	sum = 0;
+	sum2 = 0;
+	for (i = 0; i < N_WARMUP + N_SCANS; i++) {
+		t = mockTime;
+		s->sample();
+		t = mockTime - t;
+		if (t < r.scanTimeMin) {
+			r.scanTimeMin = t;
+		}
+		if (t > r.scanTimeMax) {
+			r.scanTimeMax = t;
+		}
+		if (s->data[0].tlStructSampleMethod.CVD.nCharges != nCharges) {
+			nCharges = s->data[0].tlStructSampleMethod.CVD.nCharges;
+			r.convergedAfter = i;
+		}
+		if (i >= N_WARMUP) {
+			x = s->getValue(0);
+			sum += x;
+			sum2 += x * x;
+		}
+	}
+	delete s;
+
+	r.nCharges = nCharges;
+	r.mean = sum / N_SCANS;
+	r.stddev = sqrt(sum2 / N_SCANS - r.mean * r.mean);
+	r.scanTime = r.scanTimeMax;
+
+	return r;
+}
+
+int main(void)
+{
+	static const double cxs[] = {20, 40, 60, 100};
+	Result fixed, autoRanged;
+	double merit;
+	uint32_t expected;
+	uint8_t i;
+
+	printf("Cx/pF  nCharges (after)      value  stddev   scan/us   "
+		"value  stddev   scan/us  gain\n");
+	for (i = 0; i < sizeof(cxs) / sizeof(cxs[0]); i++) {
+		fixed = measure(cxs[i], 1);
+		autoRanged = measure(cxs[i], 8);
+		expected = (uint32_t) ceil(cxs[i] / C_HOLD);
+
+		/* Noise for the same measurement time */
+		merit = (fixed.stddev * sqrt(fixed.scanTime)) /
+			(autoRanged.stddev * sqrt(autoRanged.scanTime));
+		printf("%5.0f %5lu (%2d) %15.2f %7.3f %9.1f %7.2f %7.3f %9.1f "
+			"%5.2f\n", cxs[i], (unsigned long) autoRanged.nCharges,
+			autoRanged.convergedAfter, fixed.mean, fixed.stddev,
+			fixed.scanTime, autoRanged.mean, autoRanged.stddev,
+			autoRanged.scanTime, merit);
+
+		CHECK(autoRanged.nCharges == expected);
+		CHECK(autoRanged.convergedAfter <= 4);
+		CHECK(fabs(autoRanged.mean / fixed.mean - 1) < 0.02);
+		CHECK(autoRanged.scanTimeMax - autoRanged.scanTimeMin < 1);
+		if (cxs[i] >= 40) {
+			CHECK(merit > 1.5);
+		}
+	}
+
+	return mockResult();
+}
@@ -0,0 +1,126 @@
+/*
+ * test_cvd_charge_delay_calibration.cpp - Charge delay calibration on an RC
+ * settling model
+ *
+ * The electrodes have a series resistance, so they need time to charge and
+ * discharge, and Chold needs time to charge from the reference through the
+ * mux resistance. A sweep of each delay finds the knee: the shortest delay
+ * from which on the mean stays within 1 LSB of the settled value. The
+ * calibration, which allows 1 LSB plus 3 standard errors, must pick delays
+ * at or below the knees that together stay within 2 LSB of the settled
+ * value.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodCVD.cpp"
+
+#define DELAY_MAX			TL_CHARGE_DELAY_CALIBRATION_MAX_DEFAULT
+#define SWEEP_MAX			60
+
+static TLSensors<2, 1> * setup(double rSeries, double rMux, double cx)
+{
+	static CvdCircuit * c = NULL;
+	static TLSensors<2, 1> * s = NULL;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new CvdCircuit();
+	mockCircuit = c;
+	mockCallCost = 3;
+	c->noiseActive = 0.5;
+	c->rSeries = rSeries;
+	c->rMux = rMux;
+	c->cx[0] = cx;
+	c->cx[1] = cx;
+
+	delete s;
+	s = new TLSensors<2, 1>();
+	for (i = 0; i < 8; i++) {
+		s->sample();
+	}
+
+	return s;
+}
+
+static float mean(TLSensors<2, 1> * s)
+{
+	float m, var;
+
+	TLCalibrationStatistics(s->data, 2, 0, &m, &var);
+
+	return m;
+}
+
+/*
+ * Shortest value of *delay from which on the mean is within 1 LSB of
+ * refMean, for all values up to SWEEP_MAX
+ */
+static unsigned int knee(TLSensors<2, 1> * s, unsigned int * delay,
+		float refMean)
+{
+	unsigned int d, k;
+	float m;
+
+	k = SWEEP_MAX + 1;
+	for (d = SWEEP_MAX + 1; d-- > 0;) {
+		*delay = d;
+		m = mean(s);
+		if (fabs(m - refMean) > 1) {
+			break;
+		}
+		k = d;
+	}
+
+	return k;
+}
+
+static void check(double rSeries, double rMux, double cx)
+{
+	TLSensors<2, 1> * s;
+	struct TLStructSampleMethodCVD * cvd;
+	unsigned int adc, sensor, kneeAdc, kneeSensor;
+	float ref, m;
+
+	s = setup(rSeries, rMux, cx);
+	cvd = &(s->data[0].tlStructSampleMethod.CVD);
+
+	CHECK(s->calibrateChargeDelays(0) == 0);
+	adc = cvd->chargeDelayADC;
+	sensor = cvd->chargeDelaySensor;
+	m = mean(s);
+
+	/* Sweep each delay with the other one settled */
+	cvd->chargeDelayADC = DELAY_MAX;
+	cvd->chargeDelaySensor = DELAY_MAX;
+	ref = mean(s);
+	kneeAdc = knee(s, &(cvd->chargeDelayADC), ref);
+	cvd->chargeDelayADC = DELAY_MAX;
+	kneeSensor = knee(s, &(cvd->chargeDelaySensor), ref);
+
+	printf("%5.0f %5.0f %5.1f %9.1f %5u %5u %5u %5u %7.2f\n", rSeries,
+		rMux, cx, ref, kneeAdc, adc, kneeSensor, sensor, m - ref);
+	/* 1 us of slack for the noise of the sweep */
+	CHECK(adc <= kneeAdc + 1);
+	CHECK(sensor <= kneeSensor + 1);
+	CHECK(fabs(m - ref) <= 2);
+}
+
+int main(void)
+{
+	static const double rs[] = {0, 100, 300};
+	static const double rMuxs[] = {10, 100};
+	static const double cxs[] = {10, 30};
+	uint8_t i, j, k;
+
+	printf("   Rs  Rmux    Cx       ref knADC   ADC knSen  Sens   error\n");
+	for (i = 0; i < sizeof(rs) / sizeof(rs[0]); i++) {
+		for (j = 0; j < sizeof(rMuxs) / sizeof(rMuxs[0]); j++) {
+			for (k = 0; k < sizeof(cxs) / sizeof(cxs[0]); k++) {
+				check(rs[i], rMuxs[j], cxs[k]);
+			}
+		}
+	}
+
+	return mockResult();
+}
@@ -0,0 +1,54 @@
+/*
+ * test_cvd_driven_level.cpp - Settling bookkeeping of driven CVD pins
+ *
+ * A pin that stays driven at the same level (such as the reference pin of
+ * repeated measurements) must count as settling since it was first driven. A
+ * sensor pin that is released for a measurement and driven again must count
+ * as freshly driven.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodCVD.cpp"
+
+static int sample(TLSensors<3, 1> * s, uint8_t ch)
+{
+	return TLSampleMethodCVDSample(s->data, 3, ch, false);
+}
+
+int main(void)
+{
+	static CvdCircuit c;
+	TLSensors<3, 1> * s;
+	int i;
+
+	mockReset();
+	mockCircuit = &c;
+	mockCallCost = 3;
+
+	s = new TLSensors<3, 1>();
+
+	/* Channel 1 is the reference of channel 0 and stays high */
+	sample(s, 0);
+	CHECK(!TLSensorIsSettled(&(s->data[1]), HIGH));
+	sample(s, 0);
+	CHECK(!TLSensorIsSettled(&(s->data[1]), HIGH));
+	for (i = 0; i < 10; i++) {
+		sample(s, 0);
+		CHECK(TLSensorIsSettled(&(s->data[1]), HIGH));
+
+		/* Channel 0 has just been released and discharged again */
+		CHECK(s->data[0].tlStructSampleMethod.CVD.drivenLevel == LOW);
+		CHECK(!TLSensorIsSettled(&(s->data[0]), LOW));
+	}
+
+	/* Channel 0 settles while channel 1 is measured against channel 2 */
+	sample(s, 1);
+	CHECK(!TLSensorIsSettled(&(s->data[0]), LOW));
+	sample(s, 1);
+	CHECK(TLSensorIsSettled(&(s->data[0]), LOW));
+	CHECK(!TLSensorIsSettled(&(s->data[1]), LOW));
+
+	delete s;
+
+	return mockResult();
+}
@@ -0,0 +1,181 @@
+/*
+ * test_cvd_fixed_point.cpp - Integer post processing of the CVD sample method
+ *
+ * Built with TL_USE_FIXED_POINT=1. TLSampleMethodCVDPostSample() then computes
+ * the value and the number of charges of the next scan with integer operations
+ * only. Both are compared to the double precision transfer function for the
+ * raw scales of 1 - 255 measurements per sensor and 1 - 64 charges: the value
+ * must agree within the error bounds of TLTransferRatio() (plus half an LSB of
+ * the Q23.8 format, and saturated beyond its range) and nChargesNext must be the same as the float build
+ * selects, except when Csense / Chold is that close to a decision threshold.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodCVD.cpp"
+
+#if !TL_USE_FIXED_POINT
+#error "Build with TL_USE_FIXED_POINT=1"
+#endif
+
+#define N_CHARGES_MAX			64
+
+/* Half an LSB of TLValue */
+#define VALUE_ROUNDING			(0.5 / TL_VALUE_ONE)
+
+static TLSensors<1, 255> sensors;
+
+/* nChargesNext of the float build for Csense / Chold = tmp */
+static uint32_t nChargesNextRef(struct TLStructSampleMethodCVD * cvd,
+		double tmp)
+{
+	uint32_t n;
+
+	if (tmp > cvd->nChargesMax) {
+		n = cvd->nChargesMax;
+	} else if ((tmp > cvd->nCharges + 0.25) ||
+			(tmp < cvd->nCharges - 1.25)) {
+		n = (uint32_t) ceil(tmp);
+	} else {
+		n = cvd->nCharges;
+	}
+	if (n < cvd->nChargesMin) {
+		n = cvd->nChargesMin;
+	}
+
+	return n;
+}
+
+/* True if tmp is within 1e-4 of a threshold of nChargesNextRef() */
+static bool nearThreshold(struct TLStructSampleMethodCVD * cvd, double tmp)
+{
+	double t[] = {ceil(tmp), floor(tmp), cvd->nCharges + 0.25,
+		cvd->nCharges - 1.25};
+	uint8_t i;
+
+	for (i = 0; i < sizeof(t) / sizeof(t[0]); i++) {
+		if (fabs(tmp - t[i]) < 1e-4 * tmp) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Largest relative error of the value for raw / scale in lo - hi; counts
+ * differences of nChargesNext in *mismatches.
+ */
+static double postSampleError(uint8_t nMeasurementsPerSensor,
+		uint32_t nCharges, double lo, double hi,
+		unsigned long * mismatches)
+{
+	struct TLStruct * d;
+	struct TLStructSampleMethodCVD * cvd;
+	double ref, tmp, err, errMax = 0;
+	uint32_t scale, raw, step;
+
+	d = &(sensors.data[0]);
+	cvd = &(d->tlStructSampleMethod.CVD);
+	d->nMeasurementsPerSensor = nMeasurementsPerSensor;
+	cvd->nChargesMax = N_CHARGES_MAX;
+
+	scale = ((uint32_t) (nMeasurementsPerSensor << 1)) *
+		((uint32_t) (TL_ADC_MAX + 1));
+	step = scale / 4096 + 1;
+	for (raw = (uint32_t) ceil(lo * scale); raw <= hi * scale;
+			raw += step) {
+		d->raw = raw;
+		cvd->nCharges = nCharges;
+		TLSampleMethodCVDPostSample(sensors.data, 1, 0);
+
+		tmp = 1 / (pow(1 - (double) raw / scale, -1.0 / nCharges) - 1);
+		ref = scale * tmp * d->scaleFactor / d->referenceValue;
+		if (ref >= TLValueToFloat(TL_VALUE_MAX)) {
+			/* Out of the range of Q23.8 */
+			err = (d->value == TL_VALUE_MAX) ? 0 : 1;
+		} else {
+			err = fabs(TLValueToFloat(d->value) - ref) -
+				VALUE_ROUNDING;
+			err = (err > 0) ? err / ref : 0;
+		}
+		if (err > errMax) {
+			errMax = err;
+		}
+
+		cvd->nCharges = nCharges;
+		if ((cvd->nChargesNext != nChargesNextRef(cvd, tmp)) &&
+				(!nearThreshold(cvd, tmp))) {
+			(*mismatches)++;
+		}
+	}
+
+	return errMax;
+}
+
+static void checkGain(void)
+{
+	struct TLStruct * d;
+	float v;
+
+	d = &(sensors.data[0]);
+	d->nMeasurementsPerSensor = 16;
+	d->tlStructSampleMethod.CVD.nCharges = 1;
+	d->raw = 16 * 1024;
+
+	TLSampleMethodCVDPostSample(sensors.data, 1, 0);
+	v = TLValueToFloat(d->value);
+
+	/* The cached gain follows scaleFactor and referenceValue */
+	d->scaleFactor = 3;
+	TLSampleMethodCVDPostSample(sensors.data, 1, 0);
+	CHECK(fabs(TLValueToFloat(d->value) / v - 3) < 1e-4);
+
+	d->referenceValue *= 2;
+	TLSampleMethodCVDPostSample(sensors.data, 1, 0);
+	CHECK(fabs(TLValueToFloat(d->value) / v - 1.5) < 1e-4);
+
+	/* And the raw scale */
+	d->nMeasurementsPerSensor = 32;
+	d->raw = 32 * 1024;
+	TLSampleMethodCVDPostSample(sensors.data, 1, 0);
+	CHECK(fabs(TLValueToFloat(d->value) / v - 3) < 1e-4);
+
+	d->scaleFactor = 1;
+	d->referenceValue /= 2;
+}
+
+int main(void)
+{
+	static const uint8_t nMeas[] = {1, 2, 3, 16, 64, 255};
+	double err, errMid = 0, errLow = 0;
+	unsigned long mismatches = 0;
+	uint32_t nCharges;
+	uint8_t i;
+
+	mockReset();
+	CHECK(sensors.initialize(0, TLSampleMethodCVD) == 0);
+
+	for (i = 0; i < sizeof(nMeas) / sizeof(nMeas[0]); i++) {
+		for (nCharges = 1; nCharges <= N_CHARGES_MAX; nCharges++) {
+			err = postSampleError(nMeas[i], nCharges, 0.05, 0.95,
+				&mismatches);
+			if (err > errMid) {
+				errMid = err;
+			}
+			err = postSampleError(nMeas[i], nCharges, 0.005, 0.05,
+				&mismatches);
+			if (err > errLow) {
+				errLow = err;
+			}
+		}
+	}
+	printf("value relative error %.2e (0.05 - 0.95), %.2e (0.005 - 0.05); "
+		"%lu nChargesNext mismatches\n", errMid, errLow, mismatches);
+	CHECK(errMid < 5e-5);
+	CHECK(errLow < 2e-4);
+	CHECK(mismatches == 0);
+
+	checkGain();
+
+	return mockResult();
+}
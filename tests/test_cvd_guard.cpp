@@ -0,0 +1,132 @@
+/*
+ * test_cvd_guard.cpp - Driven guard electrode
+ *
+ * The electrode of channel 0 has a parasitic capacitance (Cg) to a guard
+ * trace next to it. Without a guard the trace is grounded and Cg is just
+ * part of the electrode capacitance, which dilutes the signal of a touch.
+ * With the trace on guardPin, a step of the guard couples charge into the
+ * electrode while it floats, so Cg no longer loads the charge transferred
+ * from Chold. The change of raw for a touch (1 pF more on the electrode) must
+ * then be close to that of an electrode without Cg and much larger than
+ * with a grounded trace.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_MEASUREMENTS			8
+#define N_SCANS				8
+#define GUARD_PIN			7
+
+/* Capacitances in picofarad (pF) */
+#define C_X				20.0
+#define C_GUARD				30.0
+#define C_TOUCH				1.0
+
+class GuardCircuit : public CvdCircuit {
+	public:
+		/* Capacitance between electrode of A0 and guard trace */
+		double cg;
+
+		uint8_t guardLevel;
+
+		GuardCircuit(void)
+		{
+			cg = 0;
+			guardLevel = LOW;
+		}
+
+		void pinChanged(uint8_t pin)
+		{
+			uint8_t level;
+			double c;
+			bool selected;
+
+			CvdCircuit::pinChanged(pin);
+
+			if (pin != GUARD_PIN) {
+				return;
+			}
+			level = (mockPinMode[pin] == OUTPUT) ?
+				mockPinLevel[pin] : guardLevel;
+			if (level == guardLevel) {
+				return;
+			}
+			guardLevel = level;
+			if (mockPinMode[A0] == OUTPUT) {
+				/* Driven electrode absorbs the charge */
+				return;
+			}
+
+			/* cx includes cg */
+			selected = ((ADMUX.get() & 0x0F) == 0);
+			c = cx[0] + (selected ? cHold : 0);
+			vx[0] += ((level == HIGH) ? vcc : -vcc) * cg / c;
+			if (selected) {
+				vHold = vx[0];
+			}
+		}
+};
+
+/* Raw of channel 0 with cx on the electrode, Cg and optionally the guard */
+static int32_t measure(double cx, double cg, bool useGuard)
+{
+	static GuardCircuit * c = NULL;
+	TLSensors<2, N_MEASUREMENTS> * s;
+	int32_t raw;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new GuardCircuit();
+	mockCircuit = c;
+	mockCallCost = 3;
+	c->cx[0] = cx + cg;
+	c->cx[1] = C_X;
+	c->cg = cg;
+
+	/* Guard trace is grounded if it is not driven as guard */
+	pinMode(GUARD_PIN, OUTPUT);
+	digitalWrite(GUARD_PIN, LOW);
+
+	s = new TLSensors<2, N_MEASUREMENTS>();
+	if (useGuard) {
+		s->data[0].tlStructSampleMethod.CVD.guardPin = GUARD_PIN;
+	}
+	for (i = 0; i < N_SCANS; i++) {
+		s->sample();
+	}
+	raw = s->getRaw(0);
+	delete s;
+
+	return raw;
+}
+
+/* Change of raw of channel 0 for a touch */
+static int32_t signal(double cg, bool useGuard)
+{
+	return measure(C_X, cg, useGuard) - measure(C_X + C_TOUCH, cg,
+		useGuard);
+}
+
+int main(void)
+{
+	int32_t ideal, grounded, guarded;
+
+	ideal = signal(0, false);
+	grounded = signal(C_GUARD, false);
+	guarded = signal(C_GUARD, true);
+	printf("signal of a touch: %ld without Cg, %ld with grounded trace, "
+		"%ld with guard\n", (long) ideal, (long) grounded,
+		(long) guarded);
+
+	CHECK(ideal > 0);
+	CHECK(guarded > 0.8 * ideal);
+	CHECK(guarded > 2 * grounded);
+
+	/* Guard is left low, like the discharged sensor */
+	CHECK(mockPinMode[GUARD_PIN] == OUTPUT);
+	CHECK(mockPinLevel[GUARD_PIN] == LOW);
+
+	return mockResult();
+}
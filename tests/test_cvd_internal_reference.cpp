@@ -0,0 +1,120 @@
+/*
+ * test_cvd_internal_reference.cpp - Single CVD sensor with internal reference
+ *
+ * A single CVD sensor charges Chold from the bandgap for normal measurements.
+ * Its value must match the value of the same electrode measured with a second
+ * CVD sensor as reference (charged from VCC), for a range of electrode
+ * capacitances and supply voltages. This is repeated with a bandgap that needs
+ * time to charge Chold (as on the ATmega328P), where the conversion of the
+ * bandgap right after the mux switches to it is off. The first bandgap reading
+ * must be settled as well.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodCVD.cpp"
+
+#define N_SCANS				64
+
+/* Bandgap output resistance for the slow bandgap: tau = 10 us with Chold */
+#define R_BANDGAP_SLOW			700
+
+template <uint8_t N>
+static double measure(double cx, double vcc, double rBandgap)
+{
+	static CvdCircuit * c = NULL;
+	TLSensors<N, 4> * s;
+	double sum;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new CvdCircuit();
+	mockCircuit = c;
+	mockCallCost = 3;
+	c->vcc = vcc;
+	c->cx[0] = cx;
+	c->noiseActive = 0.5;
+	c->rBandgap = rBandgap;
+	bandgapReading = 0;
+
+	s = new TLSensors<N, 4>();
+	if (rBandgap > 0) {
+		/* Chold is charged from the bandgap for the measurement too */
+		for (i = 0; i < N; i++) {
+			s->data[i].tlStructSampleMethod.CVD.chargeDelayADC =
+				100;
+		}
+	}
+	for (i = 0; i < 8; i++) {
+		s->sample();
+	}
+	sum = 0;
+	for (i = 0; i < N_SCANS; i++) {
+		s->sample();
+		sum += s->getValue(0);
+	}
+	delete s;
+
+	return sum / N_SCANS;
+}
+
+/* First bandgap reading, right after the mux was on a sensor at 0 V */
+static double firstBandgapReading(double vcc)
+{
+	static CvdCircuit * c = NULL;
+
+	mockReset();
+	delete c;
+	c = new CvdCircuit();
+	mockCircuit = c;
+	c->vcc = vcc;
+	c->rBandgap = R_BANDGAP_SLOW;
+	ADMUX.set(_BV(REFS0));
+	c->vHold = 0;
+	bandgapReading = 0;
+	TLMeasureBandgap();
+
+	return ((double) bandgapReading) / (1 << TL_BANDGAP_FRAC_BITS);
+}
+
+int main(void)
+{
+	static const double cxs[] = {5, 10, 20, 40, 80};
+	static const double vccs[] = {5.0, 3.3};
+	static const double rBandgaps[] = {0, R_BANDGAP_SLOW};
+	double pair, single, err, errMax, expected, first;
+	uint8_t i, j, k;
+
+	for (j = 0; j < sizeof(vccs) / sizeof(vccs[0]); j++) {
+		expected = 1.1 / vccs[j] * 1024;
+		first = firstBandgapReading(vccs[j]);
+		printf("first bandgap reading at %.1f V: %.2f (expected %.2f)\n",
+			vccs[j], first, expected);
+		CHECK(fabs(first - expected) < 1);
+	}
+
+	for (k = 0; k < sizeof(rBandgaps) / sizeof(rBandgaps[0]); k++) {
+		printf("bandgap output resistance %.0f kOhm\n", rBandgaps[k]);
+		printf("   Cx   VCC   2 sensors    1 sensor   error\n");
+		errMax = 0;
+		for (j = 0; j < sizeof(vccs) / sizeof(vccs[0]); j++) {
+			for (i = 0; i < sizeof(cxs) / sizeof(cxs[0]); i++) {
+				pair = measure<2>(cxs[i], vccs[j],
+					rBandgaps[k]);
+				single = measure<1>(cxs[i], vccs[j],
+					rBandgaps[k]);
+				err = single / pair - 1;
+				printf("%5.1f %5.1f %11.2f %11.2f %6.2f%%\n",
+					cxs[i], vccs[j], pair, single,
+					100 * err);
+				CHECK(fabs(err) < 0.01);
+				if (fabs(err) > errMax) {
+					errMax = fabs(err);
+				}
+			}
+		}
+		printf("maximum error %.2f%%\n", 100 * errMax);
+	}
+
+	return mockResult();
+}
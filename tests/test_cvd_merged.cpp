@@ -0,0 +1,112 @@
+/*
+ * test_cvd_merged.cpp - Merged CVD sensor with a non-CVD channel in its mask
+ *
+ * Channels 0 and 1 are CVD sensors, channel 2 uses another sample method and
+ * channel 3 is a merged sensor. The merged value must be that of the chain of
+ * the electrodes of channels 0 and 1. setMergeMask() must reject channel 2 and
+ * other channels without a CVD electrode; if the mask is written directly,
+ * channel 2 must be skipped and its pin must not be touched.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SCANS				64
+
+#define C_HOLD				14.0
+#define C_X0				5.0
+#define C_X1				10.0
+
+static double measure(uint32_t mask, double * single)
+{
+	static CvdCircuit * c = NULL;
+	TLSensors<4, 2> * s;
+	double sum, sum0;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new CvdCircuit();
+	mockCircuit = c;
+	mockCallCost = 3;
+	c->cHold = C_HOLD;
+	c->cx[0] = C_X0;
+	c->cx[1] = C_X1;
+	c->cx[2] = 40;
+	c->noiseActive = 0.5;
+
+	s = new TLSensors<4, 2>();
+	s->initialize(2, TLSampleMethodCustom);
+	if (s->setMergeMask(3, mask) != 0) {
+		s->data[3].tlStructSampleMethod.CVD.mergeMask = mask;
+	}
+	for (i = 0; i < 8; i++) {
+		s->sample();
+	}
+	sum = 0;
+	sum0 = 0;
+	for (i = 0; i < N_SCANS; i++) {
+		s->sample();
+		sum += s->getValue(3);
+		sum0 += s->getValue(0);
+	}
+	delete s;
+
+	CHECK(mockPinMode[A0 + 2] == INPUT);
+	*single = sum0 / N_SCANS;
+
+	return sum / N_SCANS;
+}
+
+static void checkSetMergeMask(void)
+{
+	TLSensors<5, 2> * s;
+
+	mockReset();
+	s = new TLSensors<5, 2>();
+	s->initialize(2, TLSampleMethodCustom);
+	s->initializeMux(4, TLSampleMethodCVD, A0 + 4, 1);
+
+	CHECK(s->setMergeMask(3, 0x03) == 0);
+	CHECK(s->data[3].tlStructSampleMethod.CVD.mergeMask == 0x03);
+
+	/* Other sample method, itself, on a multiplexer, beyond nSensors */
+	CHECK(s->setMergeMask(3, 0x07) == -1);
+	CHECK(s->setMergeMask(3, 0x0B) == -1);
+	CHECK(s->setMergeMask(3, 0x13) == -1);
+	CHECK(s->setMergeMask(3, 0x23) == -1);
+	CHECK(s->setMergeMask(3, 0x80000003UL) == -1);
+	CHECK(s->data[3].tlStructSampleMethod.CVD.mergeMask == 0x03);
+
+	/* A merged sensor can't be part of another one */
+	CHECK(s->setMergeMask(0, 0x08) == -1);
+
+	/* The merged channel must be a CVD sensor */
+	CHECK(s->setMergeMask(2, 0x03) == -1);
+	CHECK(s->setMergeMask(5, 0x03) == -1);
+
+	CHECK(s->setMergeMask(3, 0) == 0);
+	CHECK(s->data[3].tlStructSampleMethod.CVD.mergeMask == 0);
+
+	delete s;
+}
+
+int main(void)
+{
+	double merged, mergedOther, single, expected;
+
+	checkSetMergeMask();
+
+	merged = measure(0x03, &single);
+	mergedOther = measure(0x07, &single);
+
+	/* Chain of both electrodes, scaled like the single electrode of ch 0 */
+	expected = single * C_HOLD / C_X0 * ((1 + C_X0 / C_HOLD) *
+		(1 + C_X1 / C_HOLD) - 1);
+	printf("single %.2f merged %.2f (expected %.2f), with channel 2 "
+		"%.2f\n", single, merged, expected, mergedOther);
+	CHECK(fabs(merged / expected - 1) < 0.02);
+	CHECK(fabs(mergedOther / merged - 1) < 0.01);
+
+	return mockResult();
+}
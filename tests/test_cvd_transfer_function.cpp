@@ -0,0 +1,113 @@
+/*
+ * test_cvd_transfer_function.cpp - Error bounds of the CVD lookup tables
+ *
+ * TLLog2(), TLExp2Minus1() and TLTransferFunction() replace log2() and pow()
+ * by tables and short polynomials. Their errors are compared to the double
+ * precision functions against the bounds that their comments give, for the
+ * raw scales of 1 - 255 measurements per sensor and 1 - 64 charges.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodCVD.cpp"
+
+#define LOG2_ONE			((double) (1UL << TL_LOG2_FRAC_BITS))
+
+static double log2Error(void)
+{
+	double err, errMax = 0;
+	uint32_t x, step;
+
+	/* Every value up to 2^16, then about 1 in 2^14 */
+	for (x = 1, step = 1; x >= step; x += step) {
+		err = fabs(TLLog2(x) / LOG2_ONE - log2((double) x));
+		if (err > errMax) {
+			errMax = err;
+		}
+		if (x == 0x10000) {
+			step = 16411;
+		}
+	}
+
+	return errMax;
+}
+
+/* Largest relative error for |e| from 2^14 up to 20 (in log2 units) */
+static double exp2Error(void)
+{
+	double ref, err, errMax = 0;
+	int32_t e;
+
+	for (e = -20 * (int32_t) LOG2_ONE; e < 20 * (int32_t) LOG2_ONE;
+			e += 7919) {
+		if (labs(e) < (1L << 14)) {
+			continue;
+		}
+		ref = expm1(e / LOG2_ONE * M_LN2);
+		err = fabs(TLExp2Minus1(e) / ref - 1);
+		if (err > errMax) {
+			errMax = err;
+		}
+	}
+
+	return errMax;
+}
+
+/*
+ * Largest relative error of the transfer function for raw / scale in lo - hi,
+ * for scale of nMeasurementsPerSensor and nCharges
+ */
+static double transferError(uint8_t nMeasurementsPerSensor, uint32_t nCharges,
+		double lo, double hi)
+{
+	double ref, err, errMax = 0;
+	uint32_t scale, raw, step;
+
+	scale = ((uint32_t) (nMeasurementsPerSensor << 1)) *
+		((uint32_t) (TL_ADC_MAX + 1));
+	step = scale / 4096 + 1;
+	for (raw = (uint32_t) ceil(lo * scale); raw <= hi * scale;
+			raw += step) {
+		ref = 1 / (pow(1 - (double) raw / scale, -1.0 / nCharges) - 1);
+		err = fabs(TLTransferFunction(raw, scale, nCharges) / ref - 1);
+		if (err > errMax) {
+			errMax = err;
+		}
+	}
+
+	return errMax;
+}
+
+int main(void)
+{
+	static const uint8_t nMeas[] = {1, 2, 3, 16, 64, 255};
+	double err, errMid = 0, errLow = 0;
+	uint32_t nCharges;
+	uint8_t i;
+
+	err = log2Error();
+	printf("TLLog2() absolute error %.2e\n", err);
+	CHECK(err < 1e-6);
+
+	err = exp2Error();
+	printf("TLExp2Minus1() relative error %.2e\n", err);
+	CHECK(err < 2e-5);
+
+	for (i = 0; i < sizeof(nMeas) / sizeof(nMeas[0]); i++) {
+		for (nCharges = 1; nCharges <= 64; nCharges++) {
+			err = transferError(nMeas[i], nCharges, 0.05, 0.95);
+			if (err > errMid) {
+				errMid = err;
+			}
+			err = transferError(nMeas[i], nCharges, 0.005, 0.05);
+			if (err > errLow) {
+				errLow = err;
+			}
+		}
+	}
+	printf("TLTransferFunction() relative error %.2e (0.05 - 0.95), "
+		"%.2e (0.005 - 0.05)\n", errMid, errLow);
+	CHECK(errMid < 2e-5);
+	CHECK(errLow < 2e-4);
+
+	return mockResult();
+}
@@ -0,0 +1,164 @@
+/*
+ * test_external_mux.cpp - Sensors behind external analog multiplexers
+ *
+ * 40 resistive sensors sit behind 3 16-channel multiplexers that share their
+ * select lines; the common pin of each multiplexer is an analog pin with the
+ * internal pull-up. A conversion reads the divider of the pull-up and the
+ * sensor that the select lines address. Every sensor must read its own
+ * resistance. The select lines must only be written when they change and
+ * each address must be selected once per scan, so going through the 16
+ * addresses in Gray code order takes 16 single line changes per scan. A
+ * touch on a channel above 32 must only press that channel.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SENSORS			40
+#define N_MEASUREMENTS			4
+#define N_MUX_ADDRESSES			16
+#define N_SELECT_PINS			4
+#define N_SCANS_CALIBRATION		700
+#define N_SCANS_TOUCH			20
+#define GND_PIN				2
+#define CH_TOUCHED			35
+
+/* Internal pull-up and sensor resistance in kiloohm (kOhm) */
+#define R_PULLUP			35.0
+#define R_TOUCHED			5.0
+
+static const int selectPins[N_SELECT_PINS] = {5, 6, 7, 8};
+
+class MuxCircuit : public MockCircuit {
+	public:
+		double r[N_SENSORS];
+
+		unsigned long selectPinChanges;
+
+		MuxCircuit(void)
+		{
+			uint8_t n;
+
+			for (n = 0; n < N_SENSORS; n++) {
+				r[n] = 100.0 + 2.0 * n;
+			}
+			selectPinChanges = 0;
+		}
+
+		void pinChanged(uint8_t pin)
+		{
+			uint8_t n;
+
+			for (n = 0; n < N_SELECT_PINS; n++) {
+				if (selectPins[n] == pin) {
+					selectPinChanges++;
+				}
+			}
+		}
+
+		int analogRead(uint8_t ch)
+		{
+			uint8_t n, address = 0;
+
+			mockAdvance(100);
+
+			for (n = 0; n < N_SELECT_PINS; n++) {
+				if (mockPinMode[selectPins[n]] != OUTPUT) {
+					/* Address undefined */
+					return 0;
+				}
+				if (mockPinLevel[selectPins[n]] == HIGH) {
+					address |= 1 << n;
+				}
+			}
+			n = ch * N_MUX_ADDRESSES + address;
+			if ((n >= N_SENSORS) ||
+					(mockPinMode[A0 + ch] != INPUT_PULLUP)) {
+				return 0;
+			}
+			if ((mockPinMode[GND_PIN] != OUTPUT) ||
+					(mockPinLevel[GND_PIN] != LOW)) {
+				return 1023;
+			}
+
+			return lround(1024 * r[n] / (r[n] + R_PULLUP));
+		}
+
+		double expected(uint8_t n)
+		{
+			return R_PULLUP * lround(1024 * r[n] / (r[n] + R_PULLUP)) /
+				1024;
+		}
+};
+
+static MuxCircuit * c;
+static TLSensors<N_SENSORS, N_MEASUREMENTS> * s;
+
+static void scan(int nScans)
+{
+	int i;
+
+	for (i = 0; i < nScans; i++) {
+		delay(1);
+		s->sample();
+	}
+}
+
+static void check(int chPressed)
+{
+	uint8_t ch;
+
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		CHECK(fabs(s->getValue(ch) - c->expected(ch)) < 1e-3);
+		CHECK(s->data[ch].buttonState == ((ch == chPressed) ?
+			TLStruct::buttonStatePressed :
+			TLStruct::buttonStateReleased));
+	}
+}
+
+int main(void)
+{
+	unsigned long before;
+	float untouched;
+	uint8_t ch;
+
+	mockReset();
+	c = new MuxCircuit();
+	mockCircuit = c;
+	mockCallCost = 1;
+
+	s = new TLSensors<N_SENSORS, N_MEASUREMENTS>();
+	s->muxSelectPins = selectPins;
+	s->nMuxSelectPins = N_SELECT_PINS;
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		CHECK(s->initializeMux(ch, TLSampleMethodResistive,
+			A0 + ch / N_MUX_ADDRESSES, ch % N_MUX_ADDRESSES) == 0);
+		s->data[ch].tlStructSampleMethod.resistive.gndPin = GND_PIN;
+	}
+
+	/* Sensors behind the same multiplexer are not a sensor pair */
+	CHECK(s->findSensorPair(0, 1) == -1);
+
+	scan(N_SCANS_CALIBRATION);
+	check(-1);
+
+	/* pinMode() and digitalWrite() of 1 select line per address */
+	before = c->selectPinChanges;
+	scan(1);
+	printf("select line changes per scan: %lu\n",
+		c->selectPinChanges - before);
+	CHECK(c->selectPinChanges - before == 2 * N_MUX_ADDRESSES);
+
+	untouched = s->getValue(CH_TOUCHED);
+	c->r[CH_TOUCHED] = R_TOUCHED;
+	scan(N_SCANS_TOUCH);
+	printf("channel %d: value %.3f untouched, %.3f touched\n", CH_TOUCHED,
+		untouched, s->getValue(CH_TOUCHED));
+	check(CH_TOUCHED);
+
+	c->r[CH_TOUCHED] = 100.0 + 2.0 * CH_TOUCHED;
+	scan(N_SCANS_TOUCH);
+	check(-1);
+
+	return mockResult();
+}
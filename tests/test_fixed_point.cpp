@@ -0,0 +1,199 @@
+/*
+ * test_fixed_point.cpp - Parity of the fixed point and float builds
+ *
+ * This file is built twice: as fixed_point_reference with the default float
+ * build, which prints the state, avg, delta and noise power of every channel
+ * after every scan, and as test_fixed_point with TL_USE_FIXED_POINT=1, which
+ * runs the same trace and compares its results with the output of the
+ * reference. The trace has a baseline per channel, drift, periodic and random
+ * noise and touches of two strengths on every channel in turn. The button
+ * states must be identical and the values must agree within a few LSB of the
+ * Q23.8 format.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SENSORS			4
+#define N_SCANS				30000
+
+/* Allowed error of avg, delta and noisePower */
+#define VALUE_ERROR_MAX			0.05
+
+static unsigned long scan;
+static uint32_t rngState = 12345;
+
+static float noise(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+
+	return (rngState % 1000) / 1000.0 - 0.5;
+}
+
+static float trace(uint8_t ch, unsigned long k)
+{
+	float v;
+
+	v = 1000.0 + 50 * ch + 0.00005 * k + 0.7 * sin(k * 0.37 + ch) +
+		0.5 * noise();
+	if ((k % 3000 > 2000) && (k % 3000 < 2400) &&
+			(ch == (k / 3000) % N_SENSORS)) {
+		v += (k % 3000 < 2300) ? 30.0 : 7.0;
+	}
+
+	return v;
+}
+
+static int traceSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		bool inv)
+{
+	return 0;
+}
+
+static int tracePostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	data[ch].value = TLValueFromFloat(trace(ch, scan));
+
+	return 0;
+}
+
+struct Result {
+	int state;
+	float avg;
+	float delta;
+	float noisePower;
+};
+
+/* Run one scan of the trace; returns results of all channels */
+static void run(TLSensors<N_SENSORS, 1> * s, struct Result * r)
+{
+	uint8_t ch;
+
+	delay(1);
+	s->sample();
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		r[ch].state = s->data[ch].buttonState;
+		r[ch].avg = TLValueToFloat(s->data[ch].avg);
+		r[ch].delta = TLValueToFloat(s->data[ch].delta);
+		r[ch].noisePower = TLValueToFloat(s->data[ch].noisePower);
+	}
+}
+
+static TLSensors<N_SENSORS, 1> * setup(void)
+{
+	TLSensors<N_SENSORS, 1> * s;
+	struct TLStruct * d;
+	uint8_t ch;
+
+	mockReset();
+	s = new TLSensors<N_SENSORS, 1>();
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		s->initialize(ch, TLSampleMethodCustom);
+		d = &(s->data[ch]);
+		d->sampleMethodSample = traceSample;
+		d->sampleMethodPostSample = tracePostSample;
+		d->enableNoisePowerMeasurement = true;
+		d->releasedToApproachedThreshold = TLValueFromFloat(5.0);
+		d->approachedToReleasedThreshold = TLValueFromFloat(4.0);
+		d->approachedToPressedThreshold = TLValueFromFloat(10.0);
+		d->pressedToApproachedThreshold = TLValueFromFloat(8.0);
+	}
+
+	return s;
+}
+
+#if TL_USE_FIXED_POINT
+
+static void update(float * errMax, float a, float b)
+{
+	if (fabs(a - b) > *errMax) {
+		*errMax = fabs(a - b);
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	TLSensors<N_SENSORS, 1> * s;
+	struct Result r[N_SENSORS], ref;
+	float errAvg = 0, errDelta = 0, errNoisePower = 0;
+	unsigned long nStateErrors = 0, nPressed = 0;
+	char cmd[256];
+	const char * slash;
+	FILE * f;
+	uint8_t ch;
+	int n;
+
+	/* The reference is next to this binary */
+	slash = strrchr(argv[0], '/');
+	n = slash ? (int) (slash - argv[0] + 1) : 0;
+	snprintf(cmd, sizeof(cmd), "%.*sfixed_point_reference", n, argv[0]);
+	f = popen(cmd, "r");
+	if (f == NULL) {
+		printf("cannot run %s\n", cmd);
+		return 1;
+	}
+
+	s = setup();
+	for (scan = 0; scan < N_SCANS; scan++) {
+		run(s, r);
+		for (ch = 0; ch < N_SENSORS; ch++) {
+			if (fscanf(f, "%d %f %f %f", &(ref.state), &(ref.avg),
+					&(ref.delta), &(ref.noisePower)) != 4) {
+				printf("reference ended at scan %lu\n", scan);
+				pclose(f);
+				return 1;
+			}
+			if (r[ch].state != ref.state) {
+				nStateErrors++;
+			}
+			if (ref.state == TLStruct::buttonStatePressed) {
+				nPressed++;
+			}
+			update(&errAvg, r[ch].avg, ref.avg);
+			update(&errDelta, r[ch].delta, ref.delta);
+			update(&errNoisePower, r[ch].noisePower,
+				ref.noisePower);
+		}
+	}
+	pclose(f);
+	delete s;
+
+	printf("%d scans of %d channels, %lu pressed\n", N_SCANS, N_SENSORS,
+		nPressed);
+	printf("state differences %lu\n", nStateErrors);
+	printf("max error avg %.4f delta %.4f noisePower %.4f\n", errAvg,
+		errDelta, errNoisePower);
+	CHECK(nPressed > 0);
+	CHECK(nStateErrors == 0);
+	CHECK(errAvg <= VALUE_ERROR_MAX);
+	CHECK(errDelta <= VALUE_ERROR_MAX);
+	CHECK(errNoisePower <= VALUE_ERROR_MAX);
+
+	return mockResult();
+}
+
+#else
+
+int main(void)
+{
+	TLSensors<N_SENSORS, 1> * s;
+	struct Result r[N_SENSORS];
+	uint8_t ch;
+
+	s = setup();
+	for (scan = 0; scan < N_SCANS; scan++) {
+		run(s, r);
+		for (ch = 0; ch < N_SENSORS; ch++) {
+			printf("%d %.6f %.6f %.6f\n", r[ch].state, r[ch].avg,
+				r[ch].delta, r[ch].noisePower);
+		}
+	}
+	delete s;
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * test_fsr.cpp - Force sensing resistor grid
+ *
+ * A grid of 3 rows (digital pins) and 4 columns (analog pins with pull-up)
+ * has a resistance at every pressed node. A column reads the divider of its
+ * pull-up and the nodes to their rows: a row driven low pulls down, a row
+ * driven high acts as an extra pull-up (ghosting) and a floating row does
+ * nothing. Three pressed nodes in one column must read their conductance
+ * despite the ghosting, and match the values they read when pressed alone.
+ * The compensation uses the values of the other nodes from the previous
+ * scan, so it needs a number of scans to converge. Open nodes must read 0,
+ * also next to a pressed node. Every row must be driven low only once per
+ * scan, also with a randomized scan order.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_ROWS				3
+#define N_COLS				4
+#define N_MEASUREMENTS			16
+#define N_SCANS				200
+
+/* Internal pull-up in kiloohm (kOhm), as assumed by the sample method */
+#define R_PULLUP			35.0
+
+static const int rowPins[N_ROWS] = {2, 3, 4};
+static const int colPins[N_COLS] = {A0, A0 + 1, A0 + 2, A0 + 3};
+
+class FsrCircuit : public MockCircuit {
+	public:
+		/* Node resistance in kiloohm (kOhm); 0 if not pressed */
+		double r[N_ROWS][N_COLS];
+
+		/* Number of times a row has been driven low */
+		unsigned long rowSelects;
+
+		FsrCircuit(void)
+		{
+			memset(r, 0, sizeof(r));
+			memset(rowLevel, LOW, sizeof(rowLevel));
+			rowSelects = 0;
+		}
+
+		void pinChanged(uint8_t p)
+		{
+			uint8_t row;
+
+			for (row = 0; row < N_ROWS; row++) {
+				if (rowPins[row] != p) {
+					continue;
+				}
+				if ((mockPinMode[p] == OUTPUT) &&
+						(mockPinLevel[p] == LOW) &&
+						(rowLevel[row] == HIGH)) {
+					rowSelects++;
+				}
+				rowLevel[row] = mockPinLevel[p];
+			}
+		}
+
+		int analogRead(uint8_t ch)
+		{
+			double g, gHigh, gSum;
+			uint8_t row, col;
+			int pin;
+
+			mockAdvance(100);
+
+			for (col = 0; (col < N_COLS) && (colPins[col] != A0 + ch);
+					col++);
+			if (col >= N_COLS) {
+				return 0;
+			}
+
+			gHigh = (mockPinMode[colPins[col]] == INPUT_PULLUP) ?
+				1 / R_PULLUP : 0;
+			gSum = gHigh;
+			for (row = 0; row < N_ROWS; row++) {
+				pin = rowPins[row];
+				if ((r[row][col] <= 0) ||
+						(mockPinMode[pin] != OUTPUT)) {
+					continue;
+				}
+				g = 1 / r[row][col];
+				gSum += g;
+				if (mockPinLevel[pin] == HIGH) {
+					gHigh += g;
+				}
+			}
+			if (gSum <= 0) {
+				return 0;
+			}
+
+			return lround(1024 * gHigh / gSum);
+		}
+
+	private:
+		uint8_t rowLevel[N_ROWS];
+};
+
+/* Value (conductance in uS) of every node after N_SCANS scans */
+static void measure(const double r[N_ROWS][N_COLS], double * value)
+{
+	static FsrCircuit * c = NULL;
+	TLSensors<N_ROWS * N_COLS, N_MEASUREMENTS> * s;
+	unsigned long before;
+	uint8_t ch;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new FsrCircuit();
+	mockCircuit = c;
+	mockCallCost = 1;
+	memcpy(c->r, r, sizeof(c->r));
+
+	s = new TLSensors<N_ROWS * N_COLS, N_MEASUREMENTS>();
+	CHECK(s->initializeMatrix(0, rowPins, N_ROWS, colPins, N_COLS,
+		TLSampleMethodFSR) == 0);
+	for (i = 0; i < N_SCANS; i++) {
+		before = c->rowSelects;
+		s->randomizeScanOrder = (i & 1);
+		s->sample();
+		CHECK(c->rowSelects - before == N_ROWS);
+	}
+	for (ch = 0; ch < N_ROWS * N_COLS; ch++) {
+		value[ch] = s->getValue(ch);
+	}
+
+	/* Pins are released after the scan */
+	for (i = 0; i < N_ROWS; i++) {
+		CHECK(mockPinMode[rowPins[i]] == INPUT);
+	}
+	for (i = 0; i < N_COLS; i++) {
+		CHECK(mockPinMode[colPins[i]] == INPUT);
+	}
+	delete s;
+}
+
+int main(void)
+{
+	static const double pressed[N_ROWS][N_COLS] = {
+		{0, 5, 0, 0},
+		{0, 2, 0, 0},
+		{0, 10, 0, 0},
+	};
+	double r[N_ROWS][N_COLS];
+	double all[N_ROWS * N_COLS], alone[N_ROWS * N_COLS], expected;
+	uint8_t row, col, ch;
+
+	measure(pressed, all);
+
+	printf("row col   R/kOhm  expected  together     alone\n");
+	for (row = 0; row < N_ROWS; row++) {
+		for (col = 0; col < N_COLS; col++) {
+			ch = row * N_COLS + col;
+			if (pressed[row][col] <= 0) {
+				/* Not pressed */
+				CHECK(all[ch] == 0);
+				continue;
+			}
+
+			memset(r, 0, sizeof(r));
+			r[row][col] = pressed[row][col];
+			measure(r, alone);
+
+			expected = 1000 / pressed[row][col];
+			printf("%3d %3d %8.1f %9.1f %9.1f %9.1f\n", row, col,
+				pressed[row][col], expected, all[ch],
+				alone[ch]);
+			CHECK(fabs(all[ch] / expected - 1) < 0.02);
+			CHECK(fabs(alone[ch] / expected - 1) < 0.02);
+		}
+	}
+
+	return mockResult();
+}
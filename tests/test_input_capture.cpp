@@ -0,0 +1,276 @@
+/*
+ * test_input_capture.cpp - RC timing with timer 1 input capture on an RC model
+ *
+ * The electrode (Cx, to GND) is on an analog pin and connected through R to
+ * the drive pin. Timer 1 counts CPU cycles; the analog comparator compares
+ * the electrode (through the ADC multiplexer) with the bandgap and sets ICF1
+ * and ICR1 at the crossing. Pin operations cost 4 us like digitalWrite() and
+ * pinMode() on a 16 MHz AVR. With TL_ENABLE_INPUT_CAPTURE_INTERRUPT (see
+ * test_input_capture_interrupt.cpp) the capture and overflow interrupts wake
+ * up the CPU from sleep; every measurement must then sleep instead of poll.
+ *
+ * The bandgap that PreSample switches on must be switched off again by
+ * PostSample if it was off before the scan.
+ */
+
+#include "mock_circuit.h"
+#include <avr/interrupt.h>
+#include <TouchLib.h>
+
+#define PIN				(A0 + 1)
+#define DRIVE_PIN			3
+
+#define CYCLES_PER_US			16.0
+
+class RcCircuit : public MockCircuit {
+	public:
+		double vcc;
+		double vBandgap;
+		double r; /* MOhm */
+		double cx; /* pF */
+
+		RcCircuit(void)
+		{
+			vcc = 5.0;
+			vBandgap = 1.1;
+			r = 1.0;
+			cx = 20.0;
+			vx = 0;
+			flags = 0;
+			timerStart = 0;
+			tcnt = 0;
+			sleeps = 0;
+		}
+
+		/* Statistics */
+		unsigned long sleeps;
+
+		void advance(double dt)
+		{
+			double vDrive, vNew, tc, ticks;
+
+			if (TCNT1.get() != tcnt) {
+				/* Written by the code just before this step */
+				timerStart = mockTime - TCNT1.get() /
+					CYCLES_PER_US;
+			}
+			if (timerRunning()) {
+				ticks = (mockTime + dt - timerStart) *
+					CYCLES_PER_US;
+				if (ticks >= 65536) {
+					flags |= _BV(TOV1);
+					ticks = fmod(ticks, 65536);
+					timerStart = mockTime + dt - ticks /
+						CYCLES_PER_US;
+				}
+				TCNT1.set((uint16_t) ticks);
+			}
+			tcnt = TCNT1.get();
+
+			if (mockPinMode[PIN] != INPUT) {
+				return;
+			}
+			if (mockPinMode[DRIVE_PIN] != OUTPUT) {
+				return;
+			}
+			vDrive = mockPinLevel[DRIVE_PIN] ? vcc : 0;
+			vNew = vDrive + (vx - vDrive) * exp(-dt / (r * cx));
+			if ((vx < vBandgap) && (vNew >= vBandgap) &&
+					(comparatorActive()) &&
+					(!(flags & _BV(ICF1)))) {
+				tc = mockTime + crossingTime(vDrive);
+				ICR1.set((uint16_t) ((tc - timerStart) *
+					CYCLES_PER_US));
+				flags |= _BV(ICF1);
+			}
+			vx = vNew;
+			TIFR1.set(flags);
+		}
+
+		void pinChanged(uint8_t p)
+		{
+			if ((p == PIN) && (mockPinMode[PIN] == OUTPUT)) {
+				vx = mockPinLevel[PIN] ? vcc : 0;
+			}
+		}
+
+		void registerWritten(const void * reg)
+		{
+			if (reg == &TIFR1) {
+				/* Flags are cleared by writing 1 */
+				flags &= ~TIFR1.get();
+				TIFR1.set(flags);
+			}
+		}
+
+		/* Idle mode: timer 1 and the comparator keep running */
+		void sleep(uint8_t mode)
+		{
+			double wakeAt, vDrive;
+
+			if (!(SREG.get() & SREG_I)) {
+				printf("sleep with interrupts disabled\n");
+				exit(1);
+			}
+			sleeps++;
+
+			if (!interruptPending()) {
+				wakeAt = -1;
+				if (timerRunning() && (TIMSK1.get() & _BV(TOIE1))) {
+					wakeAt = timerStart + 65536 /
+						CYCLES_PER_US;
+				}
+				vDrive = mockPinLevel[DRIVE_PIN] ? vcc : 0;
+				if ((TIMSK1.get() & _BV(ICIE1)) &&
+						(comparatorActive()) &&
+						(mockPinMode[DRIVE_PIN] == OUTPUT) &&
+						(vDrive > vBandgap) &&
+						(vx < vBandgap) && ((wakeAt < 0) ||
+						(mockTime + crossingTime(vDrive) <
+						wakeAt))) {
+					wakeAt = mockTime +
+						crossingTime(vDrive);
+				}
+				if (wakeAt < 0) {
+					printf("sleep without wakeup source\n");
+					exit(1);
+				}
+				/* Just past the event */
+				mockAdvance(wakeAt - mockTime + MOCK_CYCLE);
+			}
+
+			if ((flags & _BV(ICF1)) && (TIMSK1.get() & _BV(ICIE1))) {
+				flags &= ~_BV(ICF1);
+				TIFR1.set(flags);
+				mockCallVector(TIMER1_CAPT_vect);
+			} else if ((flags & _BV(TOV1)) &&
+					(TIMSK1.get() & _BV(TOIE1))) {
+				flags &= ~_BV(TOV1);
+				TIFR1.set(flags);
+				mockCallVector(TIMER1_OVF_vect);
+			}
+		}
+
+	private:
+		double vx;
+		uint8_t flags;
+		double timerStart;
+		uint16_t tcnt;
+
+		/* Time from now until the electrode reaches the bandgap */
+		double crossingTime(double vDrive)
+		{
+			return r * cx * log((vDrive - vx) / (vDrive - vBandgap));
+		}
+
+		bool interruptPending(void)
+		{
+			return ((flags & _BV(ICF1)) &&
+				(TIMSK1.get() & _BV(ICIE1))) ||
+				((flags & _BV(TOV1)) &&
+				(TIMSK1.get() & _BV(TOIE1)));
+		}
+
+		bool timerRunning(void)
+		{
+			return (TCCR1B.get() & (_BV(CS12) | _BV(CS11) |
+				_BV(CS10)));
+		}
+
+		bool comparatorActive(void)
+		{
+			return (ACSR.get() & _BV(ACBG)) &&
+				(ACSR.get() & _BV(ACIC)) &&
+				(ADCSRB.get() & _BV(ACME)) &&
+				(!(ADCSRA.get() & _BV(ADEN))) &&
+				((ADMUX.get() & 0x0F) == PIN - A0);
+		}
+};
+
+static struct TLStruct data[1];
+
+static RcCircuit * circuit = NULL;
+
+static RcCircuit * setup(double cx)
+{
+	RcCircuit * c;
+
+	mockReset();
+	delete circuit;
+	c = new RcCircuit();
+	circuit = c;
+	mockCircuit = c;
+	mockCallCost = 4;
+	c->cx = cx;
+
+	memset(data, 0, sizeof(data));
+	TLSampleMethodInputCapture(data, 1, 0);
+	data[0].tlStructSampleMethod.inputCapture.pin = PIN;
+	data[0].tlStructSampleMethod.inputCapture.drivePin = DRIVE_PIN;
+
+	return c;
+}
+
+int main(void)
+{
+	static const double cxs[] = {5, 10, 20, 50, 100};
+	double expected, err;
+	uint8_t i, acsr;
+	int sample;
+
+	/* Cycles until the electrode reaches the bandgap voltage */
+	printf("Cx/pF  cycles  expected   error\n");
+	for (i = 0; i < sizeof(cxs) / sizeof(cxs[0]); i++) {
+		setup(cxs[i]);
+		TLSampleMethodInputCapturePreSample(data, 1, 0);
+		sample = TLSampleMethodInputCaptureSample(data, 1, 0, false);
+		TLSampleMethodInputCapturePostSample(data, 1, 0);
+		expected = cxs[i] * log(5.0 / (5.0 - 1.1)) * CYCLES_PER_US;
+		err = sample / expected - 1;
+		printf("%5.0f %7d %9.1f %6.1f%%\n", cxs[i], sample, expected,
+			100 * err);
+		CHECK(fabs(sample - expected) <= 2);
+		#if TL_ENABLE_INPUT_CAPTURE_INTERRUPT
+		CHECK(circuit->sleeps > 0);
+		#else
+		CHECK(circuit->sleeps == 0);
+		#endif
+	}
+
+	/* Timer, comparator and ADC are restored */
+	setup(20);
+	ADCSRA.set(_BV(ADEN));
+	ACSR.set(_BV(ACBG) | _BV(ACIE));
+	TCCR1A.set(0xA1);
+	TCCR1B.set(_BV(CS11));
+	acsr = ACSR.get();
+	TLSampleMethodInputCaptureSample(data, 1, 0, false);
+	CHECK(ACSR.get() == acsr);
+	CHECK(TCCR1A.get() == 0xA1);
+	CHECK(TCCR1B.get() == _BV(CS11));
+	CHECK(ADCSRA.get() == _BV(ADEN));
+	CHECK(TIMSK1.get() == 0);
+
+	/* Bandgap is switched off again after the scan */
+	setup(20);
+	ACSR.set(_BV(ACIE));
+	TIMSK1.set(_BV(TOIE1));
+	TLSampleMethodInputCapturePreSample(data, 1, 0);
+	CHECK(ACSR.get() & _BV(ACBG));
+	TLSampleMethodInputCaptureSample(data, 1, 0, false);
+	CHECK(ACSR.get() & _BV(ACBG));
+	CHECK(TIMSK1.get() == _BV(TOIE1));
+	TLSampleMethodInputCapturePostSample(data, 1, 0);
+	CHECK(ACSR.get() == _BV(ACIE));
+
+	/* A timeout above INT16_MAX is clamped so it fits in a sample */
+	setup(10000);
+	data[0].tlStructSampleMethod.inputCapture.timeout = 60000;
+	TLSampleMethodInputCapturePreSample(data, 1, 0);
+	sample = TLSampleMethodInputCaptureSample(data, 1, 0, false);
+	TLSampleMethodInputCapturePostSample(data, 1, 0);
+	printf("no crossing: %d\n", sample);
+	CHECK(sample == INT16_MAX);
+
+	return mockResult();
+}
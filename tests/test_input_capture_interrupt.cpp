@@ -0,0 +1,6 @@
+/*
+ * test_input_capture_interrupt.cpp - test_input_capture.cpp with
+ * TL_ENABLE_INPUT_CAPTURE_INTERRUPT set (see Makefile)
+ */
+
+#include "test_input_capture.cpp"
@@ -0,0 +1,170 @@
+/*
+ * test_mutual_matrix.cpp - Mutual capacitance matrix
+ *
+ * Every node of a 3 x 4 matrix has a mutual capacitance (Cm) between its TX
+ * line (a digital pin) and its RX line (an analog pin). A step on a TX line
+ * couples charge into the RX lines that float, and into Chold if the ADC is
+ * connected to it; lines that are driven absorb it. The capacitance of each
+ * RX line and Chold together with the mutual capacitances of the other nodes
+ * on it is the default referenceValue, so every node must read its own Cm.
+ * A touch lowers Cm of one node; only that node may be pressed.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_TX				3
+#define N_RX				4
+#define N_MEASUREMENTS			8
+#define N_SCANS_CALIBRATION		700
+#define N_SCANS_TOUCH			20
+
+/* Mutual capacitance in picofarad (pF) without and with touch */
+#define C_MUTUAL			2.0
+#define C_MUTUAL_TOUCHED		1.5
+
+/* Capacitance of RX line and Chold assumed by the sample method */
+#define C_RX				30.0
+
+#define TX_TOUCHED			1
+#define RX_TOUCHED			2
+
+static const int txPins[N_TX] = {2, 3, 4};
+static const int rxPins[N_RX] = {A0, A0 + 1, A0 + 2, A0 + 3};
+
+class MutualCircuit : public CvdCircuit {
+	public:
+		double cm[N_TX][N_RX];
+		uint8_t txLevel[N_TX];
+
+		MutualCircuit(void)
+		{
+			uint8_t tx, rx;
+
+			for (tx = 0; tx < N_TX; tx++) {
+				for (rx = 0; rx < N_RX; rx++) {
+					cm[tx][rx] = C_MUTUAL;
+				}
+				txLevel[tx] = LOW;
+			}
+			for (rx = 0; rx < N_RX; rx++) {
+				cx[rx] = C_RX - cHold - (N_TX - 1) * C_MUTUAL;
+			}
+		}
+
+		void pinChanged(uint8_t pin)
+		{
+			double c, dv;
+			uint8_t tx, rx, level;
+			bool selected;
+
+			CvdCircuit::pinChanged(pin);
+
+			for (tx = 0; (tx < N_TX) && (txPins[tx] != pin); tx++);
+			if (tx >= N_TX) {
+				return;
+			}
+			level = (mockPinMode[pin] == OUTPUT) ?
+				mockPinLevel[pin] : txLevel[tx];
+			if (level == txLevel[tx]) {
+				return;
+			}
+			dv = (level == HIGH) ? vcc : -vcc;
+			txLevel[tx] = level;
+
+			for (rx = 0; rx < N_RX; rx++) {
+				if (mockPinMode[rxPins[rx]] == OUTPUT) {
+					continue;
+				}
+				selected = ((ADMUX.get() & 0x0F) == rx);
+				c = cx[rx] + (selected ? cHold : 0);
+				for (uint8_t n = 0; n < N_TX; n++) {
+					c += cm[n][rx];
+				}
+				vx[rx] += dv * cm[tx][rx] / c;
+				if (selected) {
+					vHold = vx[rx];
+				}
+			}
+		}
+};
+
+static MutualCircuit * c;
+static TLSensors<N_TX * N_RX, N_MEASUREMENTS> * s;
+
+static void scan(int nScans)
+{
+	int i;
+
+	for (i = 0; i < nScans; i++) {
+		delay(1);
+		s->sample();
+	}
+}
+
+/* Check all nodes; touched is the only one that may be pressed */
+static void check(bool touched)
+{
+	double expected;
+	uint8_t tx, rx, ch;
+
+	for (tx = 0; tx < N_TX; tx++) {
+		for (rx = 0; rx < N_RX; rx++) {
+			ch = tx * N_RX + rx;
+			expected = c->cm[tx][rx];
+			if ((touched) && (tx == TX_TOUCHED) &&
+					(rx == RX_TOUCHED)) {
+				printf("touched node: %.3f pF (%.3f pF), "
+					"delta %.3f pF\n", s->getValue(ch),
+					expected, s->getDelta(ch));
+				CHECK(s->data[ch].buttonState ==
+					TLStruct::buttonStatePressed);
+			} else {
+				CHECK(s->data[ch].buttonState ==
+					TLStruct::buttonStateReleased);
+			}
+			CHECK(fabs(s->getValue(ch) - expected) < 0.03);
+		}
+	}
+}
+
+int main(void)
+{
+	TLSensors<3, 1> * pair;
+
+	mockReset();
+	c = new MutualCircuit();
+	mockCircuit = c;
+	mockCallCost = 1;
+
+	s = new TLSensors<N_TX * N_RX, N_MEASUREMENTS>();
+	CHECK(s->initializeMatrix(0, txPins, N_TX, rxPins, N_RX) == 0);
+
+	/* Nodes on the same RX line are not a sensor pair */
+	CHECK(s->findSensorPair(0, 1) == -1);
+	CHECK(s->findSensorPair(N_RX, 1) == -1);
+
+	/* Other channels on the same pin are */
+	pair = new TLSensors<3, 1>();
+	pair->initialize(0, TLSampleMethodCVD);
+	pair->initialize(2, TLSampleMethodCVD);
+	pair->data[2].tlStructSampleMethod.CVD.pin = A0;
+	CHECK(pair->findSensorPair(0, 1) == 2);
+	CHECK(pair->findSensorPair(2, 0) == 0);
+	delete pair;
+
+	scan(N_SCANS_CALIBRATION);
+	printf("untouched node: %.3f pF (%.3f pF)\n", s->getValue(0),
+		C_MUTUAL);
+	check(false);
+
+	c->cm[TX_TOUCHED][RX_TOUCHED] = C_MUTUAL_TOUCHED;
+	scan(N_SCANS_TOUCH);
+	check(true);
+
+	c->cm[TX_TOUCHED][RX_TOUCHED] = C_MUTUAL;
+	scan(N_SCANS_TOUCH);
+	check(false);
+
+	return mockResult();
+}
@@ -0,0 +1,96 @@
+/*
+ * test_noise_power.cpp - Noise power measured during calibration
+ *
+ * The value is a constant plus Gaussian noise of known variance. noisePower is
+ * measured during calibration, so the sensor must go from calibrating to
+ * released right after calibrationTime, and noisePower at that moment must
+ * match the variance of the noise. A single measurement has the spread of a
+ * variance over about 2 * filterCoeff scans, so the mean over many sensors is
+ * checked.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SENSORS			8
+#define N_RUNS				8
+#define BASELINE			1000.0
+#define SIGMA				0.52
+
+static CvdCircuit rng;
+
+static int noisySample(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		bool inv)
+{
+	return 0;
+}
+
+static int noisyPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	data[ch].value = TLValueFromFloat(BASELINE + rng.gauss(SIGMA));
+
+	return 0;
+}
+
+int main(void)
+{
+	TLSensors<N_SENSORS, 1> * s;
+	struct TLStruct * d;
+	double sum = 0, variance;
+	unsigned long nScans, nScansMax = 0, nScansLimit;
+	uint8_t ch;
+	int run;
+
+	for (run = 0; run < N_RUNS; run++) {
+		mockReset();
+		s = new TLSensors<N_SENSORS, 1>();
+		for (ch = 0; ch < N_SENSORS; ch++) {
+			s->initialize(ch, TLSampleMethodCustom);
+			d = &(s->data[ch]);
+			d->sampleMethodSample = noisySample;
+			d->sampleMethodPostSample = noisyPostSample;
+			d->enableNoisePowerMeasurement = true;
+		}
+
+		/* Pre-calibration, calibration and 2 ms margin at 1 ms per scan */
+		d = &(s->data[0]);
+		nScansLimit = d->preCalibrationTime + d->calibrationTime + 2;
+		for (nScans = 0; nScans < nScansLimit; nScans++) {
+			delay(1);
+			s->sample();
+			if (s->data[N_SENSORS - 1].buttonState ==
+					TLStruct::buttonStateReleased) {
+				break;
+			}
+		}
+		if (nScans > nScansMax) {
+			nScansMax = nScans;
+		}
+
+		for (ch = 0; ch < N_SENSORS; ch++) {
+			d = &(s->data[ch]);
+			CHECK(d->buttonState == TLStruct::buttonStateReleased);
+			CHECK(d->noiseCounter == d->counter);
+			sum += TLValueToFloat(d->noisePower);
+		}
+
+		/* The deprecated noise power state releases on the next scan */
+		s->data[0].buttonState =
+			TLStruct::buttonStateNoisePowerMeasurement;
+		delay(1);
+		s->sample();
+		CHECK(s->data[0].buttonState == TLStruct::buttonStateReleased);
+		delete s;
+	}
+
+	variance = sum / (N_RUNS * N_SENSORS);
+	printf("released after %lu scans (limit %lu)\n", nScansMax,
+		nScansLimit);
+	printf("mean noisePower %.4f, variance of the noise %.4f\n", variance,
+		SIGMA * SIGMA);
+	CHECK(nScansMax < nScansLimit);
+	CHECK(fabs(variance / (SIGMA * SIGMA) - 1) < 0.1);
+
+	return mockResult();
+}
@@ -0,0 +1,151 @@
+/*
+ * test_resistive_batched.cpp - Batched sampling of resistive sensors
+ *
+ * Each analog pin has a sensor resistance to a ground pin that all sensors
+ * share; the internal pull-up forms a divider with it. A conversion reads the
+ * divider only while the pull-up is on and the ground pin is driven low. With
+ * useBatchedSampling the pins must be configured once per scan instead of
+ * around every conversion, with the same values. A non-batched resistive
+ * sensor on the same ground pin must make the others fall back.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SENSORS			6
+#define N_MEASUREMENTS			16
+#define N_SCANS				200
+#define GND_PIN				2
+
+/* Internal pull-up in kiloohm (kOhm), as assumed by the sample method */
+#define R_PULLUP			35.0
+
+class ResistiveCircuit : public MockCircuit {
+	public:
+		/* Sensor resistance of each analog pin in kiloohm (kOhm) */
+		double r[NUM_ANALOG_INPUTS];
+
+		unsigned long pinChanges;
+
+		ResistiveCircuit(void)
+		{
+			uint8_t n;
+
+			for (n = 0; n < NUM_ANALOG_INPUTS; n++) {
+				r[n] = 10.0 * (n + 1);
+			}
+			pinChanges = 0;
+		}
+
+		void pinChanged(uint8_t pin)
+		{
+			pinChanges++;
+		}
+
+		int analogRead(uint8_t ch)
+		{
+			mockAdvance(100);
+
+			if (mockPinMode[A0 + ch] != INPUT_PULLUP) {
+				/* Floating; no pull-up */
+				return 0;
+			}
+			if ((mockPinMode[GND_PIN] != OUTPUT) ||
+					(mockPinLevel[GND_PIN] != LOW)) {
+				return 1023;
+			}
+
+			return lround(1024 * r[ch] / (r[ch] + R_PULLUP));
+		}
+};
+
+struct Result {
+	double value[N_SENSORS];
+	unsigned long pinChangesPerScan;
+	bool batched[N_SENSORS];
+};
+
+static Result measure(bool useBatchedSampling, bool addNonBatched)
+{
+	static ResistiveCircuit * c = NULL;
+	TLSensors<N_SENSORS, N_MEASUREMENTS> * s;
+	struct TLStructSampleMethodResistive * res;
+	unsigned long before;
+	Result r;
+	uint8_t ch;
+	int i;
+
+	mockReset();
+	delete c;
+	c = new ResistiveCircuit();
+	mockCircuit = c;
+	mockCallCost = 1;
+
+	s = new TLSensors<N_SENSORS, N_MEASUREMENTS>();
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		s->initialize(ch, TLSampleMethodResistive);
+		res = &(s->data[ch].tlStructSampleMethod.resistive);
+		res->gndPin = GND_PIN;
+		res->useBatchedSampling = useBatchedSampling;
+	}
+	if (addNonBatched) {
+		s->data[N_SENSORS - 1].tlStructSampleMethod.resistive.
+			useBatchedSampling = false;
+	}
+
+	before = c->pinChanges;
+	for (i = 0; i < N_SCANS; i++) {
+		s->sample();
+	}
+	r.pinChangesPerScan = (c->pinChanges - before) / N_SCANS;
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		r.value[ch] = s->getValue(ch);
+		r.batched[ch] = s->data[ch].tlStructSampleMethod.resistive.
+			batched;
+	}
+
+	/* Pins float between scans */
+	CHECK(mockPinMode[GND_PIN] == INPUT);
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		CHECK(mockPinMode[A0 + ch] == INPUT);
+	}
+	delete s;
+
+	return r;
+}
+
+int main(void)
+{
+	Result normal, batched, mixed;
+	double expected;
+	uint8_t ch;
+
+	normal = measure(false, false);
+	batched = measure(true, false);
+	mixed = measure(true, true);
+
+	printf("pin changes per scan: %lu normal, %lu batched, %lu mixed\n",
+		normal.pinChangesPerScan, batched.pinChangesPerScan,
+		mixed.pinChangesPerScan);
+	printf(" ch  expected    normal   batched     mixed\n");
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		expected = R_PULLUP * lround(1024 * 10.0 * (ch + 1) /
+			(10.0 * (ch + 1) + R_PULLUP)) / 1024;
+		printf("%3d %9.3f %9.3f %9.3f %9.3f\n", ch, expected,
+			normal.value[ch], batched.value[ch], mixed.value[ch]);
+		CHECK(fabs(normal.value[ch] - expected) < 1e-3);
+		CHECK(batched.value[ch] == normal.value[ch]);
+		CHECK(mixed.value[ch] == normal.value[ch]);
+		CHECK(!normal.batched[ch]);
+		CHECK(batched.batched[ch]);
+
+		/* The non-batched sensor reconfigures the shared ground */
+		CHECK(!mixed.batched[ch]);
+	}
+
+	/* Configure and restore: 3 pin changes per sensor per scan */
+	CHECK(batched.pinChangesPerScan == 6 * N_SENSORS);
+	CHECK(normal.pinChangesPerScan == 6 * N_SENSORS * N_MEASUREMENTS);
+
+	return mockResult();
+}
@@ -0,0 +1,214 @@
+/*
+ * test_scan_order.cpp - Order of the measurements of a scan
+ *
+ * The measurements of every scan are recorded and compared to the order they
+ * should have: position pos of the scan order table at
+ * (scanOffset + i * scanStride) % length for i = 0, 1, ..., grouped by
+ * multiplexer address in Gray code order. The offset and stride are private,
+ * so every valid pair is tried. Each channel must be measured exactly
+ * nMeasurementsPerSensor times per scan. The strides of the randomized order
+ * come from a table generated at compile time; all must be coprime with the
+ * length and, for lengths that have them, mostly different.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SENSORS			7
+#define N_MEASUREMENTS			3
+#define LENGTH				(N_SENSORS * N_MEASUREMENTS)
+#define N_SCANS				20
+
+static const int muxSelectPins[] = {2, 4};
+
+static uint8_t order[LENGTH + 1];
+static uint16_t nOrder;
+
+static int recordSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		bool inv)
+{
+	if (nOrder < sizeof(order)) {
+		order[nOrder] = ch;
+	}
+	nOrder++;
+
+	return 0;
+}
+
+/* Same as TLSensors::scanGroupKey() for channels that are not FSR nodes */
+static uint8_t key(int8_t muxAddress)
+{
+	uint8_t g, k;
+
+	if (muxAddress < 0) {
+		return 0;
+	}
+	g = muxAddress;
+	k = g;
+	while (g >>= 1) {
+		k ^= g;
+	}
+
+	return k + 1;
+}
+
+static uint16_t gcd(uint16_t a, uint16_t b)
+{
+	uint16_t t;
+
+	while (b != 0) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+static bool matches(TLSensors<N_SENSORS, N_MEASUREMENTS> * s,
+		uint16_t offset, uint16_t stride)
+{
+	uint16_t i, n, pos;
+	uint8_t k, kMax, ch;
+
+	kMax = 0;
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		if (key(s->data[ch].muxAddress) > kMax) {
+			kMax = key(s->data[ch].muxAddress);
+		}
+	}
+
+	n = 0;
+	for (k = 0; k <= kMax; k++) {
+		for (i = 0; i < LENGTH; i++) {
+			pos = (offset + i * stride) % LENGTH;
+			ch = s->getScanOrder(pos);
+			if (key(s->data[ch].muxAddress) != k) {
+				continue;
+			}
+			if (order[n++] != ch) {
+				return false;
+			}
+		}
+	}
+
+	return (n == LENGTH);
+}
+
+/* Returns the number of (offset, stride) pairs the recorded scan matches */
+static int check(TLSensors<N_SENSORS, N_MEASUREMENTS> * s)
+{
+	uint16_t offset, stride;
+	uint8_t counts[N_SENSORS];
+	uint16_t i;
+	int n;
+
+	nOrder = 0;
+	s->sample();
+	CHECK(nOrder == LENGTH);
+	if (nOrder != LENGTH) {
+		return 0;
+	}
+
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < LENGTH; i++) {
+		counts[order[i]]++;
+	}
+	for (i = 0; i < N_SENSORS; i++) {
+		CHECK(counts[i] == N_MEASUREMENTS);
+	}
+
+	n = 0;
+	for (offset = 0; offset < LENGTH; offset++) {
+		for (stride = 1; stride < LENGTH; stride++) {
+			if ((gcd(LENGTH, stride) == 1) &&
+					(matches(s, offset, stride))) {
+				n++;
+			}
+		}
+	}
+
+	return n;
+}
+
+/* Number of different strides in the table for length; all must be valid */
+template <uint16_t LENGTH_TABLE>
+static uint8_t checkStrides(void)
+{
+	uint16_t stride;
+	uint8_t i, j, n = 0;
+
+	for (i = 0; i < TL_N_SCAN_STRIDES; i++) {
+		stride = TLScanStrideTable<LENGTH_TABLE>::stride[i];
+		CHECK((stride >= 1) && ((stride < LENGTH_TABLE) ||
+			(LENGTH_TABLE == 1)));
+		CHECK(gcd(LENGTH_TABLE, stride) == 1);
+		for (j = 0; (j < i) &&
+				(TLScanStrideTable<LENGTH_TABLE>::stride[j] !=
+				stride); j++);
+		if (j == i) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+int main(void)
+{
+	TLSensors<N_SENSORS, N_MEASUREMENTS> * s;
+	uint8_t first[LENGTH];
+	bool changed;
+	uint8_t ch;
+	int i;
+
+	checkStrides<1>();
+	checkStrides<2>();
+	CHECK(checkStrides<LENGTH>() == 10);
+	CHECK(checkStrides<30>() == 8);
+	CHECK(checkStrides<255 * 255>() == TL_N_SCAN_STRIDES);
+
+	mockReset();
+	s = new TLSensors<N_SENSORS, N_MEASUREMENTS>();
+	s->muxSelectPins = muxSelectPins;
+	s->nMuxSelectPins = 2;
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		if (ch < 3) {
+			s->initialize(ch, TLSampleMethodCustom);
+		} else {
+			s->initializeMux(ch, TLSampleMethodCustom, A0 + 3,
+				ch - 3);
+		}
+		s->data[ch].sampleMethodSample = recordSample;
+	}
+
+	/* Fixed order: the table itself (offset 0, stride 1), grouped */
+	for (i = 0; i < 2; i++) {
+		CHECK(check(s) > 0);
+		CHECK(matches(s, 0, 1));
+	}
+
+	/* Randomized order: a new permutation every scan */
+	s->randomizeScanOrder = true;
+	changed = false;
+	for (i = 0; i < N_SCANS; i++) {
+		CHECK(check(s) > 0);
+		if (i == 0) {
+			memcpy(first, order, sizeof(first));
+		} else if (memcmp(first, order, sizeof(first))) {
+			changed = true;
+		}
+	}
+	CHECK(changed);
+
+	/* Without multiplexers there is a single group */
+	for (ch = 3; ch < N_SENSORS; ch++) {
+		s->data[ch].muxAddress = -1;
+	}
+	for (i = 0; i < N_SCANS; i++) {
+		CHECK(check(s) > 0);
+	}
+	delete s;
+
+	return mockResult();
+}
@@ -0,0 +1,102 @@
+/*
+ * test_scan_randomization.cpp - Periodic interference with a randomized scan
+ *
+ * Every measurement takes 20 us and sees a tone just off the 3rd harmonic of
+ * the scan rate on top of a constant level. With a fixed scan order the
+ * measurements of a sensor hit the tone at almost the same phase every scan,
+ * so the tone aliases to a slow beat in the value, which the baseline filter
+ * and the touch thresholds can't tell from a touch. A randomized scan order
+ * and random gaps spread the measurements over the phase of the tone, so
+ * the interference becomes noise that changes every scan. The average of
+ * raw over N_AVERAGE scans (like the baseline filter does) must then vary
+ * much less.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_SENSORS			4
+#define N_MEASUREMENTS			8
+#define N_SCANS				2048
+#define N_AVERAGE			16
+#define T_MEASUREMENT			20 /* us */
+#define SCAN_PERIOD			1000 /* us */
+#define LEVEL				500
+#define TONE_AMPLITUDE			40
+#define TONE_FREQUENCY			(3.01 / SCAN_PERIOD) /* 1 / us */
+
+static int toneSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		bool inv)
+{
+	double t;
+
+	t = mockTime;
+	delayMicroseconds(T_MEASUREMENT);
+
+	return lround(LEVEL + TONE_AMPLITUDE * sin(2 * M_PI *
+		TONE_FREQUENCY * t));
+}
+
+/*
+ * Mean over all sensors of the standard deviation of raw averaged over blocks
+ * of N_AVERAGE scans
+ */
+static double measure(bool randomize, unsigned int scanGapMax)
+{
+	TLSensors<N_SENSORS, N_MEASUREMENTS> * s;
+	double sum[N_SENSORS], sum2[N_SENSORS], block[N_SENSORS];
+	double x, mean, stddev = 0;
+	unsigned long scan;
+	uint8_t ch;
+
+	mockReset();
+	s = new TLSensors<N_SENSORS, N_MEASUREMENTS>();
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		s->initialize(ch, TLSampleMethodCustom);
+		s->data[ch].sampleMethodSample = toneSample;
+		sum[ch] = 0;
+		sum2[ch] = 0;
+		block[ch] = 0;
+	}
+	s->randomizeScanOrder = randomize;
+	s->scanGapMax = scanGapMax;
+
+	for (scan = 0; scan < N_SCANS; scan++) {
+		/* Start every scan on the scan period */
+		delayMicroseconds(scan * SCAN_PERIOD - mockTime);
+		s->sample();
+		for (ch = 0; ch < N_SENSORS; ch++) {
+			block[ch] += s->getRaw(ch);
+			if ((scan + 1) % N_AVERAGE) {
+				continue;
+			}
+			x = block[ch] / N_AVERAGE;
+			block[ch] = 0;
+			sum[ch] += x;
+			sum2[ch] += x * x;
+		}
+	}
+	for (ch = 0; ch < N_SENSORS; ch++) {
+		mean = sum[ch] / (N_SCANS / N_AVERAGE);
+		stddev += sqrt(sum2[ch] / (N_SCANS / N_AVERAGE) - mean * mean);
+	}
+	delete s;
+
+	return stddev / N_SENSORS;
+}
+
+int main(void)
+{
+	double fixed, randomized, gaps;
+
+	fixed = measure(false, 0);
+	randomized = measure(true, 0);
+	gaps = measure(true, T_MEASUREMENT);
+	printf("standard deviation of raw averaged over %d scans: fixed %.1f, "
+		"randomized %.1f, randomized with gaps %.1f\n", N_AVERAGE,
+		fixed, randomized, gaps);
+	CHECK(randomized < 0.8 * fixed);
+	CHECK(gaps < 0.8 * fixed);
+
+	return mockResult();
+}
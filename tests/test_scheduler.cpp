@@ -0,0 +1,109 @@
+/*
+ * test_scheduler.cpp - Scan rates of two instances sharing the ADC
+ *
+ * Every measurement takes 20 us. A slow instance (4 sensors, 64 measurements
+ * per sensor, 5.1 ms per scan) runs at 50 Hz and a fast instance (8 sensors, 4
+ * measurements per sensor, 0.64 ms per scan) at 500 Hz, both through one
+ * TLScheduler. Calling sample() of the slow instance would block the fast one
+ * for longer than its scan period. With the scheduler both must reach their
+ * target rate and every scan of the fast instance must end in its own period.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+#include <TLScheduler.h>
+
+#define T_MEASUREMENT			20 /* us */
+#define PERIOD_SLOW			20000 /* us */
+#define PERIOD_FAST			2000 /* us */
+#define T_RUN				2000000 /* us */
+
+static unsigned long nMeasurements = 0;
+
+static int delayedSample(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		bool inv)
+{
+	delayMicroseconds(T_MEASUREMENT);
+	nMeasurements++;
+
+	return 0;
+}
+
+template <uint8_t N, uint8_t M>
+static TLSensors<N, M> * create(void)
+{
+	TLSensors<N, M> * s;
+	uint8_t ch;
+
+	s = new TLSensors<N, M>();
+	for (ch = 0; ch < N; ch++) {
+		s->initialize(ch, TLSampleMethodCustom);
+		s->data[ch].sampleMethodSample = delayedSample;
+	}
+
+	return s;
+}
+
+int main(void)
+{
+	TLSensors<4, 64> * slow;
+	TLSensors<8, 4> * fast;
+	TLScheduler scheduler;
+	unsigned long nScans[2], n, lateMax;
+	double t0, late;
+	int8_t k;
+
+	mockReset();
+	slow = create<4, 64>();
+	fast = create<8, 4>();
+
+	/* Blocking scans: the slow scan alone takes longer than a fast period */
+	mockTime = 0;
+	slow->sample();
+	printf("slow sample() blocks for %.0f us\n", mockTime);
+	CHECK(mockTime > PERIOD_FAST);
+
+	CHECK(scheduler.add(slow, PERIOD_SLOW) == 0);
+	CHECK(scheduler.add(fast, PERIOD_FAST) == 1);
+
+	t0 = mockTime;
+	nScans[0] = 0;
+	nScans[1] = 0;
+	lateMax = 0;
+	nMeasurements = 0;
+	while (mockTime - t0 < T_RUN) {
+		k = scheduler.update();
+		if (k == -2) {
+			/* Other work of the sketch */
+			delayMicroseconds(10);
+			continue;
+		}
+		if (k < 0) {
+			continue;
+		}
+		nScans[k]++;
+		if (k == 1) {
+			/* Scan n of the fast instance must end in period n */
+			late = mockTime - (t0 + nScans[1] * PERIOD_FAST);
+			if (late > (double) lateMax) {
+				lateMax = late;
+			}
+		}
+	}
+
+	n = T_RUN / PERIOD_SLOW;
+	printf("slow: %lu scans (target %lu)\n", nScans[0], n);
+	CHECK((nScans[0] >= n - 1) && (nScans[0] <= n));
+	n = T_RUN / PERIOD_FAST;
+	printf("fast: %lu scans (target %lu), at most %lu us late\n", nScans[1],
+		n, lateMax);
+	CHECK((nScans[1] >= n - 1) && (nScans[1] <= n));
+	CHECK(lateMax == 0);
+	CHECK(nMeasurements <= (nScans[0] + 1) * 4 * 64 +
+		(nScans[1] + 1) * 8 * 4);
+
+	delete slow;
+	delete fast;
+
+	return mockResult();
+}
@@ -0,0 +1,87 @@
+/*
+ * test_shift_filter.cpp - Time constant of the baseline filter
+ *
+ * A constant value is calibrated, then raised by 1. The first update of avg
+ * after the step must move it by 1 / filterCoeff, or by 1 / 2^filterShift
+ * with the shift filter, where filterCoeff is rounded to the nearest power of
+ * two (24 to 32, 40 to 32 and 48 to 64). The shift filter must reach that
+ * shift even when the power of two is larger than filterCoeff.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define BASELINE			1000.0
+
+static float level;
+
+static int constantSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch, bool inv)
+{
+	return 0;
+}
+
+static int constantPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	data[ch].value = TLValueFromFloat(level);
+
+	return 0;
+}
+
+static void check(uint16_t filterCoeff, bool shift, uint8_t filterShift)
+{
+	TLSensors<1, 1> * s;
+	struct TLStruct * d;
+	float step, expected;
+	int i;
+
+	mockReset();
+	s = new TLSensors<1, 1>();
+	s->initialize(0, TLSampleMethodCustom);
+	d = &(s->data[0]);
+	d->sampleMethodSample = constantSample;
+	d->sampleMethodPostSample = constantPostSample;
+	d->filterCoeff = filterCoeff;
+	d->enableShiftFilter = shift;
+
+	level = BASELINE;
+	for (i = 0; (i < 2000) && (d->buttonState !=
+			TLStruct::buttonStateReleased); i++) {
+		delay(1);
+		s->sample();
+	}
+	CHECK(d->buttonState == TLStruct::buttonStateReleased);
+	CHECK(fabs(TLValueToFloat(d->avg) - BASELINE) < 0.01);
+
+	level = BASELINE + 1;
+	delay(1);
+	s->sample();
+	step = TLValueToFloat(d->avg) - BASELINE;
+	expected = shift ? ldexp(1, -filterShift) : 1.0 / filterCoeff;
+
+	printf("%5u %5s %7lu %10.6f %10.6f\n", filterCoeff, shift ? "yes" :
+		"no", (unsigned long) d->counter, step, expected);
+	if (shift) {
+		CHECK(d->filterShift == filterShift);
+		CHECK(d->counter == (1UL << filterShift));
+	} else {
+		CHECK(d->counter == (uint32_t) filterCoeff - 1);
+	}
+	CHECK(fabs(step - expected) < 1e-4);
+
+	delete s;
+}
+
+int main(void)
+{
+	printf("coeff shift counter       step   expected\n");
+	check(16, false, 0);
+	check(24, false, 0);
+	check(16, true, 4);
+	check(24, true, 5);
+	check(40, true, 5);
+	check(48, true, 6);
+
+	return mockResult();
+}
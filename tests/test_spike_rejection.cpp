@@ -0,0 +1,106 @@
+/*
+ * test_spike_rejection.cpp - Trimmed mean of the measurements of a scan
+ *
+ * Every measurement of both sensors is 500, except that every 10th scan one
+ * measurement of sensor 1 is full scale. With enableSpikeRejection raw must
+ * be exactly the value without the spike and sensor 1 must stay released;
+ * without it the spike must be seen. The post sample method of sensor 0
+ * reads raw of sensor 1, so it must see the trimmed raw as well.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_MEASUREMENTS			8
+#define N_SCANS				1000
+#define LEVEL				500
+#define SPIKE				1023
+
+/* Normal samples are doubled to the scale of differential ones */
+#define RAW_EXPECTED			(2 * LEVEL * N_MEASUREMENTS)
+
+static unsigned long scan;
+static uint8_t nMeasured;
+static int32_t seenRaw1;
+
+static int spikySample(struct TLStruct * data, uint8_t nSensors, uint8_t ch,
+		bool inv)
+{
+	if (ch != 1) {
+		return LEVEL;
+	}
+	nMeasured++;
+	if ((scan % 10 == 5) && (nMeasured == 3)) {
+		return SPIKE;
+	}
+
+	return LEVEL;
+}
+
+static int peekingPostSample(struct TLStruct * data, uint8_t nSensors,
+		uint8_t ch)
+{
+	seenRaw1 = data[1].raw;
+	data[ch].value = TLValueFromFloat(data[ch].raw);
+
+	return 0;
+}
+
+static void run(bool enableSpikeRejection)
+{
+	TLSensors<2, N_MEASUREMENTS> * s;
+	bool released = true;
+	float deltaMax = 0;
+	int32_t rawMax = 0;
+	uint8_t ch;
+
+	mockReset();
+	s = new TLSensors<2, N_MEASUREMENTS>();
+	for (ch = 0; ch < 2; ch++) {
+		s->initialize(ch, TLSampleMethodCustom);
+		s->data[ch].sampleMethodSample = spikySample;
+		s->data[ch].enableSpikeRejection = enableSpikeRejection;
+	}
+	s->data[0].sampleMethodPostSample = peekingPostSample;
+
+	for (scan = 0; scan < N_SCANS; scan++) {
+		nMeasured = 0;
+		delay(1);
+		s->sample();
+		CHECK(nMeasured == N_MEASUREMENTS);
+		CHECK(seenRaw1 == s->data[1].raw);
+		if (s->data[1].raw > rawMax) {
+			rawMax = s->data[1].raw;
+		}
+		if (s->data[1].buttonState < TLStruct::buttonStateReleased) {
+			continue;
+		}
+		if (TLValueToFloat(s->data[1].delta) > deltaMax) {
+			deltaMax = TLValueToFloat(s->data[1].delta);
+		}
+		if (s->data[1].buttonState != TLStruct::buttonStateReleased) {
+			released = false;
+		}
+	}
+	printf("spike rejection %-3s: raw max %ld, delta max %.1f, %s\n",
+		enableSpikeRejection ? "on" : "off", (long) rawMax, deltaMax,
+		released ? "always released" : "left released");
+
+	if (enableSpikeRejection) {
+		CHECK(rawMax == RAW_EXPECTED);
+		CHECK(released);
+	} else {
+		CHECK(rawMax == RAW_EXPECTED + 2 * (SPIKE - LEVEL));
+		CHECK(!released);
+	}
+
+	delete s;
+}
+
+int main(void)
+{
+	run(true);
+	run(false);
+
+	return mockResult();
+}
@@ -0,0 +1,188 @@
+/*
+ * test_touch_screen.cpp - 4-wire resistive touch screen
+ *
+ * The X plate runs from xmPin (position 0) to xpPin (position 1) and the Y
+ * plate from ymPin to ypPin. A touch connects both plates at its position
+ * through the touch resistance. Pins that are not driven float, so the
+ * voltage of each plate follows from the driven pins and the touch. The
+ * position channels must read the position of the touch and the pressure
+ * channel its conductance; the state of the pressure channel must follow
+ * the conductance and go back to released when the touch is lifted. Going
+ * from one drive to the next must reconfigure only the pins that change.
+ */
+
+#include "mock_circuit.h"
+#include <TouchLib.h>
+
+#define N_MEASUREMENTS			16
+#define N_SCANS_CALIBRATION		700
+#define N_SCANS_TOUCH			20
+
+#define XP_PIN				8
+#define XM_PIN				(A0 + 2)
+#define YP_PIN				(A0 + 3)
+#define YM_PIN				9
+
+/* Plate resistances in Ohm; the X plate is the default referenceValue */
+#define R_X				300.0
+#define R_Y				500.0
+
+/* Keeps floating nodes at 0 instead of leaving them undefined */
+#define G_LEAK				1e-9
+
+#define CH_X				0
+#define CH_Y				1
+#define CH_PRESSURE			2
+
+class TouchScreenCircuit : public MockCircuit {
+	public:
+		/* Touch position (0 - 1) and resistance in Ohm; 0 if none */
+		double x, y, r;
+
+		unsigned long pinChanges;
+
+		TouchScreenCircuit(void)
+		{
+			x = 0.5;
+			y = 0.5;
+			r = 0;
+			pinChanges = 0;
+		}
+
+		void pinChanged(uint8_t pin)
+		{
+			pinChanges++;
+		}
+
+		/* Conductance to a pin if it is driven, and its voltage */
+		static void drive(int pin, double g, double * gSum,
+				double * iSum)
+		{
+			if (mockPinMode[pin] != OUTPUT) {
+				return;
+			}
+			*gSum += g;
+			if (mockPinLevel[pin] == HIGH) {
+				*iSum += g;
+			}
+		}
+
+		int analogRead(uint8_t ch)
+		{
+			double g11, g22, gt, i1, i2, det, v;
+
+			mockAdvance(100);
+
+			/* Node 1: touch point on X plate, node 2: on Y plate */
+			g11 = G_LEAK;
+			g22 = G_LEAK;
+			i1 = 0;
+			i2 = 0;
+			drive(XP_PIN, 1 / (R_X * (1 - x)), &g11, &i1);
+			drive(XM_PIN, 1 / (R_X * x), &g11, &i1);
+			drive(YP_PIN, 1 / (R_Y * (1 - y)), &g22, &i2);
+			drive(YM_PIN, 1 / (R_Y * y), &g22, &i2);
+			gt = (r > 0) ? 1 / r : 0;
+			g11 += gt;
+			g22 += gt;
+
+			det = g11 * g22 - gt * gt;
+			if (A0 + ch == XM_PIN) {
+				v = (i1 * g22 + gt * i2) / det;
+			} else if (A0 + ch == YP_PIN) {
+				v = (i2 * g11 + gt * i1) / det;
+			} else {
+				return 0;
+			}
+
+			/* A driven pin reads its own level */
+			if (mockPinMode[A0 + ch] == OUTPUT) {
+				v = (mockPinLevel[A0 + ch] == HIGH) ? 1 : 0;
+			}
+
+			return (v >= 1023.0 / 1024) ? 1023 : lround(1024 * v);
+		}
+};
+
+static TouchScreenCircuit * c;
+static TLSensors<3, N_MEASUREMENTS> * s;
+
+static void scan(int nScans)
+{
+	int i;
+
+	for (i = 0; i < nScans; i++) {
+		delay(1);
+		s->sample();
+
+		/* Pins float between scans */
+		CHECK(mockPinMode[XP_PIN] == INPUT);
+		CHECK(mockPinMode[XM_PIN] == INPUT);
+		CHECK(mockPinMode[YP_PIN] == INPUT);
+		CHECK(mockPinMode[YM_PIN] == INPUT);
+	}
+}
+
+static void touch(double x, double y, double r,
+		enum TLStruct::ButtonState state)
+{
+	double expected;
+
+	c->x = x;
+	c->y = y;
+	c->r = r;
+	scan(N_SCANS_TOUCH);
+
+	expected = 1e6 / r;
+	printf("%5.2f %5.2f %6.0f %8.4f %8.4f %8.0f %8.0f\n", x, y, r,
+		s->getValue(CH_X), s->getValue(CH_Y), expected,
+		s->getValue(CH_PRESSURE));
+	CHECK(fabs(s->getValue(CH_X) - x) < 2.0 / 1024);
+	CHECK(fabs(s->getValue(CH_Y) - y) < 2.0 / 1024);
+	CHECK(fabs(s->getValue(CH_PRESSURE) / expected - 1) < 0.03);
+	CHECK(s->data[CH_PRESSURE].buttonState == state);
+
+	/* Release */
+	c->r = 0;
+	scan(N_SCANS_TOUCH);
+	CHECK(s->getValue(CH_PRESSURE) == 0);
+	CHECK(s->data[CH_PRESSURE].buttonState ==
+		TLStruct::buttonStateReleased);
+}
+
+int main(void)
+{
+	unsigned long before;
+
+	mockReset();
+	c = new TouchScreenCircuit();
+	mockCircuit = c;
+	mockCallCost = 1;
+
+	s = new TLSensors<3, N_MEASUREMENTS>();
+	CHECK(s->initializeTouchScreen(0, XP_PIN, XM_PIN, YP_PIN, YM_PIN) == 0);
+
+	scan(N_SCANS_CALIBRATION);
+	CHECK(s->data[CH_PRESSURE].buttonState ==
+		TLStruct::buttonStateReleased);
+	CHECK(s->getValue(CH_PRESSURE) == 0);
+
+	/*
+	 * Y drive (6 pin changes) and release (4) once per scan, and pressure,
+	 * X and Y drive (4 + 4 + 6) per measurement
+	 */
+	before = c->pinChanges;
+	scan(1);
+	printf("pin changes per scan: %lu\n", c->pinChanges - before);
+	CHECK(c->pinChanges - before == 10 + 14 * N_MEASUREMENTS);
+
+	printf("    x     y  R/Ohm        x        y     G/uS     G/uS\n");
+	touch(0.3, 0.6, 400, TLStruct::buttonStatePressed);
+	touch(0.8, 0.2, 800, TLStruct::buttonStatePressed);
+	touch(0.1, 0.9, 250, TLStruct::buttonStatePressed);
+
+	/* Light touch: between the approached and pressed thresholds */
+	touch(0.5, 0.5, 2000, TLStruct::buttonStateApproached);
+
+	return mockResult();
+}
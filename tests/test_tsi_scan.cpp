@@ -0,0 +1,195 @@
+/*
+ * test_tsi_scan.cpp - Hardware scan of the touchRead method on a TSI model
+ *
+ * The model mimics the TSI of the Teensy 3.x: a software triggered scan
+ * measures all channels in TSI0_PEN one after the other, then sets the write
+ * 1 to clear EOSF flag. Each count is the number of the scan that produced
+ * it, so stale results are easy to spot. touchRead() is implemented like in
+ * the Teensy core.
+ */
+
+#include "mock_circuit.h"
+#include "../src/TLSampleMethodTouchRead.cpp"
+
+#define TSI_W1C			(TSI_GENCS_EOSF | TSI_GENCS_OUTRGF)
+
+/* Pins 0, 1 and 15 are TSI channels 9, 10 and 13 */
+#define PIN_A			0
+#define PIN_B			1
+#define PIN_C			15
+
+class TsiCircuit : public MockCircuit {
+	public:
+		/* Time to measure one channel in us */
+		double tChannel;
+
+		unsigned long scansStarted;
+		unsigned long scansFinished;
+
+		TsiCircuit(void)
+		{
+			tChannel = 50;
+			scansStarted = 0;
+			scansFinished = 0;
+			flags = 0;
+			scanning = false;
+		}
+
+		void advance(double dt)
+		{
+			uint8_t n;
+
+			if ((!scanning) || (mockTime + dt < doneAt)) {
+				return;
+			}
+			scanning = false;
+			scansFinished++;
+			for (n = 0; n < 16; n++) {
+				if (pen & (1 << n)) {
+					mockTsiCntr[n] = scansFinished;
+				}
+			}
+			flags |= TSI_GENCS_EOSF;
+			TSI0_GENCS.set((TSI0_GENCS.get() & ~TSI_GENCS_SCNIP) |
+				flags);
+		}
+
+		void registerWritten(const void * reg)
+		{
+			uint32_t v;
+			uint8_t n, k;
+
+			if (reg != &TSI0_GENCS) {
+				return;
+			}
+			v = TSI0_GENCS.get();
+			flags &= ~(v & TSI_W1C);
+			if (!(v & TSI_GENCS_TSIEN)) {
+				/* Module disabled; abort scan */
+				scanning = false;
+			} else if (v & TSI_GENCS_SWTS) {
+				pen = TSI0_PEN.get();
+				for (n = 0, k = 0; n < 16; n++) {
+					k += (pen >> n) & 1;
+				}
+				scanning = true;
+				scansStarted++;
+				doneAt = mockTime + k * tChannel;
+			}
+			v &= ~(TSI_W1C | TSI_GENCS_SWTS | TSI_GENCS_SCNIP);
+			v |= flags;
+			if (scanning) {
+				v |= TSI_GENCS_SCNIP;
+			}
+			TSI0_GENCS.set(v);
+		}
+
+	private:
+		uint32_t flags;
+		uint32_t pen;
+		bool scanning;
+		double doneAt;
+};
+
+/* Like touchRead() in touch.c of the Teensy core */
+int touchRead(uint8_t pin)
+{
+	uint8_t ch;
+
+	ch = pin2tsi[pin];
+	*portConfigRegister(pin) = PORT_PCR_MUX(0);
+	SIM_SCGC5 |= SIM_SCGC5_TSI;
+	TSI0_GENCS = 0;
+	TSI0_PEN = (1 << ch);
+	TSI0_SCANC = TSI_SCANC_REFCHRG(3) | TSI_SCANC_EXTCHRG(TL_TSI_CURRENT);
+	TSI0_GENCS = TSI_GENCS_NSCN(TL_TSI_NSCAN) |
+		TSI_GENCS_PS(TL_TSI_PRESCALE) | TSI_GENCS_TSIEN |
+		TSI_GENCS_SWTS;
+	delayMicroseconds(10);
+	while (TSI0_GENCS & TSI_GENCS_SCNIP);
+	delayMicroseconds(1);
+
+	return *((volatile uint16_t *) (&TSI0_CNTR1) + ch);
+}
+
+static struct TLStruct data[3];
+
+static TsiCircuit * setup(bool scanB)
+{
+	static TsiCircuit * c = NULL;
+	uint8_t n;
+
+	mockReset();
+	delete c;
+	c = new TsiCircuit();
+	mockCircuit = c;
+	mockCallCost = 0.1;
+	TSI0_GENCS.set(0);
+	tsiEnabledMask = 0;
+	tsiFreshMask = 0;
+	tsiValidMask = 0;
+	tsiScanInProgress = false;
+
+	memset(data, 0, sizeof(data));
+	data[0].tlStructSampleMethod.touchRead.pin = PIN_A;
+	data[1].tlStructSampleMethod.touchRead.pin = PIN_B;
+	data[2].tlStructSampleMethod.touchRead.pin = PIN_C;
+	data[0].tlStructSampleMethod.touchRead.useHardwareScan = true;
+	data[1].tlStructSampleMethod.touchRead.useHardwareScan = scanB;
+	data[2].tlStructSampleMethod.touchRead.useHardwareScan = true;
+	for (n = 0; n < 3; n++) {
+		TLSampleMethodTouchReadPreSample(data, 3, n);
+	}
+
+	return c;
+}
+
+static int sample(uint8_t ch)
+{
+	return TLSampleMethodTouchReadSample(data, 3, ch, false);
+}
+
+int main(void)
+{
+	TsiCircuit * c;
+	int a, aLast, i;
+	double t;
+
+	/*
+	 * A and C use the hardware scan, B uses touchRead(). With enough time
+	 * between the rounds, every result of A must come from a new scan.
+	 */
+	c = setup(false);
+	aLast = 0;
+	for (i = 0; i < 50; i++) {
+		delayMicroseconds(1000);
+		a = sample(0);
+		sample(2);
+		sample(1);
+		CHECK(a > aLast);
+		aLast = a;
+	}
+
+	/*
+	 * A, B and C use the hardware scan; each is measured twice in a row
+	 * (as with N_MEASUREMENTS_PER_SENSOR = 2). This needs one scan per
+	 * round, started in the background, and must not wait for it.
+	 */
+	c = setup(true);
+	for (i = 0; i < 3; i++) {
+		sample(i);
+	}
+	for (i = 0; i < 50; i++) {
+		/* Other work of the sketch while the scan runs */
+		delayMicroseconds(1000);
+		t = mockTime;
+		CHECK(sample(0) == sample(0));
+		CHECK(sample(1) == sample(1));
+		CHECK(sample(2) == sample(2));
+		CHECK(mockTime - t < c->tChannel);
+	}
+	printf("%lu hardware scans for 50 rounds\n", c->scansStarted);
+	CHECK(c->scansStarted <= 52);
+
+	return mockResult();
+}